@@ -0,0 +1,193 @@
+// mangohud-log: analysis of MangoHud logs
+//
+//   mangohud-log compare [options] A.csv... vs B.csv...
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../log_compare.h"
+
+// Units the bootstrap resamples per side at most, longer sets get longer units
+static const size_t max_units = 2000;
+
+struct options {
+    unsigned jobs = std::max(std::thread::hardware_concurrency(), 1u);
+    unsigned resamples = 2000;
+    double unit_s = 10;
+    uint64_t seed = 1;
+    double threshold = 1;    // %
+};
+
+static void help_and_quit() {
+    fprintf(stderr, "Usage: mangohud-log compare [options] A.csv... vs B.csv...\n");
+    fprintf(stderr, "Compares the logs of B against the logs of A: average fps, lows and\n");
+    fprintf(stderr, "frametime percentiles with 95%% bootstrap intervals of the change, and a\n");
+    fprintf(stderr, "Mann-Whitney test over the average fps of stretches of the logs.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "   -j N   parse and resample with N threads (default: all cpus)\n");
+    fprintf(stderr, "   -r N   bootstrap resamples (default: 2000)\n");
+    fprintf(stderr, "   -u S   seconds of log per resampled stretch (default: 10)\n");
+    fprintf(stderr, "   -s N   seed, the same seed gives the same intervals (default: 1)\n");
+    fprintf(stderr, "   -t P   changes below P%% are the same (default: 1)\n");
+    exit(1);
+}
+
+static double parse_number_arg(const char* opt, const char* value) {
+    char* end;
+    double v = value ? strtod(value, &end) : 0;
+    if (!value || *end || !(v > 0)) {
+        fprintf(stderr, "%s needs a positive number\n", opt);
+        exit(1);
+    }
+    return v;
+}
+
+// Parses the logs, jobs at a time, into units of unit_ms. log numbers the
+// units from first_log on, in the order of files.
+static bool read_logs(const std::vector<std::string>& files, uint32_t first_log, double unit_ms,
+                      unsigned jobs, std::vector<log_unit>& units) {
+    std::vector<std::vector<log_unit>> per_file(files.size());
+    std::vector<std::string> errors(files.size());
+    std::atomic<size_t> next {0};
+
+    auto work = [&]() {
+        for (size_t i; (i = next.fetch_add(1)) < files.size();) {
+            int fd = open(files[i].c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) != 0) {
+                errors[i] = strerror(errno);
+                if (fd >= 0)
+                    close(fd);
+                continue;
+            }
+
+            void* data = st.st_size ? mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+            close(fd);
+            if (data == MAP_FAILED) {
+                errors[i] = st.st_size ? strerror(errno) : "empty file";
+                continue;
+            }
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+            // Only csv so far, other formats get their parser here
+            log_unit_builder builder(first_log + i, unit_ms);
+            bool ok = parse_csv_log(static_cast<const char*>(data), st.st_size,
+                                    [&](float frametime, double elapsed) { builder.add(frametime, elapsed); });
+            munmap(data, st.st_size);
+            if (!ok) {
+                errors[i] = "not a MangoHud log";
+                continue;
+            }
+            per_file[i] = builder.finish();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < std::min<size_t>(jobs, files.size()); i++)
+        threads.emplace_back(work);
+    work();
+    for (auto& t : threads)
+        t.join();
+
+    bool ok = true;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!errors[i].empty()) {
+            fprintf(stderr, "%s: %s\n", files[i].c_str(), errors[i].c_str());
+            ok = false;
+        }
+        units.insert(units.end(), std::make_move_iterator(per_file[i].begin()),
+                     std::make_move_iterator(per_file[i].end()));
+    }
+    return ok;
+}
+
+// Better or worse takes an interval clear of 0 and a change of at least
+// threshold %, a significant 0.1% is still the same
+static const char* verdict(size_t metric, const metric_comparison& m, double threshold) {
+    if ((m.ci_low <= 0 && m.ci_high >= 0) || std::abs(m.change) < threshold)
+        return "same";
+    bool higher = m.ci_low > 0;
+    return higher == log_metric_higher_is_better(metric) ? "better" : "worse";
+}
+
+static int compare(int argc, char* argv[]) {
+    options opts;
+    std::vector<std::string> files[2];
+    int side = 0;
+
+    for (int i = 0; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "vs")) {
+            if (side++)
+                help_and_quit();
+        } else if (!strcmp(arg, "-j")) {
+            opts.jobs = parse_number_arg(arg, value);
+            i++;
+        } else if (!strcmp(arg, "-r")) {
+            opts.resamples = parse_number_arg(arg, value);
+            i++;
+        } else if (!strcmp(arg, "-u")) {
+            opts.unit_s = parse_number_arg(arg, value);
+            i++;
+        } else if (!strcmp(arg, "-t")) {
+            opts.threshold = parse_number_arg(arg, value);
+            i++;
+        } else if (!strcmp(arg, "-s")) {
+            opts.seed = parse_number_arg(arg, value);
+            i++;
+        } else if (arg[0] == '-') {
+            help_and_quit();
+        } else {
+            files[side].push_back(arg);
+        }
+    }
+    if (files[0].empty() || files[1].empty())
+        help_and_quit();
+
+    std::vector<log_unit> units[2];
+    bool ok = read_logs(files[0], 0, opts.unit_s * 1000, opts.jobs, units[0]);
+    ok &= read_logs(files[1], files[0].size(), opts.unit_s * 1000, opts.jobs, units[1]);
+    if (!ok)
+        return 1;
+    if (units[0].empty() || units[1].empty()) {
+        fprintf(stderr, "No frames in the logs of %s\n", units[0].empty() ? "A" : "B");
+        return 1;
+    }
+    for (auto& u : units)
+        coarsen_log_units(u, max_units);
+
+    log_comparison c = compare_log_units(units[0], units[1], opts.resamples, opts.jobs, opts.seed);
+
+    printf("A: %zu logs, %zu stretches\n", files[0].size(), c.units_a);
+    printf("B: %zu logs, %zu stretches\n\n", files[1].size(), c.units_b);
+    printf("%-20s %10s %10s %9s %20s  %s\n", "", "A", "B", "Change", "95% CI", "Verdict");
+    for (size_t m = 0; m < LOG_METRIC_COUNT; m++) {
+        const metric_comparison& mc = c.metrics[m];
+        char ci[32];
+        snprintf(ci, sizeof(ci), "[%+.2f%%, %+.2f%%]", mc.ci_low, mc.ci_high);
+        printf("%-20s %10.2f %10.2f %+8.2f%% %20s  %s\n", log_metric_name(m), mc.a, mc.b, mc.change, ci,
+               verdict(m, mc, opts.threshold));
+    }
+    printf("\nMann-Whitney over the average fps of the stretches: p = %.4g, B faster %.0f%% of the time\n",
+           c.mann_whitney_p, 100 * c.superiority);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2)
+        help_and_quit();
+    if (!strcmp(argv[1], "compare"))
+        return compare(argc - 2, argv + 2);
+    help_and_quit();
+}
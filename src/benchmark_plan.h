@@ -0,0 +1,211 @@
+#pragma once
+#ifndef MANGOHUD_BENCHMARK_PLAN_H
+#define MANGOHUD_BENCHMARK_PLAN_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "frametime_histogram.h"
+
+struct benchmark_run_result {
+    uint32_t fps_limit;          // 0 without one
+    double duration_s;
+    uint64_t frames;
+    float avg_fps;
+    float low_1;                 // 1% and 0.1% min fps
+    float low_01;
+};
+
+/*
+ * A benchmark plan: runs of warm-up, then a measured log, then cool-down,
+ * repeated, each with its own fps limit if there is a list of them.
+ *
+ * Phases are timed by summing frametimes, so every phase starts and ends on
+ * a frame boundary and a hitch counts for exactly as long as it took. The
+ * measured frames of every run go into a histogram of their own, so the
+ * results don't depend on log_interval.
+ *
+ * start(), abort() and started() are safe from any thread, everything else
+ * runs on the present thread. add() returns the steps the caller has to take for the
+ * frame, in the order of the step bits.
+ */
+class benchmark_plan {
+public:
+    enum step : unsigned {
+        none          = 0,
+        stop_log      = 1 << 0,
+        restore_limit = 1 << 1, // back to the configured fps limit
+        apply_limit   = 1 << 2, // fps_limit() of the run starting
+        start_log     = 1 << 3,
+        finished      = 1 << 4, // every run is done, results() are complete
+    };
+
+    enum class phase { idle, warmup, measure, cooldown };
+
+    struct options {
+        float warmup_s = 0;
+        float duration_s = 60;
+        float cooldown_s = 0;
+        unsigned runs = 1;
+        std::vector<uint32_t> fps_limits;  // used in turn, 0 for no limit
+
+        bool operator==(const options& o) const {
+            return warmup_s == o.warmup_s && duration_s == o.duration_s &&
+                   cooldown_s == o.cooldown_s && runs == o.runs && fps_limits == o.fps_limits;
+        }
+        bool operator!=(const options& o) const { return !(*this == o); }
+    };
+
+    explicit benchmark_plan(const options& opts) : opts(opts) {
+        if (this->opts.runs == 0)
+            this->opts.runs = 1;
+    }
+
+    void start() { start_requested.store(true, std::memory_order_release); }
+    void abort() { abort_requested.store(true, std::memory_order_release); }
+
+    unsigned add(float frametime_ms) {
+        unsigned steps = none;
+
+        if (abort_requested.load(std::memory_order_relaxed) &&
+            abort_requested.exchange(false, std::memory_order_acquire)) {
+            start_requested.store(false, std::memory_order_relaxed);
+            if (current == phase::idle)
+                return none;
+            if (current == phase::measure)
+                steps |= stop_log;
+            if (!opts.fps_limits.empty())
+                steps |= restore_limit;
+            current = phase::idle;
+            return steps;
+        }
+
+        if (current == phase::idle) {
+            if (!start_requested.load(std::memory_order_relaxed) ||
+                !start_requested.exchange(false, std::memory_order_acquire))
+                return none;
+            has_started.store(true, std::memory_order_relaxed);
+            run_results.clear();
+            run_idx = 0;
+            return steps | begin_run();
+        }
+
+        phase_ms += frametime_ms;
+        if (current == phase::measure)
+            frames.add(frametime_ms);
+
+        switch (current) {
+        case phase::warmup:
+            if (phase_ms >= opts.warmup_s * 1000)
+                steps |= enter(phase::measure);
+            break;
+        case phase::measure:
+            if (phase_ms >= opts.duration_s * 1000) {
+                steps |= end_measure();
+                steps |= enter(phase::cooldown);
+            }
+            break;
+        case phase::cooldown:
+            if (phase_ms >= opts.cooldown_s * 1000)
+                steps |= next_run();
+            break;
+        case phase::idle:
+            break;
+        }
+        return steps;
+    }
+
+    phase state() const { return current; }
+    bool running() const { return current != phase::idle; }
+    // Ever started, even if done or aborted since. Safe from any thread.
+    bool started() const { return has_started.load(std::memory_order_relaxed); }
+    unsigned run() const { return run_idx; }
+    unsigned runs() const { return opts.runs; }
+    const options& settings() const { return opts; }
+
+    uint32_t fps_limit() const {
+        return opts.fps_limits.empty() ? 0 : opts.fps_limits[run_idx % opts.fps_limits.size()];
+    }
+
+    // The completed runs, oldest first
+    const std::vector<benchmark_run_result>& results() const { return run_results; }
+
+    // Mean and sample standard deviation of field over the runs
+    template <typename T>
+    static void mean_sd(const std::vector<benchmark_run_result>& results, T benchmark_run_result::*field,
+                        double& mean, double& sd) {
+        mean = 0;
+        sd = 0;
+        if (results.empty())
+            return;
+        for (auto& r : results)
+            mean += r.*field;
+        mean /= results.size();
+        if (results.size() < 2)
+            return;
+        for (auto& r : results)
+            sd += (r.*field - mean) * (r.*field - mean);
+        sd = std::sqrt(sd / (results.size() - 1));
+    }
+
+private:
+    unsigned begin_run() {
+        unsigned steps = opts.fps_limits.empty() ? none : apply_limit;
+        // Without a warm-up the measurement starts with this frame
+        return steps | enter(opts.warmup_s > 0 ? phase::warmup : phase::measure);
+    }
+
+    unsigned enter(phase next) {
+        current = next;
+        phase_ms = 0;
+        if (next != phase::measure)
+            return none;
+        frames.clear();
+        return start_log;
+    }
+
+    unsigned end_measure() {
+        benchmark_run_result r {};
+        r.fps_limit = fps_limit();
+        r.duration_s = frames.sum() / 1000;
+        r.frames = frames.count();
+        if (r.frames) {
+            r.avg_fps = 1000.f / frames.average();
+            r.low_1 = 1000.f / frames.slowest(std::max(0.01 * r.frames - 1, 0.0));
+            r.low_01 = 1000.f / frames.slowest(std::max(0.001 * r.frames - 1, 0.0));
+        }
+        run_results.push_back(r);
+        return stop_log;
+    }
+
+    unsigned next_run() {
+        if (++run_idx < opts.runs)
+            return begin_run();
+
+        current = phase::idle;
+        return (opts.fps_limits.empty() ? none : restore_limit) | finished;
+    }
+
+    options opts;
+    std::atomic<bool> start_requested {false};
+    std::atomic<bool> abort_requested {false};
+    std::atomic<bool> has_started {false};
+
+    // Only touched by the present thread
+    phase current = phase::idle;
+    unsigned run_idx = 0;
+    double phase_ms = 0;
+    frametime_histogram frames;
+    std::vector<benchmark_run_result> run_results;
+};
+
+// Swapped by config reloads on the notifier thread while the present,
+// hwinfo, keybind and control paths use it, load it once per use. A
+// replaced plan is leaked on purpose, nothing tells when the last reader
+// let go of it.
+extern std::atomic<benchmark_plan*> bench_plan;
+
+#endif //MANGOHUD_BENCHMARK_PLAN_H
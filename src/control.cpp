@@ -7,6 +7,7 @@
 #include "overlay.h"
 #include "version.h"
 #include "app/mangoapp.h"
+#include "benchmark_plan.h"
 
 int global_control_client;
 
@@ -33,6 +34,14 @@ static void parse_command(overlay_params &params,
          else
             logger->start_logging();
       }
+   } else if (!strncmp(cmd, "benchmark", cmdlen)) {
+      // Any trigger, the socket is asked explicitly. "benchmark=0" aborts.
+      if (benchmark_plan* plan = bench_plan.load(std::memory_order_acquire)) {
+         if (param && param[0] && !atoi(param))
+            plan->abort();
+         else
+            plan->start();
+      }
    } else if (!strncmp(cmd, "fcat", cmdlen)) {
       params.enabled[OVERLAY_PARAM_ENABLED_fcat] = !params.enabled[OVERLAY_PARAM_ENABLED_fcat];
    }
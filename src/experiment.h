@@ -0,0 +1,208 @@
+#pragma once
+#ifndef MANGOHUD_EXPERIMENT_H
+#define MANGOHUD_EXPERIMENT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "frametime_histogram.h"
+
+// One combination of the settings an experiment switches between. Settings
+// left at keep stay as configured.
+struct experiment_variant {
+    static constexpr int keep = std::numeric_limits<int>::min();
+
+    std::string name;            // e.g. "fps_limit=60 fps_limit_method=early"
+    int fps_limit = keep;        // 0 for no limit
+    int fps_limit_method = keep; // enum fps_limit_method
+    int gl_vsync = keep;         // swap interval
+};
+
+struct experiment_result {
+    std::string name;
+    uint32_t intervals;          // completed, each one sample of the fps
+    uint64_t frames;
+    double avg_fps;              // mean over the intervals
+    double ci95;                 // half width of its 95% confidence interval
+    float low_1;                 // 1% and 0.1% min fps over all settled frames
+    float low_01;
+    double change;               // % avg fps against the first variant
+    double change_ci95;          // half width, in the same %
+};
+
+/*
+ * A/B experiment over one session: cycles through the variants, interval_ms
+ * of frames each, round after round, so every variant sees the same scenes
+ * and drift (heat, a changing game) hits them alike.
+ *
+ * The first settle_ms after a switch are left out, the limiter and the
+ * driver need a few frames to follow. Every completed interval is one sample
+ * of a variant's fps, the confidence intervals are Student's t over those
+ * samples and Welch's for the change against the first variant, so they need
+ * a couple of rounds to mean anything.
+ *
+ * add() runs on the present thread and returns true when the caller has to
+ * apply current(). Results are published at the end of every interval, for
+ * results() on any thread.
+ */
+class ab_experiment {
+public:
+    ab_experiment(std::vector<experiment_variant> variants, uint32_t interval_ms, uint32_t settle_ms)
+        : variants(std::move(variants)), interval_ms(interval_ms),
+          settle_ms(std::min(settle_ms, interval_ms / 2)), stats(this->variants.size())
+    {
+    }
+
+    bool add(float frametime_ms) {
+        if (restart_requested.load(std::memory_order_relaxed) &&
+            restart_requested.exchange(false, std::memory_order_acquire)) {
+            for (variant_stats& s : stats) {
+                s.frames.clear();
+                s.intervals = 0;
+                s.mean = 0;
+                s.m2 = 0;
+            }
+            switch_to(0);
+            publish();
+            return true;
+        }
+
+        interval_time += frametime_ms;
+        if (interval_time > settle_ms) {
+            variant_stats& s = stats[idx];
+            s.frames.add(frametime_ms);
+            interval_frames++;
+            settled_time += frametime_ms;
+        }
+
+        if (interval_time < interval_ms)
+            return false;
+
+        // Welford, over the fps of each interval
+        variant_stats& s = stats[idx];
+        double fps = 1000.0 * interval_frames / settled_time;
+        s.intervals++;
+        double delta = fps - s.mean;
+        s.mean += delta / s.intervals;
+        s.m2 += delta * (fps - s.mean);
+
+        switch_to((idx + 1) % variants.size());
+        publish();
+        return true;
+    }
+
+    const experiment_variant& current() const { return variants[idx]; }
+    const experiment_variant& variant(size_t i) const { return variants[i]; }
+    size_t num_variants() const { return variants.size(); }
+    uint32_t interval() const { return interval_ms; }
+
+    // Safe from any thread, starts over from the first variant on the next
+    // frame. A new experiment starts that way too, so its first add() asks
+    // for the first variant to be applied.
+    void restart() { restart_requested.store(true, std::memory_order_release); }
+
+    // As of the last completed interval
+    std::vector<experiment_result> results() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return published;
+    }
+
+    // Two sided 95% quantile of Student's t with df degrees of freedom
+    static double t95(double df) {
+        static const double table[] = {
+            12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+            2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+            2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+        };
+        if (!(df >= 1))
+            return std::numeric_limits<double>::infinity();
+        if (df < 30)
+            return table[size_t(df) - 1];
+        return 1.96 + 2.4 / df;
+    }
+
+private:
+    struct variant_stats {
+        frametime_histogram frames;
+        uint32_t intervals = 0;
+        double mean = 0;
+        double m2 = 0;
+    };
+
+    void switch_to(size_t next) {
+        idx = next;
+        interval_time = 0;
+        interval_frames = 0;
+        settled_time = 0;
+    }
+
+    void publish() {
+        std::vector<experiment_result> results;
+        for (size_t i = 0; i < variants.size(); i++) {
+            const variant_stats& s = stats[i];
+            experiment_result r {};
+            r.name = variants[i].name;
+            r.intervals = s.intervals;
+            r.frames = s.frames.count();
+            r.avg_fps = s.mean;
+            r.ci95 = s.intervals > 1 ? t95(s.intervals - 1) * std::sqrt(variance(s) / s.intervals)
+                                     : std::numeric_limits<double>::infinity();
+            if (r.frames) {
+                r.low_1 = 1000.f / s.frames.slowest(std::max(0.01 * r.frames - 1, 0.0));
+                r.low_01 = 1000.f / s.frames.slowest(std::max(0.001 * r.frames - 1, 0.0));
+            }
+
+            // Welch's t against the first variant
+            const variant_stats& base = stats[0];
+            r.change = base.mean > 0 ? 100.0 * (s.mean - base.mean) / base.mean : 0.0;
+            r.change_ci95 = std::numeric_limits<double>::infinity();
+            if (i == 0) {
+                r.change_ci95 = 0;
+            } else if (s.intervals > 1 && base.intervals > 1 && base.mean > 0) {
+                double a = variance(s) / s.intervals;
+                double b = variance(base) / base.intervals;
+                double df = (a + b) * (a + b) /
+                            (a * a / (s.intervals - 1) + b * b / (base.intervals - 1));
+                // Identical samples leave df at 0/0, the difference is exact then
+                double half_width = a + b > 0 ? t95(df) * std::sqrt(a + b) : 0.0;
+                r.change_ci95 = 100.0 * half_width / base.mean;
+            }
+            results.push_back(r);
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        published.swap(results);
+    }
+
+    static double variance(const variant_stats& s) {
+        return s.intervals > 1 ? s.m2 / (s.intervals - 1) : 0.0;
+    }
+
+    // Only touched by the present thread
+    const std::vector<experiment_variant> variants;
+    const double interval_ms;
+    const double settle_ms;
+    std::vector<variant_stats> stats;
+    size_t idx = 0;
+    double interval_time = 0;
+    uint64_t interval_frames = 0;
+    double settled_time = 0;
+
+    std::atomic<bool> restart_requested {true};
+
+    std::mutex mtx;
+    std::vector<experiment_result> published;
+};
+
+// Swapped by config reloads on the notifier thread while the present thread
+// runs it, load it once per use. A replaced experiment is leaked on purpose,
+// nothing tells when the last reader let go of it.
+extern std::atomic<ab_experiment*> experiment;
+
+#endif //MANGOHUD_EXPERIMENT_H
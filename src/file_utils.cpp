@@ -214,4 +214,29 @@ std::string to_lower(const std::string& str) {
     return lowered;
 }
 
+bool process_running(const std::string& name)
+{
+    // comm is cut at 15 characters
+    const std::string comm = name.substr(0, 15);
+    for (auto& pid : ls(PROCDIR)) {
+        if (!isdigit(pid[0]))
+            continue;
+        if (read_line(PROCDIR "/" + pid + "/comm") == comm)
+            return true;
+    }
+    return false;
+}
+
+// Like mkdir -p
+bool make_dirs(const std::string& path)
+{
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string dir = path.substr(0, slash);
+        if (!dir.empty() && mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+        if (slash == std::string::npos)
+            return dir_exists(path);
+    }
+}
+
 #endif // __linux__
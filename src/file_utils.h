@@ -26,5 +26,7 @@ std::string get_config_dir();
 bool lib_loaded(const std::string& lib);
 std::string remove_parentheses(const std::string&);
 std::string to_lower(const std::string& str);
+bool process_running(const std::string& name);
+bool make_dirs(const std::string& path);
 
 #endif //MANGOHUD_FILE_UTILS_H
@@ -46,3 +46,13 @@ std::string get_config_dir()
     std::string path;
     return path;
 }
+
+bool process_running(const std::string& name)
+{
+    return false;
+}
+
+bool make_dirs(const std::string& path)
+{
+    return false;
+}
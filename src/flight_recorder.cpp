@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <spdlog/spdlog.h>
+#include "flight_recorder.h"
+#include "config.h"
+#include "file_utils.h"
+#include "logging.h"
+#include "overlay.h"
+
+std::unique_ptr<flight_recorder> recorder;
+
+flight_recorder::flight_recorder()
+    : ring(capacity)
+{
+    static_assert((capacity & (capacity - 1)) == 0, "capacity has to be a power of two");
+    pending.reserve(capacity);
+
+    thread = std::thread(&flight_recorder::writer_thread, this);
+    // "mangohud-recorder" wouldn't fit in the 15 byte limit
+    pthread_setname_np(thread.native_handle(), "mangohud-record");
+}
+
+flight_recorder::~flight_recorder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        terminate = true;
+    }
+    cv.notify_one();
+    if (thread.joinable())
+        thread.join();
+}
+
+void flight_recorder::configure(const options& new_opts)
+{
+    threshold_ms.store(new_opts.threshold_ms, std::memory_order_relaxed);
+    median_multiple.store(new_opts.median_multiple, std::memory_order_relaxed);
+    window_ms.store(std::max(new_opts.seconds, 1u) * 1000, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    opts = new_opts;
+}
+
+bool flight_recorder::is_spike(float frametime_ms) const
+{
+    float threshold = threshold_ms.load(std::memory_order_relaxed);
+    float multiple = median_multiple.load(std::memory_order_relaxed);
+    float median = median_ms.load(std::memory_order_relaxed);
+
+    if (threshold <= 0 && multiple <= 0)
+        return false;
+    if (threshold > 0 && frametime_ms <= threshold)
+        return false;
+    // Wait for the first median before judging by it
+    if (multiple > 0 && (median <= 0 || frametime_ms <= multiple * median))
+        return false;
+    return true;
+}
+
+void flight_recorder::add(frame_record record)
+{
+    const double window = window_ms.load(std::memory_order_relaxed);
+
+    record.spike = is_spike(record.frametime);
+    ring[pushed % capacity] = record;
+    uint64_t seq = pushed++;
+
+    recent.add(record.frametime);
+    median_window_ms += record.frametime;
+    while (pushed - median_tail > 1 &&
+           (median_window_ms > window || pushed - median_tail > capacity)) {
+        float oldest = ring[median_tail % capacity].frametime;
+        recent.remove(oldest);
+        median_window_ms -= oldest;
+        median_tail++;
+    }
+
+    if (collecting) {
+        ms_since_spike += record.frametime;
+        // Spikes on the way restart the wait, as long as the dump fits
+        if (record.spike && seq - dump_first < capacity / 2)
+            ms_since_spike = 0;
+        if (ms_since_spike >= window || seq + 1 - dump_first >= capacity) {
+            hand_off(dump_first, seq);
+            collecting = false;
+        }
+        return;
+    }
+
+    if (!record.spike)
+        return;
+
+    // Go back as far as the window, or the oldest frame still in the ring
+    double before = 0;
+    dump_first = seq;
+    while (dump_first > 0 && seq - dump_first < capacity / 2) {
+        float frametime = ring[(dump_first - 1) % capacity].frametime;
+        if (before + frametime > window)
+            break;
+        before += frametime;
+        dump_first--;
+    }
+
+    collecting = true;
+    ms_since_spike = 0;
+}
+
+void flight_recorder::update_median()
+{
+    median_ms.store(recent.slowest(recent.count() / 2), std::memory_order_relaxed);
+}
+
+void flight_recorder::hand_off(uint64_t first, uint64_t last)
+{
+    std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+    // Never wait on the writer from the present thread
+    if (!lock.owns_lock() || has_pending) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Reserved in the constructor, this doesn't allocate
+    pending.clear();
+    for (uint64_t i = first; i <= last; i++)
+        pending.push_back(ring[i % capacity]);
+    pending_median = median_ms.load(std::memory_order_relaxed);
+    has_pending = true;
+
+    lock.unlock();
+    cv.notify_one();
+}
+
+void flight_recorder::writer_thread()
+{
+    std::vector<frame_record> frames;
+    frames.reserve(capacity);
+
+    while (true) {
+        options dump_opts;
+        float median;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this] { return has_pending || terminate; });
+            if (terminate)
+                break;
+
+            frames.swap(pending);
+            has_pending = false;
+            dump_opts = opts;
+            median = pending_median;
+        }
+
+        write_dump(frames, dump_opts, median);
+        written.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void flight_recorder::write_dump(const std::vector<frame_record>& frames, const options& dump_opts, float median)
+{
+    auto spike = std::find_if(frames.begin(), frames.end(),
+                              [](const frame_record& f) { return f.spike; });
+    if (spike == frames.end())
+        return;
+
+    std::string program = get_wine_exe_name();
+    if (program.empty())
+        program = get_program_name();
+
+    // With milliseconds, hitches a second apart would overwrite each other
+    auto now = std::chrono::system_clock::now();
+    time_t now_s = std::chrono::system_clock::to_time_t(now);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+    std::ostringstream name;
+    name << dump_opts.output_folder << "/" << program << "_hitch_"
+         << std::put_time(localtime(&now_s), "%Y-%m-%d_%H-%M-%S") << "-"
+         << std::setfill('0') << std::setw(3) << ms << ".csv";
+
+    std::ofstream out(name.str(), std::ios::out | std::ios::trunc);
+    if (!out) {
+        SPDLOG_ERROR("Failed to write hitch report [{}]", name.str());
+        return;
+    }
+
+    out << "program,spike_frametime,median_frametime,threshold,median_multiple\n";
+    out << program << "," << spike->frametime << "," << median << ","
+        << dump_opts.threshold_ms << "," << dump_opts.median_multiple << "\n";
+
+    out << "frame,time,frametime,spike,cpu_load,cpu_power,gpu_load,cpu_temp,"
+        << "gpu_temp,gpu_core_clock,gpu_mem_clock,gpu_vram_used,gpu_power,"
+        << "ram_used,swap_used,process_rss,cpu_mhz,fex_sigbus,fex_smc,fex_softfloat";
+    size_t num_traces = std::min(dump_opts.trace_names.size(), size_t(max_trace_values));
+    for (size_t i = 0; i < num_traces; i++)
+        out << "," << dump_opts.trace_names[i];
+    out << "\n";
+
+    // Frames are numbered and timed from the first spike, the ones before
+    // it negative
+    int64_t spike_idx = spike - frames.begin();
+    for (size_t i = 0; i < frames.size(); i++) {
+        const frame_record& f = frames[i];
+        const hw_values& hw = f.hw;
+        out << int64_t(i) - spike_idx << ","
+            << (int64_t(f.present_ns) - int64_t(spike->present_ns)) / 1000000.0 << ","
+            << f.frametime << "," << f.spike << ","
+            << hw.cpu_load << "," << hw.cpu_power << "," << hw.gpu_load << ","
+            << hw.cpu_temp << "," << hw.gpu_temp << "," << hw.gpu_core_clock << ","
+            << hw.gpu_mem_clock << "," << hw.gpu_vram_used << "," << hw.gpu_power << ","
+            << hw.ram_used << "," << hw.swap_used << "," << hw.process_rss << ","
+            << hw.cpu_mhz << "," << f.fex_sigbus << "," << f.fex_smc << ","
+            << f.fex_softfloat;
+        for (size_t t = 0; t < num_traces; t++)
+            out << "," << f.trace[t];
+        out << "\n";
+    }
+
+    SPDLOG_INFO("Wrote hitch report [{}]", name.str());
+}
@@ -0,0 +1,112 @@
+#pragma once
+#ifndef MANGOHUD_FLIGHT_RECORDER_H
+#define MANGOHUD_FLIGHT_RECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frametime_histogram.h"
+
+/*
+ * Always-on recorder of the last frames, dumping the ones around a hitch.
+ *
+ * Every frame goes into a fixed ring of frame_record, nothing is allocated
+ * after construction. A frame slower than the absolute threshold and/or the
+ * multiple of the rolling median is a spike. Once flight_recorder_seconds
+ * of frames followed it, the frames from that long before it up to then are
+ * copied out and a background thread writes them to output_folder, with the
+ * hardware snapshot that was current at each frame. Spikes while a dump is
+ * being collected end up in the same dump, spikes while the previous one is
+ * still being written are counted and dropped.
+ *
+ * add() and update_median() run on the present thread, configure() on any.
+ */
+class flight_recorder {
+public:
+    static constexpr size_t capacity = 16384;  // frames, a power of two
+    static constexpr size_t max_trace_values = 4;
+
+    // What hw_snapshots held at the frame, what the HUD showed
+    struct hw_values {
+        float cpu_load, cpu_power, cpu_temp, cpu_mhz;
+        float gpu_load, gpu_temp, gpu_core_clock, gpu_mem_clock, gpu_vram_used, gpu_power;
+        float ram_used, swap_used, process_rss;
+    };
+
+    struct frame_record {
+        uint64_t present_ns;   // metrics_clock_ns() at the present
+        float frametime;       // ms
+        bool spike;
+        hw_values hw;
+        uint32_t fex_sigbus;
+        uint32_t fex_smc;
+        uint32_t fex_softfloat;
+        float trace[max_trace_values];  // ftrace tracepoint values, if enabled
+    };
+
+    struct options {
+        float threshold_ms;    // 0 to only use the median
+        float median_multiple; // 0 to only use the threshold
+        unsigned seconds;      // kept before and recorded after a spike
+        std::string output_folder;
+        std::vector<std::string> trace_names;
+    };
+
+    flight_recorder();
+    ~flight_recorder();
+
+    void configure(const options& opts);
+
+    // Present thread, every frame. record has everything but spike filled.
+    void add(frame_record record);
+
+    // Present thread, once per sampling period
+    void update_median();
+
+    uint64_t dumps() const { return written.load(std::memory_order_relaxed); }
+    uint64_t dropped_dumps() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    bool is_spike(float frametime_ms) const;
+    void hand_off(uint64_t first, uint64_t last);
+    void writer_thread();
+    void write_dump(const std::vector<frame_record>& frames, const options& opts, float median);
+
+    // Only touched by the present thread
+    std::vector<frame_record> ring;
+    uint64_t pushed = 0;
+    // Frames in the median window, from median_tail up to pushed
+    frametime_histogram recent;
+    uint64_t median_tail = 0;
+    double median_window_ms = 0;
+    // The spike being collected, if any
+    bool collecting = false;
+    uint64_t dump_first = 0;
+    double ms_since_spike = 0;
+
+    std::atomic<float> threshold_ms {0};
+    std::atomic<float> median_multiple {3};
+    std::atomic<unsigned> window_ms {5000};
+    std::atomic<float> median_ms {0};
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    options opts;
+    std::vector<frame_record> pending;
+    float pending_median = 0;
+    bool has_pending = false;
+    bool terminate = false;
+    std::thread thread;
+
+    std::atomic<uint64_t> written {0};
+    std::atomic<uint64_t> dropped {0};
+};
+
+extern std::unique_ptr<flight_recorder> recorder;
+
+#endif //MANGOHUD_FLIGHT_RECORDER_H
@@ -10,7 +10,11 @@
 #include <condition_variable>
 #include <stdexcept>
 #include <iomanip>
+#include <atomic>
 #include <spdlog/spdlog.h>
+#include "spsc_ring.h"
+#include "frametime_histogram.h"
+#include "steady_state.h"
 
 struct metric_t {
     std::string name;
@@ -20,15 +24,34 @@ struct metric_t {
 
 class fpsMetrics {
     private:
-        std::vector<float> frametimes;
+        // Frames since the start or the last reset, and the rolling windows
+        // fps_metrics_window picks from. Only touched by the metrics thread.
+        frametime_stats stats {{ 1000, 10000, 60000 }};
+        std::atomic<uint32_t> window_s {0};
         std::thread thread;
         std::mutex mtx;
         std::condition_variable cv;
         bool run = false;
         bool thread_init = false;
         bool terminate = false;
-        bool resetting = false;
-        size_t max_size = 10000;
+
+        // Frames from the present thread on their way to stats. Big
+        // enough for several seconds of frames at 10000 fps between two
+        // sampling periods.
+        spsc_ring<float, 32768> incoming;
+        // Position in incoming of the last reset, anything older is dropped
+        std::atomic<uint64_t> reset_at {0};
+        uint64_t applied_reset = 0;
+
+        // Warm-up/steady/stall segments of the run, fed on the metrics
+        // thread and published after every run of it
+        steady_state_detector detector;
+        std::atomic<bool> detect_steady {false};
+        std::atomic<uint64_t> segments_from {0};
+        uint64_t applied_segments_from = 0;
+        std::atomic<run_segment> current_segment {run_segment::warmup};
+        std::mutex segments_mtx;
+        std::vector<segment_stats> published_segments;
 
         void _thread() {
             thread_init = true;
@@ -39,26 +62,63 @@ class fpsMetrics {
                 if (terminate)
                     break;
 
-                calculate();
+                collect();
+                calculate(current_histogram());
 
                 run = false;
             }
         }
 
-        void calculate(){
-            std::vector<float> sorted_values = frametimes;
-            std::sort(sorted_values.begin(), sorted_values.end(), std::greater<float>());
+        void collect() {
+            uint64_t reset = reset_at.load(std::memory_order_acquire);
+            if (reset != applied_reset) {
+                stats.clear();
+                applied_reset = reset;
+            }
+
+            uint64_t restart = segments_from.load(std::memory_order_acquire);
+            bool detect = detect_steady.load(std::memory_order_relaxed);
+
+            incoming.drain([&](uint64_t pos, float frametime) {
+                if (pos >= reset)
+                    stats.add(frametime);
+
+                if (!detect)
+                    return;
+                if (restart != applied_segments_from && pos >= restart) {
+                    detector.restart_segments();
+                    applied_segments_from = restart;
+                }
+                detector.add(frametime);
+            });
+
+            if (detect) {
+                current_segment.store(detector.state(), std::memory_order_relaxed);
+                std::vector<segment_stats> segments = detector.segments();
+                std::lock_guard<std::mutex> lock(segments_mtx);
+                published_segments.swap(segments);
+            }
+        }
 
+        // The session, or the shortest window at least window_s long
+        const frametime_histogram& current_histogram() const {
+            uint32_t ms = window_s.load(std::memory_order_relaxed) * 1000;
+            if (ms == 0)
+                return stats.session();
+
+            size_t idx = 0;
+            while (idx + 1 < stats.num_windows() && stats.window_ms(idx) < ms)
+                idx++;
+            return stats.window(idx);
+        }
+
+        void calculate(const frametime_histogram& frametimes){
             auto it = metrics.begin();
             while (it != metrics.end()) {
                 if (it->name == "AVG") {
                     it->display_name = it->name;
 
-                    float sum = 0.0f;
-                    for (const auto& f : sorted_values)
-                        sum += f;
-
-                    float avg = 1000.f / (sum / sorted_values.size());
+                    float avg = 1000.f / frametimes.average();
                     it->value = avg;
                 } else {
                     try {
@@ -75,11 +135,11 @@ class fpsMetrics {
                         stream << std::fixed << std::setprecision(multiplied_val == static_cast<int>(multiplied_val) ? 0 : 1)
                                << multiplied_val << "%";
                         it->display_name = stream.str();
-                        uint64_t idx = val * sorted_values.size() - 1;
-                        if (idx >= sorted_values.size())
+                        uint64_t idx = std::max(val * frametimes.count() - 1, 0.f);
+                        if (idx >= frametimes.count())
                             break;
 
-                        it->value = 1000.f / sorted_values[idx];
+                        it->value = 1000.f / frametimes.slowest(idx);
                     } catch (const std::invalid_argument& e) {
                         SPDLOG_DEBUG("Failed to use fps metric value {}", it->name);
                         it = metrics.erase(it);
@@ -114,34 +174,20 @@ class fpsMetrics {
             }
         };
 
-        fpsMetrics(std::vector<std::string> values, std::vector<float> only_frametime) {
+        fpsMetrics(std::vector<std::string> values, const frametime_histogram& frametimes) {
             metrics = add_metrics_to_vector(values);
-            for (auto& frametime : only_frametime)
-                frametimes.push_back(frametime);
-
-            calculate();
+            calculate(frametimes);
         };
 
+        // Present thread, every frame. Never blocks, the metrics thread
+        // picks the frame up on its next run.
         void update(float new_frametime) {
-            if (resetting)
-                return;
-
             if (new_frametime > 100000) return; // Ignore extremely long frames
 
-            // lock before modifying vector
-            std::lock_guard<std::mutex> lock(mtx);
-
-            if (frametimes.size() >= max_size)
-                frametimes.erase(frametimes.begin());
-
-            frametimes.push_back(new_frametime);
+            incoming.push(new_frametime);
         }
 
-
         void update_thread(){
-            if (resetting)
-                return;
-
             {
                 std::lock_guard<std::mutex> lock(mtx);
                 run = true;
@@ -149,11 +195,40 @@ class fpsMetrics {
             cv.notify_one();
         }
 
+        // Seconds of the rolling window to show, 0 for the whole session.
+        // Safe from any thread, applies on the next sampling period.
+        void set_window(uint32_t seconds) {
+            window_s.store(seconds, std::memory_order_relaxed);
+        }
+
+        // Safe from any thread, frames presented from here on start over
         void reset_metrics(){
-            resetting = true;
-            while (run){}
-            frametimes.clear();
-            resetting = false;
+            reset_at.store(incoming.pushed(), std::memory_order_release);
+        }
+
+        // Safe from any thread, applies on the next sampling period
+        void set_steady_state(bool enabled) {
+            detect_steady.store(enabled, std::memory_order_relaxed);
+        }
+
+        bool detects_steady_state() const {
+            return detect_steady.load(std::memory_order_relaxed);
+        }
+
+        // As of the last sampling period
+        run_segment segment() const {
+            return current_segment.load(std::memory_order_relaxed);
+        }
+
+        // Safe from any thread, segments start over with the frames
+        // presented from here on, e.g. the ones of a new log
+        void restart_segments() {
+            segments_from.store(incoming.pushed(), std::memory_order_release);
+        }
+
+        std::vector<segment_stats> segments() {
+            std::lock_guard<std::mutex> lock(segments_mtx);
+            return published_segments;
         }
 
         ~fpsMetrics(){
@@ -0,0 +1,173 @@
+#pragma once
+#ifndef MANGOHUD_FRAME_PACING_H
+#define MANGOHUD_FRAME_PACING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include "frametime_histogram.h"
+
+struct frame_pacing_summary {
+    uint64_t frames = 0;
+    float jitter_p50 = 0;       // ms between consecutive frametimes
+    float jitter_p99 = 0;
+    float off_pace = 0;         // % of frames further than the threshold from the target
+    uint64_t missed_vblanks = 0;
+    bool vblanks_known = false; // no refresh rate or fps limit to count vblanks with
+    float stutter_index = 0;    // % of the time spent running late
+};
+
+/*
+ * How evenly frames are paced, which the fps and its lows don't show: 60 fps
+ * alternating 8 and 25 ms frames has the same lows as a steady 60 fps.
+ *
+ * Every frame is compared to the one before (jitter) and to the target
+ * frametime, which is the fps limit or, without one, the average of the
+ * window. A frame further than the threshold from the target is off pace, and
+ * the time it ran late over the target adds to the stutter index. With a
+ * refresh rate, or an fps limit standing in for one, each frame is also
+ * rounded to vblanks to estimate how many it missed.
+ *
+ * add() is O(1) and runs on the present thread. Percentiles are only walked
+ * in publish(), once per fps sampling period, for the last window_ms and for
+ * the session (since the start or the last reset_session()).
+ */
+class frame_pacing_stats {
+public:
+    static constexpr uint32_t window_ms = 10000;
+
+    void set_threshold(unsigned percent) { threshold.store(percent, std::memory_order_relaxed); }
+
+    // Asks the present thread to start a new session with its next frame
+    void reset_session() { reset_requested.store(true, std::memory_order_release); }
+
+    // target_ms and vblank_ms are 0 when unknown
+    void add(float frametime_ms, float target_ms, float vblank_ms) {
+        if (reset_requested.load(std::memory_order_relaxed) &&
+            reset_requested.exchange(false, std::memory_order_acquire))
+            session.clear();
+
+        if (target_ms <= 0)
+            target_ms = window.frames ? window.ms / window.frames : frametime_ms;
+
+        frame f;
+        f.frametime = frametime_ms;
+        f.jitter = window.frames ? std::abs(frametime_ms - previous) : 0.f;
+
+        float deviation = frametime_ms - target_ms;
+        float allowed = target_ms * threshold.load(std::memory_order_relaxed) / 100.f;
+        f.off_pace = std::abs(deviation) > allowed;
+        f.late = deviation > allowed ? deviation : 0.f;
+
+        f.missed = 0;
+        if (vblank_ms > 0) {
+            long expected = std::max(1L, std::lround(target_ms / vblank_ms));
+            long shown = std::lround(frametime_ms / vblank_ms);
+            f.missed = shown > expected ? uint32_t(shown - expected) : 0;
+        }
+        vblanks_known = vblank_ms > 0;
+        previous = frametime_ms;
+
+        session.add(f);
+        window.add(f);
+        recent.push_back(f);
+
+        while (window.frames > 1 && window.ms > window_ms) {
+            window.remove(recent.front());
+            recent.pop_front();
+        }
+    }
+
+    // Present thread, once per sampling period
+    void publish() {
+        frame_pacing_summary w = window.summary(vblanks_known);
+        frame_pacing_summary s = session.summary(vblanks_known);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        published_window = w;
+        published_session = s;
+    }
+
+    // As of the last publish(), from any thread
+    frame_pacing_summary last_window() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return published_window;
+    }
+
+    frame_pacing_summary last_session() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return published_session;
+    }
+
+private:
+    struct frame {
+        float frametime;
+        float jitter;
+        float late;
+        bool off_pace;
+        uint32_t missed;
+    };
+
+    struct totals {
+        frametime_histogram jitter;
+        uint64_t frames = 0;
+        uint64_t off_pace = 0;
+        uint64_t missed = 0;
+        double ms = 0;
+        double late_ms = 0;
+
+        void add(const frame& f) {
+            jitter.add(f.jitter);
+            frames++;
+            off_pace += f.off_pace;
+            missed += f.missed;
+            ms += f.frametime;
+            late_ms += f.late;
+        }
+
+        void remove(const frame& f) {
+            jitter.remove(f.jitter);
+            frames--;
+            off_pace -= f.off_pace;
+            missed -= f.missed;
+            ms -= f.frametime;
+            late_ms -= f.late;
+        }
+
+        void clear() { *this = totals(); }
+
+        frame_pacing_summary summary(bool vblanks_known) const {
+            frame_pacing_summary s;
+            if (!frames)
+                return s;
+
+            s.frames = frames;
+            s.jitter_p50 = jitter.slowest(frames / 2);
+            s.jitter_p99 = jitter.slowest(frames / 100);
+            s.off_pace = 100.f * off_pace / frames;
+            s.missed_vblanks = missed;
+            s.vblanks_known = vblanks_known;
+            s.stutter_index = ms > 0 ? 100.f * late_ms / ms : 0.f;
+            return s;
+        }
+    };
+
+    std::atomic<unsigned> threshold {20};
+    std::atomic<bool> reset_requested {false};
+
+    // Only touched by the present thread
+    totals session, window;
+    std::deque<frame> recent;  // frames in window, oldest first
+    float previous = 0;
+    bool vblanks_known = false;
+
+    mutable std::mutex mtx;
+    frame_pacing_summary published_window, published_session;
+};
+
+extern frame_pacing_stats pacing_stats;
+
+#endif //MANGOHUD_FRAME_PACING_H
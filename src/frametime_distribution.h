@@ -0,0 +1,99 @@
+#pragma once
+#ifndef MANGOHUD_FRAMETIME_DISTRIBUTION_H
+#define MANGOHUD_FRAMETIME_DISTRIBUTION_H
+
+#include <cmath>
+#include <cstdint>
+#include <deque>
+
+/*
+ * Frametime counts in a few log-scaled bins for drawing as a bar chart,
+ * where a bimodal distribution (shader compiles, CPU/GPU bound frames
+ * taking turns) shows up as two humps.
+ *
+ * Bins are a quarter of an octave wide from 1 ms to 256 ms, so 60 and 144
+ * fps land a few bins apart. Faster frames count towards the first bin,
+ * slower ones towards the last. Counts cover the session, or with a window
+ * the newest frames adding up to no more than window_ms. add() is O(1),
+ * amortised over the frames leaving the window.
+ */
+class frametime_distribution {
+public:
+    static constexpr int bins_per_octave = 4;
+    static constexpr int octaves = 8;
+    static constexpr int num_bins = bins_per_octave * octaves;
+    static constexpr float min_ms = 1.f;
+
+    explicit frametime_distribution(uint32_t window_ms = 0) : window(window_ms) {}
+
+    // 0 for the whole session, drops everything counted so far
+    void set_window(uint32_t window_ms) {
+        window = window_ms;
+        clear();
+    }
+
+    uint32_t window_ms() const { return window; }
+
+    void add(float frametime_ms) {
+        int b = bin(frametime_ms);
+        counts[b]++;
+        total++;
+
+        if (!window)
+            return;
+
+        recent.push_back({ frametime_ms, b });
+        ms += frametime_ms;
+        while (recent.size() > 1 && ms > window) {
+            counts[recent.front().bin]--;
+            total--;
+            ms -= recent.front().frametime;
+            recent.pop_front();
+        }
+    }
+
+    void clear() {
+        for (uint32_t& c : counts)
+            c = 0;
+        total = 0;
+        ms = 0;
+        recent.clear();
+    }
+
+    uint64_t count() const { return total; }
+    uint32_t bin_count(int idx) const { return counts[idx]; }
+
+    // Lower edge of the idx-th bin, num_bins for the upper edge of the last
+    static float bin_lower_ms(int idx) {
+        return min_ms * std::exp2(float(idx) / bins_per_octave);
+    }
+
+    // Share of the frames in the idx-th bin, for ImGui::PlotHistogram()
+    static float get(void* data, int idx) {
+        const frametime_distribution& d = *static_cast<const frametime_distribution*>(data);
+        return d.total ? float(d.counts[idx]) / d.total : 0.f;
+    }
+
+private:
+    static int bin(float frametime_ms) {
+        // Also catches NaN
+        if (!(frametime_ms > min_ms))
+            return 0;
+
+        int b = int(std::log2(frametime_ms / min_ms) * bins_per_octave);
+        return b < num_bins ? b : num_bins - 1;
+    }
+
+    struct frame {
+        float frametime;
+        int bin;
+    };
+
+    uint32_t window;
+    uint32_t counts[num_bins] = {};
+    uint64_t total = 0;
+    double ms = 0;
+    std::deque<frame> recent;  // frames in the window, oldest first
+};
+
+#endif //MANGOHUD_FRAMETIME_DISTRIBUTION_H
@@ -0,0 +1,197 @@
+#pragma once
+#ifndef MANGOHUD_FRAMETIME_HISTOGRAM_H
+#define MANGOHUD_FRAMETIME_HISTOGRAM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+/*
+ * Streaming frametime percentiles, fed one frame at a time.
+ *
+ * Frametimes (ms) land in log-linear buckets, HDR histogram style: each
+ * power of two is split into 128 equal buckets, picked straight from the
+ * float's exponent and top mantissa bits. A bucket is reported as its
+ * middle, so any percentile is within 1/256 (0.4%) of the exact one from
+ * sorting the same frames. Frametimes below 0.0625 ms (above 16000 fps)
+ * land in the lowest bucket, above 131 s in the highest.
+ *
+ * Queries walk the buckets, O(num_buckets) no matter how many frames went
+ * in. The average comes from an exact running sum.
+ */
+class frametime_histogram {
+public:
+    static constexpr int sub_bucket_bits = 7;
+    static constexpr int min_exponent = -4;  // 0.0625 ms
+    static constexpr int max_exponent = 17;  // 131072 ms
+    static constexpr size_t num_buckets = size_t(max_exponent - min_exponent) << sub_bucket_bits;
+    static constexpr double max_relative_error = 1.0 / (2 << sub_bucket_bits);
+
+    frametime_histogram() : counts(num_buckets, 0) {}
+
+    void add(float frametime_ms) {
+        counts[bucket(frametime_ms)]++;
+        total++;
+        sum_ms += frametime_ms;
+    }
+
+    // Takes back a frame add()ed earlier
+    void remove(float frametime_ms) {
+        counts[bucket(frametime_ms)]--;
+        total--;
+        sum_ms -= frametime_ms;
+    }
+
+    void clear() {
+        std::fill(counts.begin(), counts.end(), 0);
+        total = 0;
+        sum_ms = 0;
+    }
+
+    uint64_t count() const { return total; }
+    double sum() const { return sum_ms; }
+    double average() const { return total ? sum_ms / total : 0.0; }
+
+    // The rank-th slowest frame, counting from 0, like indexing frametimes
+    // sorted from slowest to fastest
+    float slowest(uint64_t rank) const {
+        uint64_t seen = 0;
+        for (size_t i = num_buckets; i-- > 0;) {
+            seen += counts[i];
+            if (seen > rank)
+                return bucket_middle(i);
+        }
+        return 0.f;
+    }
+
+    // The frametime at which the slowest frames add up to ms of the run, the
+    // time-weighted counterpart of slowest(): 1% of the time rather than 1%
+    // of the frames. A single hitch weighs as much as the time it took.
+    float slowest_for(double ms) const {
+        double seen = 0;
+        for (size_t i = num_buckets; i-- > 0;) {
+            seen += counts[i] * double(bucket_middle(i));
+            if (counts[i] && seen >= ms)
+                return bucket_middle(i);
+        }
+        return 0.f;
+    }
+
+    // Frames in buckets from frametime_ms's up, within the bucket error
+    uint64_t at_least(float frametime_ms) const {
+        uint64_t n = 0;
+        for (size_t i = bucket(frametime_ms); i < num_buckets; i++)
+            n += counts[i];
+        return n;
+    }
+
+    // The bucket a frametime lands in and the frametime a bucket reports, for
+    // summaries built from the same buckets
+    static size_t bucket(float frametime_ms) {
+        static const float min_ms = std::ldexp(1.f, min_exponent);
+        static const float max_ms = std::ldexp(1.f, max_exponent);
+
+        // Also catches NaN
+        if (!(frametime_ms >= min_ms))
+            return 0;
+        if (frametime_ms >= max_ms)
+            return num_buckets - 1;
+
+        uint32_t bits;
+        memcpy(&bits, &frametime_ms, sizeof(bits));
+        int exponent = int((bits >> 23) & 0xff) - 127;
+        uint32_t sub_bucket = (bits >> (23 - sub_bucket_bits)) & ((1u << sub_bucket_bits) - 1);
+
+        return (size_t(exponent - min_exponent) << sub_bucket_bits) | sub_bucket;
+    }
+
+    static float bucket_middle(size_t idx) {
+        int exponent = int(idx >> sub_bucket_bits) + min_exponent;
+        double sub_bucket = idx & ((1u << sub_bucket_bits) - 1);
+        return std::ldexp(1.0 + (sub_bucket + 0.5) / (1 << sub_bucket_bits), exponent);
+    }
+
+private:
+    std::vector<uint32_t> counts;
+    uint64_t total = 0;
+    double sum_ms = 0;
+};
+
+/*
+ * Session-wide histogram plus rolling windows over the most recent frames,
+ * e.g. the last 1, 10 and 60 seconds. A window holds the newest frames
+ * whose frametimes add up to no more than its duration, so it measures
+ * time the way the game saw it and needs no clock.
+ *
+ * Frames are kept as long as the longest window needs them, to take them
+ * out of the windows' histograms again.
+ */
+class frametime_stats {
+public:
+    explicit frametime_stats(const std::vector<uint32_t>& durations_ms = {}) {
+        for (uint32_t ms : durations_ms)
+            windows.push_back({ ms, {}, 0, 0.0 });
+    }
+
+    void add(float frametime_ms) {
+        all.add(frametime_ms);
+
+        if (windows.empty())
+            return;
+
+        recent.push_back(frametime_ms);
+        size_t keep = 0;
+
+        for (rolling_window& w : windows) {
+            w.hist.add(frametime_ms);
+            w.frames++;
+            w.ms += frametime_ms;
+
+            while (w.frames > 1 && w.ms > w.duration_ms) {
+                float oldest = recent[recent.size() - w.frames];
+                w.hist.remove(oldest);
+                w.ms -= oldest;
+                w.frames--;
+            }
+
+            keep = std::max(keep, w.frames);
+        }
+
+        while (recent.size() > keep)
+            recent.pop_front();
+    }
+
+    void clear() {
+        all.clear();
+        recent.clear();
+        for (rolling_window& w : windows) {
+            w.hist.clear();
+            w.frames = 0;
+            w.ms = 0;
+        }
+    }
+
+    const frametime_histogram& session() const { return all; }
+
+    // Frames within the idx-th window passed to the constructor
+    const frametime_histogram& window(size_t idx) const { return windows[idx].hist; }
+    size_t num_windows() const { return windows.size(); }
+    uint32_t window_ms(size_t idx) const { return windows[idx].duration_ms; }
+
+private:
+    struct rolling_window {
+        uint32_t duration_ms;
+        frametime_histogram hist;
+        size_t frames;
+        double ms;
+    };
+
+    frametime_histogram all;
+    std::vector<rolling_window> windows;
+    std::deque<float> recent;  // oldest first
+};
+
+#endif //MANGOHUD_FRAMETIME_HISTOGRAM_H
@@ -0,0 +1,91 @@
+#pragma once
+#ifndef MANGOHUD_FRAMETIME_HISTORY_H
+#define MANGOHUD_FRAMETIME_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * The last N frametimes for plotting, with their min and max kept up to
+ * date as frames come in.
+ *
+ * Values live in a fixed circular buffer. Min and max come from monotonic
+ * queues of the frames that can still become the min or max of the window:
+ * a new frame drops everything behind it that it beats, and frames falling
+ * out of the window leave from the front. Every frame enters and leaves each
+ * queue once, so push() is amortised O(1) and nothing is ever allocated.
+ *
+ * Before N frames came in, the missing older ones read as 0 but don't count
+ * towards min and max.
+ */
+template <size_t N>
+class frametime_history {
+    static_assert(N > 0, "need room for a frame");
+
+    struct entry {
+        uint64_t seq;
+        float value;
+    };
+
+    // Frames in the window that can still be its min (or max), oldest first
+    class monotonic_queue {
+    public:
+        template <typename Beats>
+        void push(uint64_t seq, float value, Beats beats) {
+            while (tail != head && !beats(entries[(tail - 1) % N].value, value))
+                tail--;
+            entries[tail++ % N] = { seq, value };
+        }
+
+        void expire(uint64_t oldest_seq) {
+            while (head != tail && entries[head % N].seq < oldest_seq)
+                head++;
+        }
+
+        float front() const { return head != tail ? entries[head % N].value : 0.f; }
+
+    private:
+        entry entries[N] = {};
+        uint64_t head = 0, tail = 0;
+    };
+
+public:
+    void push(float frametime) {
+        uint64_t seq = pushed++;
+
+        if (seq >= N) {
+            mins.expire(seq - N + 1);
+            maxs.expire(seq - N + 1);
+        }
+
+        values[seq % N] = frametime;
+        mins.push(seq, frametime, [](float kept, float v) { return kept < v; });
+        maxs.push(seq, frametime, [](float kept, float v) { return kept > v; });
+    }
+
+    float min() const { return mins.front(); }
+    float max() const { return maxs.front(); }
+    float latest() const { return pushed ? values[(pushed - 1) % N] : 0.f; }
+
+    // idx-th frame of the window, 0 being the oldest
+    float operator[](size_t idx) const { return values[(pushed + idx) % N]; }
+
+    static constexpr size_t size() { return N; }
+
+    // The buffer as is, starting at offset() it runs from oldest to newest.
+    // For plots that take circular buffers.
+    const float* data() const { return values; }
+    size_t offset() const { return pushed % N; }
+
+    // For ImGui::PlotLines() and friends, data is the frametime_history
+    static float get(void* data, int idx) {
+        return (*static_cast<const frametime_history*>(data))[idx];
+    }
+
+private:
+    float values[N] = {};
+    uint64_t pushed = 0;
+    monotonic_queue mins, maxs;
+};
+
+#endif //MANGOHUD_FRAMETIME_HISTORY_H
@@ -51,8 +51,15 @@ struct GLVec
     }
 };
 
+// Frames of timestamps in flight for mangohud_overhead
+static constexpr unsigned timer_frames = 4;
+
 struct state {
     ImGuiContext *imgui_ctx = nullptr;
+    // Before and after the draw of each frame, none without GL 3.3
+    GLuint timer_queries[2 * timer_frames] {};
+    bool timer_pending[timer_frames] {};
+    unsigned timer_next = 0;
 };
 
 static GLVec last_vp {}, last_sb {};
@@ -181,6 +188,10 @@ void imgui_create(void *ctx, const gl_wsi plat)
 
     ImGui_ImplOpenGL3_Init();
 
+    // Timestamps and not GL_TIME_ELAPSED, the app may have such a query active
+    if (!sw_stats.version_gl.is_gles && GLAD_GL_VERSION_3_3)
+        glGenQueries(2 * timer_frames, state.timer_queries);
+
     create_fonts(nullptr, params, sw_stats.font1, sw_stats.font_text);
     sw_stats.font_params_hash = params.font_params_hash;
 
@@ -194,7 +205,9 @@ void imgui_shutdown()
         ImGui::SetCurrentContext(state.imgui_ctx);
         ImGui_ImplOpenGL3_Shutdown();
         ImGui::DestroyContext(state.imgui_ctx);
-        state.imgui_ctx = nullptr;
+        if (state.timer_queries[0])
+            glDeleteQueries(2 * timer_frames, state.timer_queries);
+        state = {};
     }
     inited = false;
 }
@@ -206,11 +219,32 @@ void imgui_set_context(void *ctx, const gl_wsi plat)
     imgui_create(ctx, plat);
 }
 
+// Hands the GPU time of the draws that finished to overhead_stats, never waits
+static void poll_timer_queries()
+{
+    for (unsigned i = 0; i < timer_frames; i++) {
+        if (!state.timer_pending[i])
+            continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(state.timer_queries[2 * i + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(state.timer_queries[2 * i], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(state.timer_queries[2 * i + 1], GL_QUERY_RESULT, &end);
+        overhead_stats.gpu(end - begin);
+        state.timer_pending[i] = false;
+    }
+}
+
 void imgui_render(unsigned int width, unsigned int height)
 {
     if (!state.imgui_ctx)
         return;
 
+    overlay_cost_scope update(overhead_stats, COST_UPDATE);
     static int control_client = -1;
     if (params.control >= 0) {
         control_client_check(params.control, control_client, deviceName);
@@ -219,7 +253,9 @@ void imgui_render(unsigned int width, unsigned int height)
 
     check_keybinds(params);
     update_hud_info(sw_stats, params, vendorID);
+    update.end();
 
+    overlay_cost_scope build(overhead_stats, COST_BUILD);
     ImGuiContext *saved_ctx = ImGui::GetCurrentContext();
     ImGui::SetCurrentContext(state.imgui_ctx);
     ImGui::GetIO().DisplaySize = ImVec2(width, height);
@@ -244,8 +280,30 @@ void imgui_render(unsigned int width, unsigned int height)
     }
 
     ImGui::Render();
+    build.end();
+
+    overlay_cost_scope draw(overhead_stats, COST_DRAW);
+    // A slot the GPU still hasn't got to frames later is left be
+    unsigned slot = state.timer_next;
+    bool timed = params.enabled[OVERLAY_PARAM_ENABLED_mangohud_overhead] && state.timer_queries[0];
+    if (timed) {
+        poll_timer_queries();
+        timed = !state.timer_pending[slot];
+    }
+    if (timed)
+        glQueryCounter(state.timer_queries[2 * slot], GL_TIMESTAMP);
+
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+    if (timed) {
+        glQueryCounter(state.timer_queries[2 * slot + 1], GL_TIMESTAMP);
+        state.timer_pending[slot] = true;
+        state.timer_next = (slot + 1) % timer_frames;
+    }
+    draw.end();
+
     ImGui::SetCurrentContext(saved_ctx);
+    overhead_stats.end_frame();
 }
 
 }} // namespaces
@@ -6,6 +6,8 @@
 #include <algorithm>
 #include <atomic>
 #include <cstring>
+#include <mutex>
+#include <unordered_map>
 #include <spdlog/spdlog.h>
 #include "real_dlsym.h"
 #include "loaders/loader_glx.h"
@@ -20,6 +22,7 @@
 #include <glad/glad.h>
 #include "gl_hud.h"
 #include "../config.h"
+#include "../experiment.h"
 
 using namespace MangoHud::GL;
 
@@ -104,6 +107,61 @@ EXPORT_C_(void) glXDestroyContext(void *dpy, void *ctx)
     SPDLOG_DEBUG("{}: {}", __func__,  ctx);
 }
 
+static void set_swap_interval(void* dpy, void* drawable, int interval) {
+    // Afaik -1 only works with EXT version if it has GLX_EXT_swap_control_tear, maybe EGL_MESA_swap_control_tear someday
+    if (interval >= -1) {
+        if (glx.SwapIntervalEXT)
+            glx.SwapIntervalEXT(dpy, drawable, interval);
+    }
+    if (interval >= 0) {
+        if (glx.SwapIntervalSGI)
+            glx.SwapIntervalSGI(interval);
+        if (glx.SwapIntervalMESA)
+            glx.SwapIntervalMESA(interval);
+    }
+}
+
+#ifndef GLX_SWAP_INTERVAL_EXT
+#define GLX_SWAP_INTERVAL_EXT 0x20F1
+#endif
+
+// Drawables whose swap interval an experiment changed
+struct experiment_swap_interval {
+    int original;   // put back once no experiment varies gl_vsync
+    int applied;
+};
+static std::mutex experiment_vsync_mtx;
+static std::unordered_map<void*, experiment_swap_interval> experiment_vsync;
+
+// The swap interval of the A/B experiment variant, once it switched, and
+// the drawable's own again when the experiment is gone
+static void apply_experiment_gl_vsync(void* dpy, void* drawable) {
+    ab_experiment* exp = experiment.load(std::memory_order_acquire);
+    int interval = exp ? exp->current().gl_vsync : experiment_variant::keep;
+
+    std::lock_guard<std::mutex> lock(experiment_vsync_mtx);
+    auto it = experiment_vsync.find(drawable);
+    if (interval == experiment_variant::keep) {
+        if (it != experiment_vsync.end()) {
+            set_swap_interval(dpy, drawable, it->second.original);
+            experiment_vsync.erase(it);
+        }
+        return;
+    }
+
+    if (it == experiment_vsync.end()) {
+        // What the app or gl_vsync set, the GLX default without the extension
+        unsigned int original = params.gl_vsync >= 0 ? params.gl_vsync : 1;
+        if (params.gl_vsync < 0 && glx.QueryDrawable)
+            glx.QueryDrawable(dpy, drawable, GLX_SWAP_INTERVAL_EXT, &original);
+        it = experiment_vsync.emplace(drawable, experiment_swap_interval {int(original), experiment_variant::keep}).first;
+    }
+    if (it->second.applied == interval)
+        return;
+    set_swap_interval(dpy, drawable, interval);
+    it->second.applied = interval;
+}
+
 EXPORT_C_(int) glXMakeCurrent(void* dpy, void* drawable, void* ctx) {
     glx.Load();
     SPDLOG_DEBUG("{}: {}, {}", __func__, drawable, ctx);
@@ -115,26 +173,12 @@ EXPORT_C_(int) glXMakeCurrent(void* dpy, void* drawable, void* ctx) {
             SPDLOG_DEBUG("GL ref count: {}", refcnt.load());
         }
 
-        // Afaik -1 only works with EXT version if it has GLX_EXT_swap_control_tear, maybe EGL_MESA_swap_control_tear someday
-        if (params.gl_vsync >= -1) {
-            if (glx.SwapIntervalEXT)
-                glx.SwapIntervalEXT(dpy, drawable, params.gl_vsync);
-        }
-        if (params.gl_vsync >= 0) {
-            if (glx.SwapIntervalSGI)
-                glx.SwapIntervalSGI(params.gl_vsync);
-            if (glx.SwapIntervalMESA)
-                glx.SwapIntervalMESA(params.gl_vsync);
-        }
+        set_swap_interval(dpy, drawable, params.gl_vsync);
     }
 
     return ret;
 }
 
-#ifndef GLX_SWAP_INTERVAL_EXT
-#define GLX_SWAP_INTERVAL_EXT 0x20F1
-#endif
-
 static void do_imgui_swap(void *dpy, void *drawable)
 {
     static auto last_time = std::chrono::steady_clock::now();
@@ -182,6 +226,8 @@ EXPORT_C_(void) glXSwapBuffers(void* dpy, void* drawable) {
     glx.Load();
 
     do_imgui_swap(dpy, drawable);
+    if (!is_blacklisted())
+        apply_experiment_gl_vsync(dpy, drawable);
     using namespace std::chrono_literals;
     if (!is_blacklisted() && fps_limit_stats.targetFrameTime > 0s && fps_limit_stats.method == FPS_LIMIT_METHOD_EARLY){
         fps_limit_stats.frameStart = Clock::now();
@@ -203,6 +249,8 @@ EXPORT_C_(int64_t) glXSwapBuffersMscOML(void* dpy, void* drawable, int64_t targe
         return -1;
 
     do_imgui_swap(dpy, drawable);
+    if (!is_blacklisted())
+        apply_experiment_gl_vsync(dpy, drawable);
     using namespace std::chrono_literals;
     if (!is_blacklisted() && fps_limit_stats.targetFrameTime > 0s && fps_limit_stats.method == FPS_LIMIT_METHOD_EARLY){
         fps_limit_stats.frameStart = Clock::now();
@@ -0,0 +1,144 @@
+#pragma once
+#ifndef MANGOHUD_GPU_TIMING_H
+#define MANGOHUD_GPU_TIMING_H
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "frametime_history.h"
+
+/*
+ * GPU time of each frame, from timestamps the layer writes around the
+ * submissions of the frame on every queue.
+ *
+ * Submissions belong to the frame being recorded when they are made, frames
+ * end with their present. Results come back frames later and in any order
+ * across queues. Timestamps of different queues needn't share a timebase, so
+ * each queue's submissions are merged on their own, overlapping ones counted
+ * once, and the frame's GPU time is that of its busiest queue. The gaps
+ * between submissions, where the GPU waited for the CPU, don't count.
+ *
+ * A frame is done once it was presented and all its submissions came back.
+ * Frames with a lost submission or none timed at all aren't reported, and
+ * only the last max_pending frames are waited for.
+ *
+ * Everything locks, submissions come from any thread.
+ */
+class gpu_frame_timing {
+public:
+    static constexpr size_t max_pending = 16;
+
+    // Before a timed submission, returns the frame it belongs to
+    uint64_t submitting() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (pending.empty() || pending.back().number != current) {
+            pending.emplace_back();
+            pending.back().number = current;
+            if (pending.size() > max_pending)
+                pending.pop_front();
+        }
+        pending.back().outstanding++;
+        return current;
+    }
+
+    // A submission's timestamps, queue tells which timebase they're from
+    void completed(uint64_t frame, uintptr_t queue, uint64_t begin_ns, uint64_t end_ns) {
+        std::lock_guard<std::mutex> lock(mtx);
+        pending_frame* f = find(frame);
+        if (!f)
+            return;
+        f->submissions.push_back({ queue, { begin_ns, std::max(begin_ns, end_ns) } });
+        f->outstanding--;
+        finish();
+    }
+
+    // A submission that failed or whose timestamps were dropped
+    void lost(uint64_t frame) {
+        std::lock_guard<std::mutex> lock(mtx);
+        pending_frame* f = find(frame);
+        if (!f)
+            return;
+        f->lost = true;
+        f->outstanding--;
+        finish();
+    }
+
+    // At present, later submissions go to the next frame
+    void presented() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!pending.empty() && pending.back().number == current)
+            pending.back().presented = true;
+        current++;
+        finish();
+    }
+
+    // ms of the last frame done, 0 before the first
+    float last_ms() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return history.latest();
+    }
+
+    frametime_history<200> last_frames() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return history;
+    }
+
+private:
+    typedef std::pair<uint64_t, uint64_t> interval;
+
+    struct pending_frame {
+        uint64_t number = 0;
+        unsigned outstanding = 0;
+        bool presented = false;
+        bool lost = false;
+        std::vector<std::pair<uintptr_t, interval>> submissions;
+    };
+
+    pending_frame* find(uint64_t frame) {
+        for (auto& f : pending) {
+            if (f.number == frame)
+                return f.outstanding ? &f : nullptr;
+        }
+        return nullptr;
+    }
+
+    void finish() {
+        while (!pending.empty() && pending.front().presented && !pending.front().outstanding) {
+            pending_frame& f = pending.front();
+            if (!f.lost && !f.submissions.empty())
+                history.push(busiest_queue_ns(f.submissions) / 1e6f);
+            pending.pop_front();
+        }
+    }
+
+    // Sorted by queue then begin, each queue's overlapping intervals merge
+    static uint64_t busiest_queue_ns(std::vector<std::pair<uintptr_t, interval>>& submissions) {
+        std::sort(submissions.begin(), submissions.end());
+        uint64_t busiest = 0, busy = 0, end = 0;
+        for (size_t i = 0; i < submissions.size(); i++) {
+            const interval& s = submissions[i].second;
+            if (i == 0 || submissions[i].first != submissions[i - 1].first) {
+                busy = 0;
+                end = s.first;
+            }
+            if (s.second > end) {
+                busy += s.second - std::max(s.first, end);
+                end = s.second;
+            }
+            busiest = std::max(busiest, busy);
+        }
+        return busiest;
+    }
+
+    mutable std::mutex mtx;
+    uint64_t current = 0;
+    std::deque<pending_frame> pending;  // oldest first
+    frametime_history<200> history;
+};
+
+extern gpu_frame_timing gpu_timing;
+
+#endif //MANGOHUD_GPU_TIMING_H
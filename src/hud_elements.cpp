@@ -274,14 +274,14 @@ void HudElements::gpu_stats() {
     if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_gpu_stats])
         return;
 
-    mangohud_message& metrics = HUDElements.current_metrics;
+    const mangohud_message& metrics = *HUDElements.current_metrics;
     uint8_t idx = 0;
     std::set<uint8_t> gpus = selected_gpus(metrics);
 
     for (uint8_t i : gpus) {
-        gpu_t& gpu = metrics.gpus[i];
-        gpu_metrics_system_t&  system  = gpu.system_metrics;
-        gpu_metrics_process_t& process = gpu.process_metrics;
+        const gpu_t& gpu = metrics.gpus[i];
+        const gpu_metrics_system_t&  system  = gpu.system_metrics;
+        const gpu_metrics_process_t& process = gpu.process_metrics;
 
         // some gpus do not supply total system load, only process load
         int gpu_load = system.load > -1 ? system.load : process.load;
@@ -462,7 +462,7 @@ void HudElements::cpu_stats(){
         else
             cpu_text = HUDElements.params->cpu_text.c_str();
 
-        mangohud_message& m = HUDElements.current_metrics;
+        const mangohud_message& m = *HUDElements.current_metrics;
         cpu_info_t cpu = m.cpu;
 
         HUDElements.TextColored(HUDElements.colors.cpu, "%s", cpu_text);
@@ -535,7 +535,7 @@ void HudElements::cpu_stats(){
 
 static float get_core_load_stat(void*,int);
 static float get_core_load_stat(void *data, int idx){
-    return HUDElements.current_metrics.cores[idx].load;
+    return HUDElements.current_metrics->cores[idx].load;
 }
 
 void HudElements::core_load(){
@@ -566,7 +566,7 @@ void HudElements::core_load(){
 
         if (ImGui::BeginChild("core_bars_window", ImVec2(width, height))) {
             ImGui::PlotHistogram(hash, get_core_load_stat, nullptr,
-                                HUDElements.current_metrics.num_of_cores, 0,
+                                HUDElements.current_metrics->num_of_cores, 0,
                                 NULL, 0.0, 100.0,
                                 ImVec2(width, height));
         }
@@ -575,9 +575,9 @@ void HudElements::core_load(){
         ImGui::PopStyleColor();
     } else {
 
-        mangohud_message& m = HUDElements.current_metrics;
+        const mangohud_message& m = *HUDElements.current_metrics;
 
-        for (uint16_t i = 0; i < HUDElements.current_metrics.num_of_cores; i++) {
+        for (uint16_t i = 0; i < HUDElements.current_metrics->num_of_cores; i++) {
             core_info_t& core = m.cores[i];
 
             ImguiNextColumnFirstItem();
@@ -632,7 +632,7 @@ void HudElements::io_stats(){
 
     ImguiNextColumnFirstItem();
 
-    mangohud_message& m = HUDElements.current_metrics;
+    const mangohud_message& m = *HUDElements.current_metrics;
     std::string text;
 
     if (
@@ -697,13 +697,13 @@ void HudElements::vram() {
     )
         return;
 
-    mangohud_message& metrics = HUDElements.current_metrics;
+    const mangohud_message& metrics = *HUDElements.current_metrics;
     uint8_t idx = 0;
     std::set<uint8_t> gpus = selected_gpus(metrics);
 
     for (uint8_t i : gpus) {
-        gpu_t& gpu = metrics.gpus[i];
-        gpu_metrics_system_t& system = gpu.system_metrics;
+        const gpu_t& gpu = metrics.gpus[i];
+        const gpu_metrics_system_t& system = gpu.system_metrics;
 
         ImguiNextColumnFirstItem();
 
@@ -772,14 +772,14 @@ void HudElements::proc_vram() {
     )
         return;
 
-    mangohud_message& metrics = HUDElements.current_metrics;
+    const mangohud_message& metrics = *HUDElements.current_metrics;
     uint8_t gpu_idx = 0;
 
     if (!get_active_gpu(metrics, gpu_idx))
         return;
 
-    gpu_metrics_system_t&  system  = metrics.gpus[gpu_idx].system_metrics;
-    gpu_metrics_process_t& process = metrics.gpus[gpu_idx].process_metrics;
+    const gpu_metrics_system_t&  system  = metrics.gpus[gpu_idx].system_metrics;
+    const gpu_metrics_process_t& process = metrics.gpus[gpu_idx].process_metrics;
 
     ImguiNextColumnFirstItem();
     HUDElements.TextColored(HUDElements.colors.vram, "PVRAM");
@@ -828,7 +828,7 @@ void HudElements::ram() {
     if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_ram])
         return;
 
-    memory_t& mem = HUDElements.current_metrics.memory;
+    const memory_t& mem = HUDElements.current_metrics->memory;
 
     ImguiNextColumnFirstItem();
     HUDElements.TextColored(HUDElements.colors.ram, "RAM");
@@ -860,7 +860,7 @@ void HudElements::procmem()
         return;
 
     const char* unit = nullptr;
-    memory_t& mem = HUDElements.current_metrics.memory;
+    const memory_t& mem = HUDElements.current_metrics->memory;
 
     ImguiNextColumnFirstItem();
 
@@ -1056,7 +1056,7 @@ void HudElements::frame_timing() {
     if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_frame_timing])
         return;
 
-    mangohud_message& msg = HUDElements.current_metrics;
+    const mangohud_message& msg = *HUDElements.current_metrics;
     uint8_t gpu_idx = 0;
     bool have_active_gpu = get_active_gpu(msg, gpu_idx);
 
@@ -1076,7 +1076,8 @@ void HudElements::frame_timing() {
 
         right_aligned_text(
             HUDElements.colors.text, ImGui::GetContentRegionAvail().x,
-            "min: %.1fms, max: %.1fms", min_frametime, max_frametime
+            "min: %.1fms, max: %.1fms", HUDElements.sw_stats->frametimes.min(),
+            HUDElements.sw_stats->frametimes.max()
         );
 
         ImGui::Dummy(ImVec2(0.0f, real_font_size.y / 2));
@@ -1086,8 +1087,7 @@ void HudElements::frame_timing() {
     char hash[40];
     snprintf(hash, sizeof(hash), "##%s", overlay_param_names[OVERLAY_PARAM_ENABLED_frame_timing]);
 
-    HUDElements.sw_stats->stat_selector = OVERLAY_PLOTS_frame_timing;
-    HUDElements.sw_stats->time_dividor = 1000000.0f; /* ns -> ms */
+    const auto& frametimes = HUDElements.sw_stats->frametimes;
 
     ImGui::PushStyleColor(ImGuiCol_FrameBg, ImVec4(0.0f, 0.0f, 0.0f, 0.0f));
 
@@ -1104,8 +1104,8 @@ void HudElements::frame_timing() {
     }
 
     if (HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_dynamic_frame_timing]){
-        min_time = min_frametime;
-        max_time = max_frametime;
+        min_time = frametimes.min();
+        max_time = frametimes.max();
     }
     if (HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_frame_timing_detailed]){
         height = 125;
@@ -1115,7 +1115,7 @@ void HudElements::frame_timing() {
         if (HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_histogram]) {
             ImGui::PlotHistogram(
                 hash, get_time_stat, HUDElements.sw_stats,
-                ARRAY_SIZE(HUDElements.sw_stats->frames_stats), 0,
+                frametimes.size(), 0,
                 NULL, min_time, max_time,
                 ImVec2(width, height)
             );
@@ -1123,7 +1123,7 @@ void HudElements::frame_timing() {
 #ifndef __linux__
             ImGui::PlotLines(
                 hash, get_time_stat, HUDElements.sw_stats,
-                ARRAY_SIZE(HUDElements.sw_stats->frames_stats), 0,
+                frametimes.size(), 0,
                 NULL, min_time, max_time,
                 ImVec2(width, height)
             );
@@ -1131,7 +1131,7 @@ void HudElements::frame_timing() {
 
             if (HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_horizontal]) {
                 ImGui::PlotLines(hash, get_time_stat, HUDElements.sw_stats,
-                ARRAY_SIZE(HUDElements.sw_stats->frames_stats), 0,
+                frametimes.size(), 0,
                 NULL, min_time, max_time,
                 ImVec2(width, height));
             } else {
@@ -1150,9 +1150,26 @@ void HudElements::frame_timing() {
 
                     ImPlot::SetupAxes(nullptr, nullptr, ax_flags_x, ax_flags_y);
                     ImPlot::SetupAxisScale(ImAxis_Y1, TransformForward_Custom, TransformInverse_Custom);
-                    ImPlot::SetupAxesLimits(0, 200, min_time, max_time);
+                    ImPlot::SetupAxesLimits(0, frametimes.size(), min_time, max_time);
                     ImPlot::SetNextLineStyle(HUDElements.colors.frametime, 1.5);
-                    ImPlot::PlotLine("frametime line", frametime_data.data(), frametime_data.size());
+                    ImPlot::PlotLine("frametime line", frametimes.data(), frametimes.size(), 1, 0, 0, frametimes.offset());
+
+                    // Frames that created pipelines, on their frametime
+                    if (HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_pipeline_compiles]) {
+                        const auto& compile_ms = HUDElements.sw_stats->compile_ms;
+                        float xs[decltype(swapchain_stats::compile_ms)::size()];
+                        float ys[decltype(swapchain_stats::compile_ms)::size()];
+                        int n = 0;
+                        for (size_t i = 0; i < compile_ms.size(); i++) {
+                            if (compile_ms[i] <= 0)
+                                continue;
+                            xs[n] = i;
+                            ys[n] = frametimes[i];
+                            n++;
+                        }
+                        ImPlot::SetNextMarkerStyle(ImPlotMarker_Circle, 2.5f, ImVec4(1.0f, 0.5f, 0.0f, 1.0f), 0.0f);
+                        ImPlot::PlotScatter("compile markers", xs, ys, n);
+                    }
 
                     // if (
                     //     HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_throttling_status_graph] &&
@@ -1198,14 +1215,83 @@ void HudElements::frame_timing() {
     ImGui::PopStyleColor();
 }
 
+void HudElements::frametime_distribution() {
+    if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_frametime_distribution])
+        return;
+
+    auto& distribution = HUDElements.sw_stats->distribution;
+    const float lowest_ms = ::frametime_distribution::bin_lower_ms(0);
+    const float highest_ms = ::frametime_distribution::bin_lower_ms(::frametime_distribution::num_bins);
+
+    ImguiNextColumnFirstItem();
+    ImGui::PushFont(HUDElements.sw_stats->font1);
+
+    if (
+        !HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_horizontal] &&
+        !HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_hud_compact]
+    ) {
+        ImGui::Dummy(ImVec2(0.0f, real_font_size.y));
+
+        HUDElements.TextColored(HUDElements.colors.engine, "%s", "Distribution");
+
+        ImGui::TableSetColumnIndex(ImGui::TableGetColumnCount() - 1);
+        ImGui::Dummy(ImVec2(0.0f, real_font_size.y));
+
+        if (distribution.window_ms())
+            right_aligned_text(
+                HUDElements.colors.text, ImGui::GetContentRegionAvail().x,
+                "%.0f-%.0fms, last %us", lowest_ms, highest_ms, distribution.window_ms() / 1000
+            );
+        else
+            right_aligned_text(
+                HUDElements.colors.text, ImGui::GetContentRegionAvail().x,
+                "%.0f-%.0fms, session", lowest_ms, highest_ms
+            );
+
+        ImGui::Dummy(ImVec2(0.0f, real_font_size.y / 2));
+        ImguiNextColumnFirstItem();
+    }
+
+    char hash[40];
+    snprintf(hash, sizeof(hash), "##%s", overlay_param_names[OVERLAY_PARAM_ENABLED_frametime_distribution]);
+
+    ImGui::PushStyleColor(ImGuiCol_FrameBg, ImVec4(0.0f, 0.0f, 0.0f, 0.0f));
+
+    float width, height;
+    if (HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_horizontal]) {
+        width = 150;
+        height = HUDElements.params->font_size * 0.85;
+    } else {
+        width = (ImGui::GetWindowContentRegionMax().x - ImGui::GetWindowContentRegionMin().x);
+        height = real_font_size.y * 2.5f;
+    }
+
+    // Bars are shares of the frames, scaled to the fullest bin
+    float fullest = 0.f;
+    for (int i = 0; i < ::frametime_distribution::num_bins; i++)
+        fullest = std::max(fullest, ::frametime_distribution::get(&distribution, i));
+
+    if (ImGui::BeginChild("frametime_distribution", ImVec2(width, height), false, ImGuiWindowFlags_NoDecoration)) {
+        ImGui::PlotHistogram(
+            hash, ::frametime_distribution::get, &distribution,
+            ::frametime_distribution::num_bins, 0,
+            NULL, 0.0f, fullest,
+            ImVec2(width, height)
+        );
+    }
+    ImGui::EndChild();
+
+    ImGui::PopFont();
+    ImGui::PopStyleColor();
+}
+
 void HudElements::media_player(){
 #ifdef HAVE_DBUS
     if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_media_player])
         return;
 
     ImguiNextColumnFirstItem();
-    uint32_t f_idx = (HUDElements.sw_stats->n_frames - 1) % ARRAY_SIZE(HUDElements.sw_stats->frames_stats);
-    uint64_t frame_timing = HUDElements.sw_stats->frames_stats[f_idx].stats[OVERLAY_PLOTS_frame_timing];
+    uint64_t frame_timing = HUDElements.sw_stats->frametimes.latest() * 1000000; /* ms -> ns */
     ImFont scaled_font = *HUDElements.sw_stats->font_text;
     scaled_font.Scale = HUDElements.params->font_scale_media_player;
     ImGui::PushFont(&scaled_font);
@@ -1456,9 +1542,6 @@ void HudElements::gamescope_frame_timing(){
             ImGui::PopFont();
             char hash[40];
             snprintf(hash, sizeof(hash), "##%s", overlay_param_names[OVERLAY_PARAM_ENABLED_frame_timing]);
-            HUDElements.sw_stats->stat_selector = OVERLAY_PLOTS_frame_timing;
-            HUDElements.sw_stats->time_dividor = 1000000.0f; /* ns -> ms */
-
             ImGui::PushStyleColor(ImGuiCol_FrameBg, ImVec4(0.0f, 0.0f, 0.0f, 0.0f));
             if (ImGui::BeginChild("gamescope_app_window", ImVec2((ImGui::GetWindowContentRegionMax().x - ImGui::GetWindowContentRegionMin().x), 50))) {
                 ImGui::PlotLines("", HUDElements.gamescope_debug_app.data(),
@@ -1565,6 +1648,243 @@ void HudElements::frame_count(){
     }
 }
 
+void HudElements::sample_age(){
+    if (HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_sample_age]){
+        uint64_t sample_time = HUDElements.current_metrics.sample_time_ns;
+        ImguiNextColumnFirstItem();
+        ImGui::PushFont(HUDElements.sw_stats->font1);
+        HUDElements.TextColored(HUDElements.colors.engine, "Sample age");
+        ImguiNextColumnOrNewRow();
+        if (sample_time)
+            right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.1f",
+                               (metrics_clock_ns() - sample_time) / 1000000.0);
+        else
+            right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "N/A");
+        ImGui::SameLine(0, 1.0f);
+        HUDElements.TextColored(HUDElements.colors.text, "ms");
+        ImGui::PopFont();
+    }
+}
+
+void HudElements::frame_pacing(){
+    if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_frame_pacing])
+        return;
+
+    frame_pacing_summary pacing = pacing_stats.last_window();
+    ImGui::PushFont(HUDElements.sw_stats->font1);
+
+    ImguiNextColumnFirstItem();
+    HUDElements.TextColored(HUDElements.colors.engine, "Jitter");
+    ImguiNextColumnOrNewRow();
+    right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.1f", pacing.jitter_p99);
+    ImGui::SameLine(0, 1.0f);
+    HUDElements.TextColored(HUDElements.colors.text, "ms");
+    ImguiNextColumnOrNewRow();
+
+    ImguiNextColumnFirstItem();
+    HUDElements.TextColored(HUDElements.colors.engine, "Off pace");
+    ImguiNextColumnOrNewRow();
+    right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.1f", pacing.off_pace);
+    ImGui::SameLine(0, 1.0f);
+    HUDElements.TextColored(HUDElements.colors.text, "%%");
+    ImguiNextColumnOrNewRow();
+
+    if (pacing.vblanks_known) {
+        ImguiNextColumnFirstItem();
+        HUDElements.TextColored(HUDElements.colors.engine, "Missed vblanks");
+        ImguiNextColumnOrNewRow();
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%" PRIu64, pacing.missed_vblanks);
+        ImguiNextColumnOrNewRow();
+    }
+
+    ImguiNextColumnFirstItem();
+    HUDElements.TextColored(HUDElements.colors.engine, "Stutter");
+    ImguiNextColumnOrNewRow();
+    right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.1f", pacing.stutter_index);
+    ImGui::SameLine(0, 1.0f);
+    HUDElements.TextColored(HUDElements.colors.text, "%%");
+
+    ImGui::PopFont();
+}
+
+void HudElements::gpu_frametime(){
+    if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_gpu_frametime])
+        return;
+
+    // Results come back a few frames late, and not at all on queues without timestamps
+    frametime_history<200> frametimes = gpu_timing.last_frames();
+    ImguiNextColumnFirstItem();
+    HUDElements.TextColored(HUDElements.colors.engine, "GPU frame");
+    ImguiNextColumnOrNewRow();
+    if (frametimes.latest() > 0)
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.1f", frametimes.latest());
+    else
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "N/A");
+    ImGui::SameLine(0, 1.0f);
+    ImGui::PushFont(HUDElements.sw_stats->font1);
+    HUDElements.TextColored(HUDElements.colors.text, "ms");
+    ImGui::PopFont();
+
+    if (HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_horizontal])
+        return;
+
+    ImguiNextColumnFirstItem();
+    char hash[40];
+    snprintf(hash, sizeof(hash), "##%s", overlay_param_names[OVERLAY_PARAM_ENABLED_gpu_frametime]);
+    float width = ImGui::GetWindowContentRegionMax().x - ImGui::GetWindowContentRegionMin().x;
+    ImGui::PushStyleColor(ImGuiCol_FrameBg, ImVec4(0.0f, 0.0f, 0.0f, 0.0f));
+    ImGui::PlotLines(hash, frametime_history<200>::get, &frametimes, frametimes.size(), 0,
+                     NULL, 0.0f, std::max(frametimes.max(), 1.0f), ImVec2(width, 50));
+    ImGui::PopStyleColor();
+}
+
+void HudElements::present_blocking(){
+    if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_present_blocking])
+        return;
+
+    static const char* const names[BLOCK_COUNT] = { "Present block", "Acquire block", "Fence wait", "Limiter" };
+    frame_blocking avg = blocking_stats.last_period();
+    ImGui::PushFont(HUDElements.sw_stats->font1);
+
+    for (size_t i = 0; i < BLOCK_COUNT; i++) {
+        // Only with an fps limit
+        if (i == BLOCK_LIMITER && avg.ms[i] <= 0)
+            continue;
+        ImguiNextColumnFirstItem();
+        HUDElements.TextColored(HUDElements.colors.engine, "%s", names[i]);
+        ImguiNextColumnOrNewRow();
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.1f", avg.ms[i]);
+        ImGui::SameLine(0, 1.0f);
+        HUDElements.TextColored(HUDElements.colors.text, "ms");
+        ImguiNextColumnOrNewRow();
+    }
+
+    ImguiNextColumnFirstItem();
+    HUDElements.TextColored(HUDElements.colors.engine, "Blocked");
+    ImguiNextColumnOrNewRow();
+    right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.0f", avg.blocked_percent());
+    ImGui::SameLine(0, 1.0f);
+    HUDElements.TextColored(HUDElements.colors.text, "%%");
+
+    if (blocking_stats.images()) {
+        ImguiNextColumnOrNewRow();
+        ImguiNextColumnFirstItem();
+        HUDElements.TextColored(HUDElements.colors.engine, "Swapchain");
+        ImguiNextColumnOrNewRow();
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%u", blocking_stats.images());
+        ImGui::SameLine(0, 1.0f);
+        HUDElements.TextColored(HUDElements.colors.text, "%s", HUDElements.get_present_mode().c_str());
+    }
+
+    ImGui::PopFont();
+}
+
+void HudElements::present_latency(){
+    if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_present_latency])
+        return;
+
+    // Without VK_KHR_present_wait nothing is ever waited on
+    bool available = latency_stats.available();
+    display_timing avg = latency_stats.last_period();
+    ImGui::PushFont(HUDElements.sw_stats->font1);
+
+    ImguiNextColumnFirstItem();
+    HUDElements.TextColored(HUDElements.colors.engine, "Display latency");
+    ImguiNextColumnOrNewRow();
+    if (available && avg.frames)
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.1f", avg.latency_ms);
+    else
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "N/A");
+    ImGui::SameLine(0, 1.0f);
+    HUDElements.TextColored(HUDElements.colors.text, "ms");
+    ImguiNextColumnOrNewRow();
+
+    ImguiNextColumnFirstItem();
+    HUDElements.TextColored(HUDElements.colors.engine, "Display interval");
+    ImguiNextColumnOrNewRow();
+    if (available && avg.interval_ms > 0)
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.1f", avg.interval_ms);
+    else
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "N/A");
+    ImGui::SameLine(0, 1.0f);
+    HUDElements.TextColored(HUDElements.colors.text, "ms");
+
+    ImGui::PopFont();
+}
+
+void HudElements::mangohud_overhead(){
+    if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_mangohud_overhead])
+        return;
+
+    static const char* const names[COST_COUNT] = { "HUD update", "HUD build", "HUD draw" };
+    overlay_cost avg = overhead_stats.last_period();
+    ImGui::PushFont(HUDElements.sw_stats->font1);
+
+    for (size_t i = 0; i < COST_COUNT; i++) {
+        ImguiNextColumnFirstItem();
+        HUDElements.TextColored(HUDElements.colors.engine, "%s", names[i]);
+        ImguiNextColumnOrNewRow();
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.2f", avg.cpu_ms[i]);
+        ImGui::SameLine(0, 1.0f);
+        HUDElements.TextColored(HUDElements.colors.text, "ms");
+        ImguiNextColumnOrNewRow();
+    }
+
+    ImguiNextColumnFirstItem();
+    HUDElements.TextColored(HUDElements.colors.engine, "HUD CPU");
+    ImguiNextColumnOrNewRow();
+    right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.2f", avg.cpu_total_ms());
+    ImGui::SameLine(0, 1.0f);
+    HUDElements.TextColored(HUDElements.colors.text, "ms");
+    ImguiNextColumnOrNewRow();
+
+    // Without timestamp queries
+    ImguiNextColumnFirstItem();
+    HUDElements.TextColored(HUDElements.colors.engine, "HUD GPU");
+    ImguiNextColumnOrNewRow();
+    if (overhead_stats.gpu_available())
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.2f", avg.gpu_ms);
+    else
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "N/A");
+    ImGui::SameLine(0, 1.0f);
+    HUDElements.TextColored(HUDElements.colors.text, "ms");
+
+    ImGui::PopFont();
+}
+
+void HudElements::pipeline_compiles(){
+    if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_pipeline_compiles])
+        return;
+
+    compile_frame period = compile_stats.last_period();
+    ImGui::PushFont(HUDElements.sw_stats->font1);
+
+    ImguiNextColumnFirstItem();
+    HUDElements.TextColored(HUDElements.colors.engine, "Compiling");
+    ImguiNextColumnOrNewRow();
+    right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%.1f", period.ms);
+    ImGui::SameLine(0, 1.0f);
+    HUDElements.TextColored(HUDElements.colors.text, "ms");
+    ImguiNextColumnOrNewRow();
+
+    ImguiNextColumnFirstItem();
+    HUDElements.TextColored(HUDElements.colors.engine, "Pipelines");
+    ImguiNextColumnOrNewRow();
+    right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%u", period.pipelines);
+    ImguiNextColumnOrNewRow();
+
+    // Without VK_EXT_pipeline_creation_feedback
+    ImguiNextColumnFirstItem();
+    HUDElements.TextColored(HUDElements.colors.engine, "Cache misses");
+    ImguiNextColumnOrNewRow();
+    if (compile_stats.feedback())
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "%u", period.cache_misses);
+    else
+        right_aligned_text(HUDElements.colors.text, HUDElements.ralign_width, "N/A");
+
+    ImGui::PopFont();
+}
+
 void HudElements::fan(){
     if (HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_fan] && fan_speed != -1) {
         ImguiNextColumnFirstItem();
@@ -1582,13 +1902,13 @@ void HudElements::throttling_status(){
     if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_throttling_status])
         return;
 
-    mangohud_message& msg = HUDElements.current_metrics;
+    const mangohud_message& msg = *HUDElements.current_metrics;
     uint8_t gpu_idx = 0;
 
     if (!get_active_gpu(msg, gpu_idx))
         return;
 
-    gpu_metrics_system_t& system = msg.gpus[gpu_idx].system_metrics;
+    const gpu_metrics_system_t& system = msg.gpus[gpu_idx].system_metrics;
 
     if (!(
         system.is_current_throttled || system.is_other_throttled ||
@@ -1639,13 +1959,14 @@ void HudElements::graphs() {
     ImGui::Dummy(ImVec2(0.0f, real_font_size.y));
 
     const std::string& value = HUDElements.ordered_functions[HUDElements.place].value;
+    const std::vector<logData>& graph_data = HUDElements.hw->graph_data;
     assert(kMaxGraphEntries >= graph_data.size());
 
     std::vector<float> arr(kMaxGraphEntries - graph_data.size());
 
     ImGui::PushFont(HUDElements.sw_stats->font1);
 
-    mangohud_message& msg = HUDElements.current_metrics;
+    const mangohud_message& msg = *HUDElements.current_metrics;
     uint8_t gpu_idx = 0;
     bool have_active_gpu = get_active_gpu(msg, gpu_idx);
 
@@ -2079,6 +2400,14 @@ void HudElements::sort_elements(const std::pair<std::string, std::string>& optio
         {"debug", {gamescope_frame_timing}},
         {"device_battery", {device_battery}},
         {"frame_count", {frame_count}},
+        {"sample_age", {sample_age}},
+        {"frame_pacing", {frame_pacing}},
+        {"gpu_frametime", {gpu_frametime}},
+        {"present_blocking", {present_blocking}},
+        {"present_latency", {present_latency}},
+        {"mangohud_overhead", {mangohud_overhead}},
+        {"pipeline_compiles", {pipeline_compiles}},
+        {"frametime_distribution", {frametime_distribution}},
         {"fan", {fan}},
         {"throttling_status", {throttling_status}},
         {"exec_name", {exec_name}},
@@ -2199,6 +2528,22 @@ void HudElements::legacy_elements(){
         ordered_functions.push_back({frame_timing, "frame_timing", value});
     if (params->enabled[OVERLAY_PARAM_ENABLED_frame_count])
         ordered_functions.push_back({frame_count, "frame_count", value});
+    if (params->enabled[OVERLAY_PARAM_ENABLED_sample_age])
+        ordered_functions.push_back({sample_age, "sample_age", value});
+    if (params->enabled[OVERLAY_PARAM_ENABLED_frame_pacing])
+        ordered_functions.push_back({frame_pacing, "frame_pacing", value});
+    if (params->enabled[OVERLAY_PARAM_ENABLED_gpu_frametime])
+        ordered_functions.push_back({gpu_frametime, "gpu_frametime", value});
+    if (params->enabled[OVERLAY_PARAM_ENABLED_present_blocking])
+        ordered_functions.push_back({present_blocking, "present_blocking", value});
+    if (params->enabled[OVERLAY_PARAM_ENABLED_present_latency])
+        ordered_functions.push_back({present_latency, "present_latency", value});
+    if (params->enabled[OVERLAY_PARAM_ENABLED_mangohud_overhead])
+        ordered_functions.push_back({mangohud_overhead, "mangohud_overhead", value});
+    if (params->enabled[OVERLAY_PARAM_ENABLED_pipeline_compiles])
+        ordered_functions.push_back({pipeline_compiles, "pipeline_compiles", value});
+    if (params->enabled[OVERLAY_PARAM_ENABLED_frametime_distribution])
+        ordered_functions.push_back({frametime_distribution, "frametime_distribution", value});
     if (params->enabled[OVERLAY_PARAM_ENABLED_debug] && !params->enabled[OVERLAY_PARAM_ENABLED_horizontal])
         ordered_functions.push_back({gamescope_frame_timing, "gamescope_frame_timing", value});
     if (params->enabled[OVERLAY_PARAM_ENABLED_gamemode])
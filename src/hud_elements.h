@@ -13,7 +13,8 @@
 #include "net.h"
 #include "overlay_params.h"
 #include "shell.h"
-#include "../../mangohud-server/common/gpu_metrics.hpp"
+#include "server_connection.hpp"
+#include "logging.h"
 
 struct Function {
     std::function<void()> run;  // Using std::function instead of a raw function pointer for more flexibility
@@ -93,6 +94,7 @@ class HudElements{
         static void arch();
         static void wine();
         static void frame_timing();
+        static void frametime_distribution();
         static void media_player();
         static void resolution();
         static void show_fps_limit();
@@ -108,6 +110,13 @@ class HudElements{
         static void gamescope_frame_timing();
         static void device_battery();
         static void frame_count();
+        static void sample_age();
+        static void frame_pacing();
+        static void gpu_frametime();
+        static void present_blocking();
+        static void present_latency();
+        static void mangohud_overhead();
+        static void pipeline_compiles();
         static void fan();
         static void throttling_status();
         static void exec_name();
@@ -182,8 +191,9 @@ class HudElements{
 
         }
 
-        std::mutex current_metrics_lock;
-        mangohud_message current_metrics;
+        // Moved on to the latest sample once per frame in render_imgui()
+        metrics_view current_metrics;
+        snapshot_buffer<hw_snapshot, 5>::view hw;
 };
 
 extern HudElements HUDElements;
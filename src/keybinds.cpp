@@ -8,6 +8,7 @@
 #include "logging.h"
 #include "keybinds.h"
 #include "fps_metrics.h"
+#include "benchmark_plan.h"
 
 Clock::time_point last_f2_press, toggle_fps_limit_press, toggle_preset_press, last_f12_press, reload_cfg_press, last_upload_press;
 
@@ -31,7 +32,13 @@ void check_keybinds(struct overlay_params& params){
    if (elapsedF2 >= keyPressDelay &&
        keys_are_pressed(params.toggle_logging)) {
       last_f2_press = now;
-      if (logger->is_active()) {
+      benchmark_plan* plan = bench_plan.load(std::memory_order_acquire);
+      if (plan && params.benchmark_trigger == BENCHMARK_TRIGGER_KEYBIND) {
+         if (plan->running())
+            plan->abort();
+         else
+            plan->start();
+      } else if (logger->is_active()) {
          logger->stop_logging();
       } else {
          logger->start_logging();
@@ -85,6 +85,46 @@ bool libx11_loader::Load(const std::string& library_name) {
     return false;
   }
 
+  XQueryTree =
+      reinterpret_cast<decltype(this->XQueryTree)>(
+          dlsym(library_, "XQueryTree"));
+  if (!XQueryTree) {
+    CleanUp(true);
+    return false;
+  }
+
+  XFetchName =
+      reinterpret_cast<decltype(this->XFetchName)>(
+          dlsym(library_, "XFetchName"));
+  if (!XFetchName) {
+    CleanUp(true);
+    return false;
+  }
+
+  XFree =
+      reinterpret_cast<decltype(this->XFree)>(
+          dlsym(library_, "XFree"));
+  if (!XFree) {
+    CleanUp(true);
+    return false;
+  }
+
+  XSetErrorHandler =
+      reinterpret_cast<decltype(this->XSetErrorHandler)>(
+          dlsym(library_, "XSetErrorHandler"));
+  if (!XSetErrorHandler) {
+    CleanUp(true);
+    return false;
+  }
+
+  XSync =
+      reinterpret_cast<decltype(this->XSync)>(
+          dlsym(library_, "XSync"));
+  if (!XSync) {
+    CleanUp(true);
+    return false;
+  }
+
   loaded_ = true;
   return true;
 }
@@ -103,6 +143,11 @@ void libx11_loader::CleanUp(bool unload) {
   XStringToKeysym = NULL;
   XGetGeometry = NULL;
   XQueryExtension = NULL;
+  XQueryTree = NULL;
+  XFetchName = NULL;
+  XFree = NULL;
+  XSetErrorHandler = NULL;
+  XSync = NULL;
 
 }
 
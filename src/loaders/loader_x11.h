@@ -22,6 +22,11 @@ class libx11_loader {
   decltype(&::XStringToKeysym) XStringToKeysym;
   decltype(&::XGetGeometry) XGetGeometry;
   decltype(&::XQueryExtension) XQueryExtension;
+  decltype(&::XQueryTree) XQueryTree;
+  decltype(&::XFetchName) XFetchName;
+  decltype(&::XFree) XFree;
+  decltype(&::XSetErrorHandler) XSetErrorHandler;
+  decltype(&::XSync) XSync;
 
 
  private:
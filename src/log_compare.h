@@ -0,0 +1,467 @@
+#pragma once
+#ifndef MANGOHUD_LOG_COMPARE_H
+#define MANGOHUD_LOG_COMPARE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "frametime_histogram.h"
+
+// A frametime_histogram bucket, with the extremes of what landed in it to
+// interpolate percentiles between
+struct log_bucket {
+    uint16_t idx;
+    uint32_t frames;
+    float min_ms, max_ms;
+};
+
+// A stretch of one log, what the comparison resamples. Frames a few ms apart
+// aren't independent samples, stretches of several seconds nearly are.
+struct log_unit {
+    uint32_t log;                // index of the log it's from
+    uint64_t frames;
+    double sum_ms;               // its frametimes summed
+    std::vector<log_bucket> buckets;  // buckets in use, ascending
+};
+
+// A number as the logger writes them: optional sign, digits, fraction and
+// exponent. value is left alone if there are no digits.
+inline const char* parse_log_number(const char* p, const char* end, double& value) {
+    bool negative = p < end && *p == '-';
+    if (negative)
+        p++;
+    double v = 0;
+    bool digits = false;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits = true)
+        v = v * 10 + (*p - '0');
+    if (p < end && *p == '.') {
+        double scale = 1;
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits = true)
+            v += (*p - '0') * (scale /= 10);
+    }
+    if (!digits)
+        return p;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negative_exp = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+'))
+            p++;
+        int exp = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+            exp = std::min(exp * 10 + (*p - '0'), 400);
+        v *= std::pow(10.0, negative_exp ? -exp : exp);
+    }
+    value = negative ? -v : v;
+    return p;
+}
+
+/*
+ * Calls row(frametime_ms, elapsed_ms) for every row of a MangoHud csv log,
+ * with elapsed_ms -1 for logs from before the elapsed column. Anything
+ * before the column header is skipped, so logs with and without
+ * log_versioning both work, and so do rows that don't parse. Returns false
+ * if there is no column header.
+ *
+ * Works on the bytes as they are, mmap()ed files aren't null terminated.
+ */
+template <typename F>
+bool parse_csv_log(const char* data, size_t size, F row) {
+    const char* p = data;
+    const char* end = data + size;
+
+    int frametime_col = -1, elapsed_col = -1;
+    while (p < end && frametime_col < 0) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+        if (eol - p > 4 && !memcmp(p, "fps,", 4)) {
+            int col = 0;
+            for (const char* field = p; field < eol; col++) {
+                const char* comma = std::find(field, eol, ',');
+                size_t len = comma - field;
+                if (len && field[len - 1] == '\r')
+                    len--;
+                if (len == 9 && !memcmp(field, "frametime", 9))
+                    frametime_col = col;
+                else if (len == 7 && !memcmp(field, "elapsed", 7))
+                    elapsed_col = col;
+                field = comma + 1;
+            }
+        }
+        p = eol + 1;
+    }
+    if (frametime_col < 0)
+        return false;
+
+    int last_col = std::max(frametime_col, elapsed_col);
+    while (p < end) {
+        double frametime = -1, elapsed = -1;
+        int col = 0;
+        const char* q = p;
+        while (q < end && *q != '\n' && col <= last_col) {
+            if (col == frametime_col)
+                q = parse_log_number(q, end, frametime);
+            else if (col == elapsed_col)
+                q = parse_log_number(q, end, elapsed);
+            while (q < end && *q != ',' && *q != '\n')
+                q++;
+            if (q < end && *q == ',')
+                q++;
+            col++;
+        }
+        const char* eol = static_cast<const char*>(memchr(q, '\n', end - q));
+        p = eol ? eol + 1 : end;
+
+        if (!(frametime > 0))
+            continue;
+        // The elapsed column is in ns
+        row(float(frametime), elapsed >= 0 ? elapsed / 1e6 : -1.0);
+    }
+    return true;
+}
+
+// Cuts a log into units of unit_ms as its rows come in, by the elapsed
+// column where there is one and by summed frametimes otherwise. A short
+// stretch left at the end joins the unit before it.
+class log_unit_builder {
+public:
+    log_unit_builder(uint32_t log, double unit_ms)
+        : log(log), unit_ms(unit_ms), buckets(frametime_histogram::num_buckets, log_bucket {}) {}
+
+    void add(float frametime_ms, double elapsed_ms) {
+        if (elapsed_ms < 0)
+            elapsed_ms = summed_ms;
+        summed_ms += frametime_ms;
+
+        if (!frames)
+            unit_start = elapsed_ms;
+        else if (elapsed_ms - unit_start >= unit_ms) {
+            close();
+            unit_start = elapsed_ms;
+        }
+
+        size_t idx = frametime_histogram::bucket(frametime_ms);
+        log_bucket& b = buckets[idx];
+        if (!b.frames)
+            b = { uint16_t(idx), 0, frametime_ms, frametime_ms };
+        b.frames++;
+        b.min_ms = std::min(b.min_ms, frametime_ms);
+        b.max_ms = std::max(b.max_ms, frametime_ms);
+        frames++;
+        sum_ms += frametime_ms;
+        unit_end = elapsed_ms;
+    }
+
+    std::vector<log_unit> finish() {
+        bool is_short = unit_end - unit_start < unit_ms / 2;
+        if (frames && is_short && !units.empty()) {
+            log_unit tail = take();
+            merge_log_units(units.back(), tail);
+        } else if (frames) {
+            close();
+        }
+        return std::move(units);
+    }
+
+    // Adds from's frames to into
+    static void merge_log_units(log_unit& into, const log_unit& from) {
+        std::vector<log_bucket> merged;
+        merged.reserve(into.buckets.size() + from.buckets.size());
+        auto a = into.buckets.cbegin();
+        auto b = from.buckets.cbegin();
+        while (a != into.buckets.cend() || b != from.buckets.cend()) {
+            if (b == from.buckets.cend() || (a != into.buckets.cend() && a->idx < b->idx))
+                merged.push_back(*a++);
+            else if (a == into.buckets.cend() || b->idx < a->idx)
+                merged.push_back(*b++);
+            else {
+                merged.push_back({ a->idx, a->frames + b->frames,
+                                   std::min(a->min_ms, b->min_ms), std::max(a->max_ms, b->max_ms) });
+                a++;
+                b++;
+            }
+        }
+        into.buckets.swap(merged);
+        into.frames += from.frames;
+        into.sum_ms += from.sum_ms;
+    }
+
+private:
+    void close() { units.push_back(take()); }
+
+    log_unit take() {
+        log_unit u;
+        u.log = log;
+        u.frames = frames;
+        u.sum_ms = sum_ms;
+        for (log_bucket& b : buckets) {
+            if (b.frames) {
+                u.buckets.push_back(b);
+                b.frames = 0;
+            }
+        }
+        frames = 0;
+        sum_ms = 0;
+        return u;
+    }
+
+    const uint32_t log;
+    const double unit_ms;
+    std::vector<log_bucket> buckets;
+    uint64_t frames = 0;
+    double sum_ms = 0;
+    double summed_ms = 0;
+    double unit_start = 0;
+    double unit_end = 0;
+    std::vector<log_unit> units;
+};
+
+// Halves the units of every log, joining neighbours, until there are no
+// more than max_units. Every resample walks the buckets of every unit, and
+// joined units share most of theirs.
+inline void coarsen_log_units(std::vector<log_unit>& units, size_t max_units) {
+    while (units.size() > max_units) {
+        std::vector<log_unit> joined;
+        for (size_t i = 0; i < units.size(); i++) {
+            if (i + 1 < units.size() && units[i + 1].log == units[i].log) {
+                log_unit_builder::merge_log_units(units[i], units[i + 1]);
+                joined.push_back(std::move(units[i++]));
+            } else {
+                joined.push_back(std::move(units[i]));
+            }
+        }
+        bool joined_any = joined.size() < units.size();
+        units.swap(joined);
+        if (!joined_any)
+            break;
+    }
+}
+
+enum log_metric {
+    LOG_METRIC_AVG_FPS,
+    LOG_METRIC_LOW_1,            // 1% and 0.1% min fps
+    LOG_METRIC_LOW_01,
+    LOG_METRIC_P50_MS,           // median and 95th percentile frametime
+    LOG_METRIC_P95_MS,
+    LOG_METRIC_COUNT,
+};
+
+inline const char* log_metric_name(size_t m) {
+    static const char* names[] = { "Average FPS", "1% Min FPS", "0.1% Min FPS", "P50 frametime (ms)", "P95 frametime (ms)" };
+    return names[m];
+}
+
+inline bool log_metric_higher_is_better(size_t m) {
+    return m < LOG_METRIC_P50_MS;
+}
+
+typedef std::array<double, LOG_METRIC_COUNT> log_metrics;
+
+// Every metric of the units added, the way MangoHud's summary has them
+class log_metrics_accumulator {
+public:
+    log_metrics_accumulator() : buckets(frametime_histogram::num_buckets) {}
+
+    void add(const log_unit& u) {
+        for (auto& b : u.buckets) {
+            bucket& into = buckets[b.idx];
+            if (!into.frames) {
+                into.min_ms = b.min_ms;
+                into.max_ms = b.max_ms;
+            } else {
+                into.min_ms = std::min(into.min_ms, b.min_ms);
+                into.max_ms = std::max(into.max_ms, b.max_ms);
+            }
+            into.frames += b.frames;
+        }
+        frames += u.frames;
+        sum_ms += u.sum_ms;
+    }
+
+    void clear() {
+        for (bucket& b : buckets)
+            b.frames = 0;
+        frames = 0;
+        sum_ms = 0;
+    }
+
+    log_metrics metrics() const {
+        log_metrics m {};
+        if (!frames)
+            return m;
+        m[LOG_METRIC_AVG_FPS] = 1000.0 * frames / sum_ms;
+        m[LOG_METRIC_LOW_1] = 1000.0 / slowest(std::max(0.01 * frames - 1, 0.0));
+        m[LOG_METRIC_LOW_01] = 1000.0 / slowest(std::max(0.001 * frames - 1, 0.0));
+        m[LOG_METRIC_P50_MS] = slowest(frames / 2);
+        m[LOG_METRIC_P95_MS] = slowest(std::max(0.05 * frames - 1, 0.0));
+        return m;
+    }
+
+private:
+    struct bucket {
+        uint64_t frames = 0;
+        float min_ms = 0, max_ms = 0;
+    };
+
+    // Spread evenly between the fastest and slowest frame of its bucket.
+    // Resamples often differ by a few frames within one bucket, a single
+    // value per bucket would snap their percentiles and intervals to it.
+    double slowest(uint64_t rank) const {
+        uint64_t seen = 0;
+        for (size_t i = buckets.size(); i-- > 0;) {
+            const bucket& b = buckets[i];
+            if (seen + b.frames > rank) {
+                if (b.frames < 2)
+                    return b.max_ms;
+                return b.max_ms - double(b.max_ms - b.min_ms) * (rank - seen) / (b.frames - 1);
+            }
+            seen += b.frames;
+        }
+        return 0.0;
+    }
+
+    std::vector<bucket> buckets;
+    uint64_t frames = 0;
+    double sum_ms = 0;
+};
+
+struct metric_comparison {
+    double a, b;
+    double change;               // % of b against a
+    double ci_low, ci_high;      // 95% bootstrap interval of the change
+};
+
+struct log_comparison {
+    size_t units_a, units_b;
+    std::array<metric_comparison, LOG_METRIC_COUNT> metrics;
+    double mann_whitney_p;       // two sided, over the average fps of the units
+    double superiority;          // chance a unit of b has a higher average fps than one of a
+};
+
+// Two sided p of the Mann-Whitney U test, normal approximation with ties
+// corrected and continuity correction, and U of b over na * nb
+inline double mann_whitney(const std::vector<double>& a, const std::vector<double>& b, double& superiority) {
+    superiority = 0.5;
+    if (a.empty() || b.empty())
+        return 1.0;
+
+    std::vector<std::pair<double, bool>> all;  // value, from b
+    for (double v : a)
+        all.push_back({ v, false });
+    for (double v : b)
+        all.push_back({ v, true });
+    std::sort(all.begin(), all.end());
+
+    double na = a.size(), nb = b.size(), n = na + nb;
+    double rank_sum_b = 0, ties = 0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first)
+            j++;
+        double t = j - i;
+        double midrank = (i + 1 + j) / 2.0;
+        for (size_t k = i; k < j; k++)
+            if (all[k].second)
+                rank_sum_b += midrank;
+        ties += t * t * t - t;
+        i = j;
+    }
+
+    double u = rank_sum_b - nb * (nb + 1) / 2;
+    superiority = u / (na * nb);
+    double mean = na * nb / 2;
+    double var = na * nb / 12 * ((n + 1) - ties / (n * (n - 1)));
+    if (!(var > 0))
+        return 1.0;
+    double z = std::max(std::abs(u - mean) - 0.5, 0.0) / std::sqrt(var);
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+/*
+ * Compares b against a: the metrics of each side, the change and its 95%
+ * percentile bootstrap interval, from resampling the units of each side with
+ * replacement. Resamples are spread over workers; every resample seeds its
+ * own generator, so the result doesn't depend on how many there are.
+ */
+inline log_comparison compare_log_units(const std::vector<log_unit>& a, const std::vector<log_unit>& b,
+                                        unsigned resamples, unsigned workers, uint64_t seed) {
+    log_comparison c {};
+    c.units_a = a.size();
+    c.units_b = b.size();
+
+    log_metrics_accumulator acc;
+    for (auto& u : a)
+        acc.add(u);
+    log_metrics ma = acc.metrics();
+    acc.clear();
+    for (auto& u : b)
+        acc.add(u);
+    log_metrics mb = acc.metrics();
+
+    std::vector<double> fps_a, fps_b;
+    for (auto& u : a)
+        fps_a.push_back(1000.0 * u.frames / u.sum_ms);
+    for (auto& u : b)
+        fps_b.push_back(1000.0 * u.frames / u.sum_ms);
+    c.mann_whitney_p = mann_whitney(fps_a, fps_b, c.superiority);
+
+    // change[metric][resample]
+    std::vector<std::vector<double>> changes(LOG_METRIC_COUNT, std::vector<double>(resamples));
+    std::atomic<unsigned> next {0};
+    auto work = [&]() {
+        log_metrics_accumulator ra, rb;
+        for (unsigned r; (r = next.fetch_add(1)) < resamples;) {
+            // splitmix64
+            uint64_t state = seed + 0x9e3779b97f4a7c15 * (r + 1);
+            auto random = [&state]() {
+                uint64_t z = (state += 0x9e3779b97f4a7c15);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+                return z ^ (z >> 31);
+            };
+            ra.clear();
+            rb.clear();
+            for (size_t i = 0; i < a.size(); i++)
+                ra.add(a[random() % a.size()]);
+            for (size_t i = 0; i < b.size(); i++)
+                rb.add(b[random() % b.size()]);
+            log_metrics sa = ra.metrics(), sb = rb.metrics();
+            for (size_t m = 0; m < LOG_METRIC_COUNT; m++)
+                changes[m][r] = sa[m] > 0 ? 100.0 * (sb[m] - sa[m]) / sa[m] : 0.0;
+        }
+    };
+
+    if (!a.empty() && !b.empty()) {
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < std::max(workers, 1u); i++)
+            threads.emplace_back(work);
+        work();
+        for (auto& t : threads)
+            t.join();
+    }
+
+    for (size_t m = 0; m < LOG_METRIC_COUNT; m++) {
+        metric_comparison& mc = c.metrics[m];
+        mc.a = ma[m];
+        mc.b = mb[m];
+        mc.change = ma[m] > 0 ? 100.0 * (mb[m] - ma[m]) / ma[m] : 0.0;
+        std::vector<double>& v = changes[m];
+        if (v.empty() || a.empty() || b.empty()) {
+            mc.ci_low = -INFINITY;
+            mc.ci_high = INFINITY;
+            continue;
+        }
+        std::sort(v.begin(), v.end());
+        mc.ci_low = v[size_t(0.025 * (v.size() - 1))];
+        mc.ci_high = v[size_t(std::ceil(0.975 * (v.size() - 1)))];
+    }
+    return c;
+}
+
+#endif //MANGOHUD_LOG_COMPARE_H
@@ -2,6 +2,8 @@
 #include <iomanip>
 #include <array>
 #include <algorithm>
+#include <cmath>
+#include <map>
 #include <spdlog/spdlog.h>
 #include "logging.h"
 #include "overlay.h"
@@ -10,6 +12,9 @@
 #include "string_utils.h"
 #include "version.h"
 #include "fps_metrics.h"
+#include "experiment.h"
+#include "benchmark_plan.h"
+#include "run_history.h"
 
 using namespace std;
 
@@ -17,7 +22,8 @@ string os, cpu, gpu, ram, kernel, driver, cpusched;
 bool sysInfoFetched = false;
 double fps;
 float frametime;
-logData currentLogData = {};
+std::atomic<uint64_t> frame_time_ns {0};
+snapshot_buffer<hw_snapshot, 5> hw_snapshots;
 std::unique_ptr<Logger> logger;
 ofstream output_file;
 std::thread log_thread;
@@ -60,11 +66,6 @@ static void upload_files(const std::vector<std::string>& logFiles){
   exec("xdg-open " + url);
 }
 
-static bool compareByFps(const logData &a, const logData &b)
-{
-    return a.fps < b.fps;
-}
-
 static void writeSummary(string filename){
   auto& logArray = logger->get_log_data();
   // if the log is stopped/started too fast we might end up with an empty vector.
@@ -85,9 +86,12 @@ static void writeSummary(string filename){
         << "Average GPU Temp," << "Average CPU Temp," << "Average VRAM Used,"
         << "Average RAM Used," << "Average Swap Used," << "Peak GPU Load,"
         << "Peak CPU Load," << "Peak GPU Temp," << "Peak CPU Temp,"
-        << "Peak VRAM Used," << "Peak RAM Used," << "Peak Swap Used" << "\n";
-    std::vector<logData> sorted = logArray;
-    std::sort(sorted.begin(), sorted.end(), compareByFps);
+        << "Peak VRAM Used," << "Peak RAM Used," << "Peak Swap Used";
+    bool pacing_enabled = HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_frame_pacing];
+    if (pacing_enabled)
+      out << "," << "Median Frame Jitter," << "99% Frame Jitter," << "Off Pace Frames,"
+          << "Missed VBlanks," << "Stutter Index";
+    out << "\n";
     float total = 0.0f;
     float total_gpu = 0.0f;
     float total_cpu = 0.0f;
@@ -104,20 +108,17 @@ static void writeSummary(string filename){
     float peak_ram = 0.0f;
     float peak_swap = 0.0f;
     float result;
-    std::vector<float> fps_values;
-    for (auto& data : sorted)
-      fps_values.push_back(data.frametime);
 
     std::unique_ptr<fpsMetrics> fpsmetrics;
     std::vector<std::string> metrics {"0.001", "0.01", "0.97"};
-    fpsmetrics = std::make_unique<fpsMetrics>(metrics, fps_values);
+    fpsmetrics = std::make_unique<fpsMetrics>(metrics, logger->get_frametimes());
     for (auto& metric : fpsmetrics->metrics)
       out << metric.value << ",";
 
     fpsmetrics.reset();
 
     total = 0;
-    for (auto input : sorted){
+    for (auto& input : logArray){
       total = total + input.frametime;
       total_gpu = total_gpu + input.gpu_load;
       total_cpu = total_cpu + input.cpu_load;
@@ -135,31 +136,31 @@ static void writeSummary(string filename){
       peak_swap = std::max(peak_swap, input.swap_used);
     }
     // Average FPS
-    result = 1000 / (total / sorted.size());
+    result = 1000 / (total / logArray.size());
     out << fixed << setprecision(1) << result << ",";
     // GPU Load (Average)
-    result = total_gpu / sorted.size();
+    result = total_gpu / logArray.size();
     out << result << ",";
     // CPU Load (Average)
-    result = total_cpu / sorted.size();
+    result = total_cpu / logArray.size();
     out << result << ",";
     // Average Frame Time
-    result = total / sorted.size();
+    result = total / logArray.size();
     out << result << ",";
     // Average GPU Temp
-    result = total_gpu_temp / sorted.size();
+    result = total_gpu_temp / logArray.size();
     out << result << ",";
     // Average CPU Temp
-    result = total_cpu_temp / sorted.size();
+    result = total_cpu_temp / logArray.size();
     out << result << ",";
     // Average VRAM Used
-    result = total_vram / sorted.size();
+    result = total_vram / logArray.size();
     out << result << ",";
     // Average RAM Used
-    result = total_ram / sorted.size();
+    result = total_ram / logArray.size();
     out << result << ",";
     // Average Swap Used
-    result = total_swap / sorted.size();
+    result = total_swap / logArray.size();
     out << result << ",";
     // Peak GPU Load
     out << peak_gpu << ",";
@@ -175,13 +176,335 @@ static void writeSummary(string filename){
     out << peak_ram << ",";
     // Peak Swap Used
     out << peak_swap;
+    // Frame pacing of the whole log
+    if (pacing_enabled) {
+      frame_pacing_summary pacing = pacing_stats.last_session();
+      out << "," << setprecision(2) << pacing.jitter_p50 << ",";
+      out << pacing.jitter_p99 << ",";
+      out << pacing.off_pace << ",";
+      if (pacing.vblanks_known)
+        out << pacing.missed_vblanks;
+      out << ",";
+      out << pacing.stutter_index;
+    }
+
+    // Each warm-up, steady and stall part of the log on its own, from the
+    // global metrics thread rather than the one-off above
+    if (::fpsmetrics && ::fpsmetrics->detects_steady_state()) {
+      out << "\n\n" << "Segment," << "Start," << "Duration," << "Frames,"
+          << "Average FPS," << "1% Min FPS," << "0.1% Min FPS";
+      std::vector<segment_stats> segments = ::fpsmetrics->segments();
+      for (auto& segment : segments) {
+        out << "\n" << run_segment_name(segment.type) << ",";
+        out << (segment.start_ms - segments.front().start_ms) / 1000 << ",";
+        out << segment.duration_ms / 1000 << ",";
+        out << segment.frames << ",";
+        out << segment.avg_fps << "," << segment.low_1 << "," << segment.low_01;
+      }
+    }
   } else {
     SPDLOG_ERROR("Failed to write log file");
   }
   out.close();
 }
 
-static void writeFileHeaders(ofstream& out){
+// One row per experiment variant, with the change against the first one.
+// Confidence intervals are left empty until there are enough intervals.
+static void writeExperiment(ab_experiment* exp, string filename){
+  std::vector<experiment_result> results = exp->results();
+  if (results.empty())
+    return;
+
+  filename = filename.substr(0, filename.size() - 4);
+  filename += "_experiment.csv";
+  SPDLOG_DEBUG("Writing experiment results [{}]", filename);
+  std::ofstream out(filename, ios::out | ios::trunc);
+  if (!out) {
+    SPDLOG_ERROR("Failed to write experiment results [{}]", filename);
+    return;
+  }
+
+  auto ci = [&](double half_width) {
+    if (std::isfinite(half_width))
+      out << half_width;
+  };
+
+  out << "Variant," << "Intervals," << "Frames," << "Average FPS," << "95% CI,"
+      << "1% Min FPS," << "0.1% Min FPS," << "Change %," << "Change 95% CI" << "\n";
+  out << fixed << setprecision(2);
+  for (auto& r : results) {
+    out << r.name << "," << r.intervals << "," << r.frames << "," << r.avg_fps << ",";
+    ci(r.ci95);
+    out << "," << r.low_1 << "," << r.low_01 << "," << r.change << ",";
+    ci(r.change_ci95);
+    out << "\n";
+  }
+}
+
+static string json_string(const string& s){
+  std::ostringstream out;
+  out << '"';
+  for (unsigned char c : s) {
+    if (c == '"' || c == '\\')
+      out << '\\' << c;
+    else if (c < 0x20)
+      out << "\\u" << hex << setw(4) << setfill('0') << int(c) << dec;
+    else
+      out << c;
+  }
+  out << '"';
+  return out.str();
+}
+
+// JSON has no NaN or infinity
+static string json_number(double value){
+  if (!std::isfinite(value))
+    return "null";
+  std::ostringstream out;
+  out.imbue(std::locale::classic());
+  out << setprecision(6) << value;
+  return out.str();
+}
+
+static string fnv1a(const string& s){
+  uint64_t hash = 0xcbf29ce484222325;
+  for (unsigned char c : s) {
+    hash ^= c;
+    hash *= 0x100000001b3;
+  }
+  std::ostringstream out;
+  out << hex << setw(16) << setfill('0') << hash;
+  return out.str();
+}
+
+// Hash of the options in effect, sorted, so runs with the same config can be
+// told apart from runs with a different one without shipping it
+static string config_hash(const overlay_params& params){
+  std::map<string, string> sorted(params.options.begin(), params.options.end());
+  string options;
+  for (auto& option : sorted)
+    options += option.first + "=" + option.second + "\n";
+  return fnv1a(options);
+}
+
+template <typename T>
+static void write_hw_average(ofstream& out, const vector<logData>& logArray, const char* name, T logData::*field, bool last = false){
+  double total = 0;
+  double peak = 0;
+  for (auto& input : logArray) {
+    total += input.*field;
+    peak = std::max(peak, double(input.*field));
+  }
+  out << "      " << json_string(name) << ": { \"average\": " << json_number(total / logArray.size())
+      << ", \"peak\": " << json_number(peak) << " }" << (last ? "\n" : ",\n");
+}
+
+// The same log as writeSummary() for scripts and dashboards, with the whole
+// percentile curve, time-weighted lows and what the run was on
+static void writeJsonSummary(string filename){
+  auto& logArray = logger->get_log_data();
+  const frametime_histogram& frametimes = logger->get_frametimes();
+  if (logArray.empty() || !frametimes.count())
+    return;
+
+  filename = filename.substr(0, filename.size() - 4);
+  filename += "_summary.json";
+  SPDLOG_DEBUG("Writing json summary [{}]", filename);
+  std::ofstream out(filename, ios::out | ios::trunc);
+  if (!out) {
+    SPDLOG_ERROR("Failed to write json summary [{}]", filename);
+    return;
+  }
+
+  string program = get_wine_exe_name();
+  if (program.empty())
+    program = get_program_name();
+
+  out << "{\n";
+  out << "  \"format\": 1,\n";
+  out << "  \"mangohud\": " << json_string(MANGOHUD_VERSION) << ",\n";
+  out << "  \"system\": {\n";
+  out << "    \"os\": " << json_string(os) << ",\n";
+  out << "    \"cpu\": " << json_string(cpu) << ",\n";
+  out << "    \"gpu\": " << json_string(gpu) << ",\n";
+  out << "    \"ram\": " << json_string(ram) << ",\n";
+  out << "    \"kernel\": " << json_string(kernel) << ",\n";
+  out << "    \"driver\": " << json_string(driver) << ",\n";
+  out << "    \"cpu_scheduler\": " << json_string(cpusched) << ",\n";
+  out << "    \"wine\": " << json_string(wineVersion) << "\n";
+  out << "  },\n";
+  out << "  \"program\": {\n";
+  out << "    \"name\": " << json_string(program) << ",\n";
+  out << "    \"exe\": " << json_string(get_exe_path()) << ",\n";
+  out << "    \"config_file\": " << json_string(HUDElements.params->config_file_path) << ",\n";
+  out << "    \"config_hash\": " << json_string(config_hash(*HUDElements.params)) << "\n";
+  out << "  },\n";
+
+  double duration = std::chrono::duration<double>(logArray.back().previous).count();
+  out << "  \"duration_s\": " << json_number(duration) << ",\n";
+  out << "  \"samples\": " << frametimes.count() << ",\n";
+  out << "  \"average_fps\": " << json_number(1000.0 / frametimes.average()) << ",\n";
+
+  // Frametime at which that many percent of the samples were faster
+  static const char* percentiles[] = { "0.1", "1", "5", "10", "25", "50", "75", "90", "95", "97", "99", "99.9" };
+  out << "  \"frametime_percentiles_ms\": {\n";
+  for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+    double slower = 1.0 - std::stod(percentiles[i]) / 100;
+    uint64_t rank = std::max(slower * frametimes.count() - 1, 0.0);
+    out << "    " << json_string(string("P") + percentiles[i]) << ": "
+        << json_number(frametimes.slowest(rank))
+        << (i + 1 < sizeof(percentiles) / sizeof(percentiles[0]) ? ",\n" : "\n");
+  }
+  out << "  },\n";
+
+  // By share of the frames, like the csv summary, and by share of the time
+  static const char* lows[] = { "1", "0.1" };
+  out << "  \"lows_fps\": {\n";
+  for (size_t i = 0; i < 2; i++) {
+    double share = std::stod(lows[i]) / 100;
+    uint64_t rank = std::max(share * frametimes.count() - 1, 0.0);
+    out << "    " << json_string(string(lows[i]) + "%") << ": { \"frame_weighted\": "
+        << json_number(1000.0 / frametimes.slowest(rank)) << ", \"time_weighted\": "
+        << json_number(1000.0 / frametimes.slowest_for(share * frametimes.sum()))
+        << (i ? " }\n" : " },\n");
+  }
+  out << "  },\n";
+
+  float median = frametimes.slowest(frametimes.count() / 2);
+  out << "  \"stutters\": {\n";
+  out << "    \"over_2x_median\": " << frametimes.at_least(2 * median) << ",\n";
+  out << "    \"over_4x_median\": " << frametimes.at_least(4 * median) << "\n";
+  out << "  },\n";
+
+  // Nothing was tracked without frame_pacing, zeros would read as perfect pacing
+  if (!HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_frame_pacing]) {
+    out << "  \"pacing\": null,\n";
+  } else {
+    frame_pacing_summary pacing = pacing_stats.last_session();
+    out << "  \"pacing\": {\n";
+    out << "    \"frames\": " << pacing.frames << ",\n";
+    out << "    \"median_jitter_ms\": " << json_number(pacing.jitter_p50) << ",\n";
+    out << "    \"p99_jitter_ms\": " << json_number(pacing.jitter_p99) << ",\n";
+    out << "    \"off_pace_percent\": " << json_number(pacing.off_pace) << ",\n";
+    out << "    \"missed_vblanks\": ";
+    if (pacing.vblanks_known)
+      out << pacing.missed_vblanks << ",\n";
+    else
+      out << "null,\n";
+    out << "    \"stutter_index\": " << json_number(pacing.stutter_index) << "\n";
+    out << "  },\n";
+  }
+
+  out << "  \"hardware\": {\n";
+  write_hw_average(out, logArray, "cpu_load", &logData::cpu_load);
+  write_hw_average(out, logArray, "cpu_power", &logData::cpu_power);
+  write_hw_average(out, logArray, "cpu_mhz", &logData::cpu_mhz);
+  write_hw_average(out, logArray, "cpu_temp", &logData::cpu_temp);
+  write_hw_average(out, logArray, "gpu_load", &logData::gpu_load);
+  write_hw_average(out, logArray, "gpu_power", &logData::gpu_power);
+  write_hw_average(out, logArray, "gpu_core_clock", &logData::gpu_core_clock);
+  write_hw_average(out, logArray, "gpu_mem_clock", &logData::gpu_mem_clock);
+  write_hw_average(out, logArray, "gpu_temp", &logData::gpu_temp);
+  write_hw_average(out, logArray, "gpu_vram_used", &logData::gpu_vram_used);
+  write_hw_average(out, logArray, "ram_used", &logData::ram_used);
+  write_hw_average(out, logArray, "swap_used", &logData::swap_used);
+  write_hw_average(out, logArray, "process_rss", &logData::process_rss, true);
+  out << "  },\n";
+
+  out << "  \"segments\": [";
+  if (::fpsmetrics && ::fpsmetrics->detects_steady_state()) {
+    std::vector<segment_stats> segments = ::fpsmetrics->segments();
+    for (size_t i = 0; i < segments.size(); i++) {
+      const segment_stats& segment = segments[i];
+      out << (i ? ",\n" : "\n") << "    { \"type\": " << json_string(run_segment_name(segment.type))
+          << ", \"start_s\": " << json_number((segment.start_ms - segments.front().start_ms) / 1000)
+          << ", \"duration_s\": " << json_number(segment.duration_ms / 1000)
+          << ", \"frames\": " << segment.frames
+          << ", \"average_fps\": " << json_number(segment.avg_fps)
+          << ", \"low_1_fps\": " << json_number(segment.low_1)
+          << ", \"low_01_fps\": " << json_number(segment.low_01) << " }";
+    }
+    if (!segments.empty())
+      out << "\n  ";
+  }
+  out << "]\n";
+  out << "}\n";
+}
+
+// Appends the run to the index of its program, config and GPU, and compares
+// it with the last runs there for the benchmark window
+static void updateRunHistory(){
+  auto& logArray = logger->get_log_data();
+  const frametime_histogram& frametimes = logger->get_frametimes();
+  if (logArray.empty() || !frametimes.count())
+    return;
+
+  string dir = get_data_dir();
+  if (dir.empty())
+    return;
+  dir += "/MangoHud/history";
+  if (!make_dirs(dir)) {
+    SPDLOG_ERROR("Failed to create run history folder [{}]", dir);
+    return;
+  }
+
+  string program = get_wine_exe_name();
+  if (program.empty())
+    program = get_program_name();
+
+  // Kernel and driver are left out of the key, the index is where an update
+  // shows up. They are in every line instead.
+  string key = fnv1a(get_exe_path() + "\n" + config_hash(*HUDElements.params) + "\n" + gpu);
+  string filename = dir + "/" + program + "_" + key + ".csv";
+
+  run_history history;
+  bool empty = true;
+  {
+    std::ifstream in(filename);
+    string line;
+    while (std::getline(in, line)) {
+      history.add_line(line);
+      empty = false;
+    }
+  }
+
+  run_record run {};
+  run.time = time(0);
+  run.duration_s = std::chrono::duration<double>(logArray.back().previous).count();
+  run.frames = frametimes.count();
+  run.avg_fps = 1000.f / frametimes.average();
+  run.low_1 = 1000.f / frametimes.slowest(std::max(0.01 * run.frames - 1, 0.0));
+  run.low_01 = 1000.f / frametimes.slowest(std::max(0.001 * run.frames - 1, 0.0));
+  run.kernel = kernel;
+  run.driver = driver;
+  run.mangohud = MANGOHUD_VERSION;
+
+  run_comparison comparison = history.compare(run, HUDElements.params->log_history_runs);
+
+  SPDLOG_DEBUG("Writing run history [{}]", filename);
+  std::ofstream out(filename, ios::out | ios::app);
+  if (!out) {
+    SPDLOG_ERROR("Failed to write run history [{}]", filename);
+    return;
+  }
+  if (empty)
+    out << run_history::header() << "\n";
+  out << run_history::line(run) << "\n";
+
+  if (!comparison.runs)
+    return;
+
+  char text[64];
+  snprintf(text, sizeof(text), "vs last %u: %+.1f%% avg, %+.1f%% 1%%", comparison.runs,
+           comparison.change, comparison.low_1_change);
+  benchmark.history = text;
+  benchmark.regression = comparison.regression;
+  if (comparison.regression)
+    SPDLOG_WARN("Slower than the last {} runs: {:+.1f}% avg fps, {:+.1f}% 1% min fps",
+                comparison.runs, comparison.change, comparison.low_1_change);
+}
+
+static void writeFileHeaders(ofstream& out, const log_columns& columns){
       if (HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_log_versioning]){
       printf("log versioning");
       out << "v1" << endl;
@@ -198,14 +521,43 @@ static void writeFileHeaders(ofstream& out){
     out << "fps," << "frametime," << "cpu_load," << "cpu_power," << "gpu_load,"
         << "cpu_temp," << "gpu_temp," << "gpu_core_clock," << "gpu_mem_clock,"
         << "gpu_vram_used," << "gpu_power," << "ram_used," << "swap_used,"
-        << "process_rss," << "cpu_mhz," << "elapsed" << endl;
+        << "process_rss," << "cpu_mhz,";
+    if (columns.pacing)
+      out << "frame_jitter," << "off_pace," << "missed_vblanks," << "stutter_index,";
+    if (columns.gpu_frametime)
+      out << "gpu_frametime,";
+    if (columns.present_blocking)
+      out << "present_block," << "acquire_block," << "fence_wait,";
+    if (columns.present_latency)
+      out << "display_latency," << "display_interval,";
+    if (columns.overhead)
+      out << "mangohud_overhead," << "mangohud_overhead_gpu,";
+    if (columns.pipeline_compiles)
+      out << "pipeline_compile," << "pipelines_created," << "pipeline_cache_misses,";
+    if (columns.segment)
+      out << "segment,";
+    out << "elapsed" << endl;
+
+}
 
+static log_columns enabled_log_columns(){
+  const overlay_params& params = *HUDElements.params;
+  log_columns columns;
+  columns.pacing = params.enabled[OVERLAY_PARAM_ENABLED_frame_pacing];
+  columns.gpu_frametime = params.enabled[OVERLAY_PARAM_ENABLED_gpu_frametime];
+  columns.present_blocking = params.enabled[OVERLAY_PARAM_ENABLED_present_blocking];
+  columns.present_latency = params.enabled[OVERLAY_PARAM_ENABLED_present_latency];
+  columns.overhead = params.enabled[OVERLAY_PARAM_ENABLED_mangohud_overhead];
+  columns.pipeline_compiles = params.enabled[OVERLAY_PARAM_ENABLED_pipeline_compiles];
+  columns.segment = ::fpsmetrics && ::fpsmetrics->detects_steady_state();
+  return columns;
 }
 
 void Logger::writeToFile(){
   if (!output_file){
     output_file.open(m_log_files.back(), ios::out | ios::app);
-    writeFileHeaders(output_file);
+    m_columns = enabled_log_columns();
+    writeFileHeaders(output_file, m_columns);
   }
 
   auto& logArray = logger->get_log_data();
@@ -225,6 +577,34 @@ void Logger::writeToFile(){
     output_file << logArray.back().swap_used << ",";
     output_file << logArray.back().process_rss << ",";
     output_file << logArray.back().cpu_mhz << ",";
+    if (m_columns.pacing) {
+      output_file << logArray.back().frame_jitter << ",";
+      output_file << logArray.back().off_pace << ",";
+      output_file << logArray.back().missed_vblanks << ",";
+      output_file << logArray.back().stutter_index << ",";
+    }
+    if (m_columns.gpu_frametime)
+      output_file << logArray.back().gpu_frametime << ",";
+    if (m_columns.present_blocking) {
+      output_file << logArray.back().present_block << ",";
+      output_file << logArray.back().acquire_block << ",";
+      output_file << logArray.back().fence_wait << ",";
+    }
+    if (m_columns.present_latency) {
+      output_file << logArray.back().display_latency << ",";
+      output_file << logArray.back().display_interval << ",";
+    }
+    if (m_columns.overhead) {
+      output_file << logArray.back().mangohud_overhead << ",";
+      output_file << logArray.back().mangohud_overhead_gpu << ",";
+    }
+    if (m_columns.pipeline_compiles) {
+      output_file << logArray.back().pipeline_compile << ",";
+      output_file << logArray.back().pipelines_created << ",";
+      output_file << logArray.back().pipeline_cache_misses << ",";
+    }
+    if (m_columns.segment)
+      output_file << logArray.back().segment << ",";
     output_file << std::chrono::duration_cast<std::chrono::nanoseconds>(logArray.back().previous).count() << "\n";
     output_file.flush();
   } else {
@@ -258,6 +638,12 @@ void Logger::start_logging() {
   m_values_valid = false;
   m_logging_on = true;
   m_log_start = Clock::now();
+  m_frametimes.clear();
+  pacing_stats.reset_session();
+  if (fpsmetrics)
+    fpsmetrics->restart_segments();
+  if (ab_experiment* exp = experiment.load(std::memory_order_acquire))
+    exp->restart();
 
   std::string program = get_wine_exe_name();
 
@@ -266,6 +652,10 @@ void Logger::start_logging() {
 
   m_log_files.emplace_back(output_folder + "/" + program + "_" + get_log_suffix());
 
+#ifdef __linux__
+  refresh_server_subscription();
+#endif
+
   if(log_interval != 0){
     std::thread log_thread(&Logger::logging, this);
     // "mangohud-logging" wouldn't fit in the 15 byte limit
@@ -280,9 +670,21 @@ void Logger::stop_logging() {
   m_log_end = Clock::now();
   if (log_thread.joinable()) log_thread.join();
 
+#ifdef __linux__
+  refresh_server_subscription();
+#endif
+
   calculate_benchmark_data();
   output_file.close();
   writeSummary(m_log_files.back());
+  if (HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_log_json])
+    writeJsonSummary(m_log_files.back());
+  benchmark.history.clear();
+  benchmark.regression = false;
+  if (HUDElements.params->enabled[OVERLAY_PARAM_ENABLED_log_history])
+    updateRunHistory();
+  if (ab_experiment* exp = experiment.load(std::memory_order_acquire))
+    writeExperiment(exp, m_log_files.back());
   clear_log_data();
 #ifdef __linux__
   control_client_check(HUDElements.params->control, global_control_client, gpu.c_str());
@@ -306,10 +708,36 @@ void Logger::try_log() {
   auto now = Clock::now();
   auto elapsedLog = now - m_log_start;
 
-  currentLogData.previous = elapsedLog;
-  currentLogData.fps = fps;
-  currentLogData.frametime = frametime;
-  m_log_array.push_back(currentLogData);
+  // Pair the frame with what the hardware did during it rather than with
+  // whatever was sampled last
+  logData entry = hw_snapshots.acquire()->data;
+  log_data_at(frame_time_ns.load(std::memory_order_relaxed), entry);
+  entry.previous = elapsedLog;
+  entry.fps = fps;
+  entry.frametime = frametime;
+  frame_pacing_summary pacing = pacing_stats.last_window();
+  entry.frame_jitter = pacing.jitter_p99;
+  entry.off_pace = pacing.off_pace;
+  entry.missed_vblanks = pacing.missed_vblanks;
+  entry.stutter_index = pacing.stutter_index;
+  entry.gpu_frametime = gpu_timing.last_ms();
+  frame_blocking blocking = blocking_stats.last_frame();
+  entry.present_block = blocking.ms[BLOCK_PRESENT];
+  entry.acquire_block = blocking.ms[BLOCK_ACQUIRE];
+  entry.fence_wait = blocking.ms[BLOCK_FENCE];
+  display_timing display = latency_stats.last_frame();
+  entry.display_latency = display.latency_ms;
+  entry.display_interval = display.interval_ms;
+  overlay_cost overhead = overhead_stats.last_frame();
+  entry.mangohud_overhead = overhead.cpu_total_ms();
+  entry.mangohud_overhead_gpu = overhead.gpu_ms;
+  compile_frame compiles = compile_stats.last_frame();
+  entry.pipeline_compile = compiles.ms;
+  entry.pipelines_created = compiles.pipelines;
+  entry.pipeline_cache_misses = compiles.cache_misses;
+  entry.segment = fpsmetrics && fpsmetrics->detects_steady_state() ? run_segment_name(fpsmetrics->segment()) : "";
+  m_log_array.push_back(entry);
+  m_frametimes.add(entry.frametime);
   writeToFile();
 
   if(log_duration && (elapsedLog >= std::chrono::seconds(log_duration))){
@@ -344,11 +772,46 @@ void autostart_log(int sleep) {
   logger->start_logging();
 }
 
-void Logger::calculate_benchmark_data(){
-  vector<float> fps_values {};
-  for (auto& point : m_log_array)
-    fps_values.push_back(point.frametime);
+void Logger::write_benchmark_plan(const std::vector<benchmark_run_result>& results){
+  if (results.empty())
+    return;
 
+  std::string program = get_wine_exe_name();
+  if (program.empty())
+      program = get_program_name();
+
+  std::string filename = output_folder + "/" + program + "_benchmark_" + get_log_suffix();
+  SPDLOG_INFO("Writing benchmark results [{}]", filename);
+  std::ofstream out(filename, ios::out | ios::trunc);
+  if (!out) {
+    SPDLOG_ERROR("Failed to write benchmark results [{}]", filename);
+    return;
+  }
+
+  out << "Run," << "FPS Limit," << "Duration," << "Frames," << "Average FPS,"
+      << "1% Min FPS," << "0.1% Min FPS" << "\n";
+  out << fixed << setprecision(2);
+  for (size_t i = 0; i < results.size(); i++) {
+    const benchmark_run_result& r = results[i];
+    out << i + 1 << "," << r.fps_limit << "," << r.duration_s << "," << r.frames << ","
+        << r.avg_fps << "," << r.low_1 << "," << r.low_01 << "\n";
+  }
+
+  double mean[5], sd[5];
+  benchmark_plan::mean_sd(results, &benchmark_run_result::duration_s, mean[0], sd[0]);
+  benchmark_plan::mean_sd(results, &benchmark_run_result::frames, mean[1], sd[1]);
+  benchmark_plan::mean_sd(results, &benchmark_run_result::avg_fps, mean[2], sd[2]);
+  benchmark_plan::mean_sd(results, &benchmark_run_result::low_1, mean[3], sd[3]);
+  benchmark_plan::mean_sd(results, &benchmark_run_result::low_01, mean[4], sd[4]);
+  out << "Mean,,";
+  for (int i = 0; i < 5; i++)
+    out << mean[i] << (i < 4 ? "," : "\n");
+  out << "Std Dev,,";
+  for (int i = 0; i < 5; i++)
+    out << sd[i] << (i < 4 ? "," : "\n");
+}
+
+void Logger::calculate_benchmark_data(){
   benchmark.percentile_data.clear();
 
   std::vector<std::string> metrics {"0.97", "avg", "0.01", "0.001"};
@@ -356,7 +819,7 @@ void Logger::calculate_benchmark_data(){
   if (!HUDElements.params->fps_metrics.empty())
     metrics = HUDElements.params->fps_metrics;
     
-  fpsmetrics = std::make_unique<fpsMetrics>(metrics, fps_values);
+  fpsmetrics = std::make_unique<fpsMetrics>(metrics, m_frametimes);
   for (auto& metric : fpsmetrics->metrics)
     benchmark.percentile_data.push_back({metric.display_name, metric.value});
 
@@ -8,11 +8,16 @@
 #include <chrono>
 #include <thread>
 #include <condition_variable>
+#include <atomic>
 
 #include "timing.hpp"
+#include "snapshot.h"
+#include "frametime_histogram.h"
 
 #include "overlay_params.h"
 
+struct benchmark_run_result;
+
 struct logData{
   double fps;
   float frametime;
@@ -29,10 +34,53 @@ struct logData{
   float ram_used;
   float swap_used;
   float process_rss;
+  // Frame pacing over the last frame_pacing_stats::window_ms
+  float frame_jitter;
+  float off_pace;
+  uint64_t missed_vblanks;
+  float stutter_index;
+  // GPU time of the last frame the timestamps came back for, 0 if none did
+  float gpu_frametime;
+  // ms the frame waited in present, acquire and fences, in the driver and
+  // the layers below us
+  float present_block;
+  float acquire_block;
+  float fence_wait;
+  // Of the last frame known to be on screen, 0 without present_latency
+  float display_latency;
+  float display_interval;
+  // CPU and GPU time of drawing the HUD
+  float mangohud_overhead;
+  float mangohud_overhead_gpu;
+  // Pipelines created in the frame, misses need pipeline creation feedback
+  float pipeline_compile;
+  uint32_t pipelines_created;
+  uint32_t pipeline_cache_misses;
+  // run_segment_name() of the frame, empty without steady_state
+  const char* segment;
 
   Clock::duration previous;
 };
 
+// What the hwinfo thread sampled last, published as a whole so the HUD and
+// the logger never see half of an update
+struct hw_snapshot {
+  logData data;
+  std::vector<logData> graph_data;
+};
+
+// Optional columns of the frame log, one group per feature. Fixed when a
+// file is opened so its header and rows agree
+struct log_columns {
+  bool pacing = false;
+  bool gpu_frametime = false;
+  bool present_blocking = false;
+  bool present_latency = false;
+  bool overhead = false;
+  bool pipeline_compiles = false;
+  bool segment = false;
+};
+
 class Logger {
 public:
   Logger(const overlay_params* in_params);
@@ -52,6 +100,8 @@ public:
   auto last_log_begin() const noexcept { return m_log_start; }
 
   const std::vector<logData>& get_log_data() const noexcept { return m_log_array; }
+  // Frametimes of every entry in the current log, for the summary
+  const frametime_histogram& get_frametimes() const noexcept { return m_frametimes; }
   void clear_log_data() noexcept { m_log_array.clear(); }
 
   void writeToFile();
@@ -59,6 +109,8 @@ public:
   void upload_last_log();
   void upload_last_logs();
   void calculate_benchmark_data();
+  // Every run of a benchmark plan and their mean and standard deviation
+  void write_benchmark_plan(const std::vector<benchmark_run_result>& results);
   std::string output_folder;
   const int64_t log_interval;
   const int64_t log_duration;
@@ -66,10 +118,12 @@ public:
 
 private:
   std::vector<logData> m_log_array;
+  frametime_histogram m_frametimes;
   std::vector<std::string> m_log_files;
   Clock::time_point m_log_start;
   Clock::time_point m_log_end;
   bool m_logging_on;
+  log_columns m_columns;
 
   std::mutex m_values_valid_mtx;
   std::condition_variable m_values_valid_cv;
@@ -82,7 +136,11 @@ extern std::string os, cpu, gpu, ram, kernel, driver, cpusched;
 extern bool sysInfoFetched;
 extern double fps;
 extern float frametime;
-extern logData currentLogData;
+// metrics_clock_ns() of the frame fps and frametime belong to, written by
+// the present thread and read by the hwinfo and logger threads
+extern std::atomic<uint64_t> frame_time_ns;
+// Views are held by the render thread (two while switching frames) and the logger
+extern snapshot_buffer<hw_snapshot, 5> hw_snapshots;
 
 std::string exec(std::string command);
 void autostart_log(int sleep);
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include "metrics_delta.h"
+
+static constexpr size_t msg_words = (sizeof(mangohud_message) + 3) / 4;
+static_assert(msg_words <= UINT16_MAX, "word offsets are 16 bit");
+
+// The message doesn't have to be a multiple of 4 bytes, the last word is
+// padded with zeroes
+static uint32_t load_word(const mangohud_message& msg, size_t idx) {
+    uint32_t word = 0;
+    size_t offset = idx * 4;
+    memcpy(&word, reinterpret_cast<const uint8_t*>(&msg) + offset,
+           std::min<size_t>(4, sizeof(msg) - offset));
+    return word;
+}
+
+static void store_word(mangohud_message& msg, size_t idx, uint32_t word) {
+    size_t offset = idx * 4;
+    memcpy(reinterpret_cast<uint8_t*>(&msg) + offset, &word,
+           std::min<size_t>(4, sizeof(msg) - offset));
+}
+
+template <typename T>
+static void append(std::vector<uint8_t>& out, const T& value) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), p, p + sizeof(value));
+}
+
+void encode_metrics_sample(const mangohud_message& prev, const mangohud_message& cur,
+                           uint8_t flags, uint32_t sequence, uint64_t sample_time_ns,
+                           std::vector<uint8_t>& out) {
+    size_t start = out.size();
+    bool keyframe = flags & MANGOHUD_SAMPLE_KEYFRAME;
+
+    mangohud_sample_v2 hdr = {};
+    hdr.hdr.magic = MANGOHUD_REQUEST_MAGIC;
+    hdr.hdr.version = 2;
+    hdr.hdr.type = MANGOHUD_REQUEST_SAMPLE;
+    hdr.header_size = sizeof(hdr);
+    hdr.flags = flags;
+    hdr.sequence = sequence;
+    hdr.msg_size = sizeof(mangohud_message);
+    hdr.sample_time_ns = sample_time_ns;
+    append(out, hdr);
+
+    uint16_t num_runs = 0;
+    size_t i = 0;
+
+    while (i < msg_words) {
+        uint32_t word = load_word(cur, i);
+        uint32_t before = keyframe ? 0 : load_word(prev, i);
+
+        if (word == before) {
+            i++;
+            continue;
+        }
+
+        // One run per stretch of changed words, a single unchanged word in
+        // between costs more to send than a new run header.
+        uint16_t offset = i;
+        size_t count_pos = out.size() + sizeof(offset);
+        append(out, offset);
+        append(out, uint8_t(0));
+
+        uint8_t count = 0;
+        while (i < msg_words && count < UINT8_MAX) {
+            word = load_word(cur, i);
+            before = keyframe ? 0 : load_word(prev, i);
+            if (word == before)
+                break;
+
+            append(out, word);
+            count++;
+            i++;
+        }
+
+        out[count_pos] = count;
+        num_runs++;
+    }
+
+    memcpy(out.data() + start + offsetof(mangohud_sample_v2, num_runs), &num_runs, sizeof(num_runs));
+}
+
+bool apply_metrics_sample(mangohud_message& msg, const uint8_t* data, size_t size) {
+    mangohud_sample_v2 hdr;
+
+    if (size < sizeof(hdr))
+        return false;
+
+    memcpy(&hdr, data, sizeof(hdr));
+
+    if (hdr.hdr.magic != MANGOHUD_REQUEST_MAGIC || hdr.hdr.type != MANGOHUD_REQUEST_SAMPLE ||
+        hdr.header_size < sizeof(hdr) || hdr.header_size > size ||
+        hdr.msg_size != sizeof(mangohud_message))
+        return false;
+
+    // Check every run before touching msg
+    size_t pos = hdr.header_size;
+    for (uint16_t r = 0; r < hdr.num_runs; r++) {
+        uint16_t offset;
+        uint8_t count;
+
+        if (pos + sizeof(offset) + sizeof(count) > size)
+            return false;
+
+        memcpy(&offset, data + pos, sizeof(offset));
+        count = data[pos + sizeof(offset)];
+        pos += sizeof(offset) + sizeof(count) + count * sizeof(uint32_t);
+
+        if (pos > size || size_t(offset) + count > msg_words)
+            return false;
+    }
+
+    if (hdr.flags & MANGOHUD_SAMPLE_KEYFRAME)
+        msg = {};
+
+    pos = hdr.header_size;
+    for (uint16_t r = 0; r < hdr.num_runs; r++) {
+        uint16_t offset;
+        memcpy(&offset, data + pos, sizeof(offset));
+        uint8_t count = data[pos + sizeof(offset)];
+        pos += sizeof(offset) + sizeof(count);
+
+        for (uint8_t w = 0; w < count; w++) {
+            uint32_t word;
+            memcpy(&word, data + pos, sizeof(word));
+            store_word(msg, offset + w, word);
+            pos += sizeof(word);
+        }
+    }
+
+    return true;
+}
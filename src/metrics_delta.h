@@ -0,0 +1,23 @@
+#pragma once
+#ifndef MANGOHUD_METRICS_DELTA_H
+#define MANGOHUD_METRICS_DELTA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "server_protocol.hpp"
+
+// Appends a MANGOHUD_WIRE_DELTA packet to out which turns prev into cur.
+// With MANGOHUD_SAMPLE_KEYFRAME in flags prev is ignored and cur is encoded
+// against a zeroed message. sample_time_ns is the CLOCK_MONOTONIC time cur
+// was read at.
+void encode_metrics_sample(const mangohud_message& prev, const mangohud_message& cur,
+                           uint8_t flags, uint32_t sequence, uint64_t sample_time_ns,
+                           std::vector<uint8_t>& out);
+
+// Applies a MANGOHUD_WIRE_DELTA packet to msg. Malformed packets, or ones
+// from a server with a different mangohud_message, are rejected as a whole
+// and leave msg untouched.
+bool apply_metrics_sample(mangohud_message& msg, const uint8_t* data, size_t size);
+
+#endif //MANGOHUD_METRICS_DELTA_H
@@ -1,6 +1,8 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <cmath>
+#include <type_traits>
 #include <thread>
 #include <condition_variable>
 #include <spdlog/spdlog.h>
@@ -19,6 +21,9 @@
 #include "file_utils.h"
 #include "pci_ids.h"
 #include "fps_metrics.h"
+#include "flight_recorder.h"
+#include "experiment.h"
+#include "benchmark_plan.h"
 #include "net.h"
 #include "fex.h"
 #include "ftrace.h"
@@ -29,6 +34,9 @@
 #endif // __linux__
 
 #include "server_connection.hpp"
+#ifdef HAVE_X11
+#include "shared_x11.h"
+#endif
 
 namespace fs = ghc::filesystem;
 using namespace std;
@@ -39,15 +47,20 @@ bool gui_open = false;
 bool fcat_open = false;
 struct benchmark_stats benchmark;
 struct fps_limit fps_limit_stats {};
+frame_pacing_stats pacing_stats;
+gpu_frame_timing gpu_timing;
+present_blocking_stats blocking_stats;
+present_latency_stats latency_stats;
+overlay_cost_stats overhead_stats;
+pipeline_compile_stats compile_stats;
+std::atomic<ab_experiment*> experiment {nullptr};
+std::atomic<benchmark_plan*> bench_plan {nullptr};
 ImVec2 real_font_size;
-std::deque<logData> graph_data;
 const char* engines[]       = {"Unknown", "OpenGL", "VULKAN", "DXVK", "VKD3D", "DAMAVAND", "ZINK", "WINED3D", "Feral3D", "ToGL", "GAMESCOPE"};
 const char* engines_short[] = {"Unknown", "OGL"   , "VK"    , "DXVK", "VKD3D", "DV"      , "ZINK", "WD3D"   , "Feral3D", "ToGL", "GS"};
 overlay_params *_params {};
-double min_frametime, max_frametime;
 bool gpu_metrics_exists = false;
 bool steam_focused = false;
-vector<float> frametime_data(200,0.f);
 int fan_speed;
 fcatoverlay fcatstatus;
 std::string drm_dev;
@@ -109,6 +122,111 @@ void FpsLimiter(struct fps_limit& stats){
    }
 }
 
+void metrics_to_log_data(const mangohud_message& msg, logData& out)
+{
+    uint8_t gpu_idx = 0;
+    if (get_active_gpu(msg, gpu_idx)) {
+        const gpu_metrics_system_t& system = msg.gpus[gpu_idx].system_metrics;
+        const gpu_metrics_process_t& process = msg.gpus[gpu_idx].process_metrics;
+
+        // some gpus supply only process load
+        if (system.load != -1)
+            out.gpu_load = system.load;
+        else
+            out.gpu_load = process.load;
+
+        out.gpu_temp = system.temperature;
+        out.gpu_core_clock = system.core_clock;
+        out.gpu_mem_clock = system.memory_clock;
+        out.gpu_vram_used = system.vram_used;
+        out.gpu_power = system.power_usage;
+    }
+#ifdef __linux__
+    out.ram_used = msg.memory.used;
+    out.swap_used = msg.memory.swap_used;
+    out.process_rss = msg.memory.process_resident / float((2 << 29)); // GiB, consistent w/ other mem stats
+#endif
+
+   out.cpu_load  = msg.cpu.load;
+   out.cpu_temp  = msg.cpu.temp;
+   out.cpu_power = msg.cpu.power;
+   out.cpu_mhz   = msg.cpu.frequency;
+}
+
+template <typename T>
+static T lerp(T a, T b, double t)
+{
+   double v = a + (b - a) * t;
+   return std::is_integral<T>::value ? T(std::lround(v)) : T(v);
+}
+
+bool log_data_at(uint64_t time_ns, logData& out)
+{
+   // The server can lap the ring while we copy, just look again
+   for (int tries = 0; tries < 4; tries++) {
+      metrics_view before, after;
+      if (!metrics_around(time_ns, before, after))
+         return false;
+
+      logData a = out, b = out;
+      metrics_to_log_data(*before, a);
+      metrics_to_log_data(*after, b);
+
+      if (!before.valid() || !after.valid())
+         continue;
+
+      double t = 0.0;
+      if (after.sample_time_ns > before.sample_time_ns && time_ns > before.sample_time_ns)
+         t = double(time_ns - before.sample_time_ns) / (after.sample_time_ns - before.sample_time_ns);
+
+      out.cpu_load       = lerp(a.cpu_load, b.cpu_load, t);
+      out.cpu_power      = lerp(a.cpu_power, b.cpu_power, t);
+      out.cpu_mhz        = lerp(a.cpu_mhz, b.cpu_mhz, t);
+      out.gpu_load       = lerp(a.gpu_load, b.gpu_load, t);
+      out.cpu_temp       = lerp(a.cpu_temp, b.cpu_temp, t);
+      out.gpu_temp       = lerp(a.gpu_temp, b.gpu_temp, t);
+      out.gpu_core_clock = lerp(a.gpu_core_clock, b.gpu_core_clock, t);
+      out.gpu_mem_clock  = lerp(a.gpu_mem_clock, b.gpu_mem_clock, t);
+      out.gpu_power      = lerp(a.gpu_power, b.gpu_power, t);
+      out.gpu_vram_used  = lerp(a.gpu_vram_used, b.gpu_vram_used, t);
+      out.ram_used       = lerp(a.ram_used, b.ram_used, t);
+      out.swap_used      = lerp(a.swap_used, b.swap_used, t);
+      out.process_rss    = lerp(a.process_rss, b.process_rss, t);
+      return true;
+   }
+
+   return false;
+}
+
+// Rebuilds the graphs from samples the server took before we connected,
+// one point per sampling period going back from the newest sample, so they
+// look the same as if we had been running all along
+static void backfill_graph_data(const std::vector<metrics_sample>& history, uint64_t period_ns,
+                                std::vector<logData>& graph_data)
+{
+   std::vector<logData> points;
+   size_t idx = history.size() - 1;
+   uint64_t t = history.back().sample_time_ns;
+
+   // One short of full, the current sample still goes on top
+   while (points.size() < kMaxGraphEntries - 1) {
+      while (idx > 0 && history[idx].sample_time_ns > t)
+         idx--;
+      if (history[idx].sample_time_ns > t)
+         break;
+
+      logData point = {};
+      metrics_to_log_data(history[idx].msg, point);
+      points.push_back(point);
+
+      if (t < period_ns)
+         break;
+      t -= period_ns;
+   }
+
+   graph_data.assign(points.rbegin(), points.rend());
+}
+
 void update_hw_info(const struct overlay_params& params, uint32_t vendorID)
 {
    if (params.enabled[OVERLAY_PARAM_ENABLED_fan])
@@ -125,53 +243,54 @@ void update_hw_info(const struct overlay_params& params, uint32_t vendorID)
    }
 #endif
 
-    uint8_t gpu_idx = 0;
-    if (get_active_gpu(HUDElements.current_metrics, gpu_idx)) {
-        gpu_metrics_system_t& system = HUDElements.current_metrics.gpus[gpu_idx].system_metrics;
-        gpu_metrics_process_t& process = HUDElements.current_metrics.gpus[gpu_idx].process_metrics;
-
-        // some gpus supply only process load
-        if (system.load != -1)
-            currentLogData.gpu_load = system.load;
-        else
-            currentLogData.gpu_load = process.load;
-
-        currentLogData.gpu_temp = system.temperature;
-        currentLogData.gpu_core_clock = system.core_clock;
-        currentLogData.gpu_mem_clock = system.memory_clock;
-        currentLogData.gpu_vram_used = system.vram_used;
-        currentLogData.gpu_power = system.power_usage;
+    // Working copy of what gets published, only this thread touches it
+    static hw_snapshot sample;
+    logData& currentLogData = sample.data;
+
+    // Converted in place and checked, hw_snapshots must not publish a torn
+    // sample. The last good one stays if the server keeps lapping us.
+    for (int tries = 0; tries < 8; tries++) {
+       metrics_view view = latest_metrics();
+       logData converted = currentLogData;
+       metrics_to_log_data(*view, converted);
+       if (view.valid()) {
+          currentLogData = converted;
+          break;
+       }
     }
-#ifdef __linux__
-    currentLogData.ram_used = HUDElements.current_metrics.memory.used;
-    currentLogData.swap_used = HUDElements.current_metrics.memory.swap_used;
-    currentLogData.process_rss = HUDElements.current_metrics.memory.process_resident / float((2 << 29)); // GiB, consistent w/ other mem stats
-#endif
 
-   currentLogData.cpu_load  = HUDElements.current_metrics.cpu.load;
-   currentLogData.cpu_temp  = HUDElements.current_metrics.cpu.temp;
-   currentLogData.cpu_power = HUDElements.current_metrics.cpu.power;
-   currentLogData.cpu_mhz   = HUDElements.current_metrics.cpu.frequency;
+   static std::vector<metrics_sample> history;
+   if (take_metrics_history(history))
+      backfill_graph_data(history, std::max<uint64_t>(params.fps_sampling_period, 1), sample.graph_data);
 
-    {
-        std::unique_lock<std::mutex> lock_global_metrics(g_metrics_lock);
-        std::unique_lock<std::mutex> lock_cur_metrics(HUDElements.current_metrics_lock);
-        HUDElements.current_metrics = g_metrics;
-        mangohud_message& msg = HUDElements.current_metrics;
+   // Save data for graphs
+   if (sample.graph_data.size() >= kMaxGraphEntries)
+      sample.graph_data.erase(sample.graph_data.begin());
 
-        uint8_t idx = 0;
+   // Graph the frame that triggered this update, not whenever the server
+   // happened to sample last
+   logData graph_point = currentLogData;
+   log_data_at(frame_time_ns.load(std::memory_order_relaxed), graph_point);
+   sample.graph_data.push_back(graph_point);
 
-        for (uint8_t i = 0; i < msg.num_of_gpus; i++) {
-            if (params.gpu_list.size() == 1 && params.gpu_list[0] == idx++)
-                msg.gpus[i].is_active = true;
-        }
-    }
+   hw_snapshots.publish(sample);
 
-   // Save data for graphs
-   if (graph_data.size() >= kMaxGraphEntries)
-      graph_data.pop_front();
+   benchmark_plan* plan = bench_plan.load(std::memory_order_acquire);
+#ifdef __linux__
+   // Reads every /proc/<pid>/comm, too slow for the present thread
+   if (plan && !plan->started() &&
+       params.benchmark_trigger == BENCHMARK_TRIGGER_PROCESS &&
+       !params.benchmark_process.empty() && process_running(params.benchmark_process))
+      plan->start();
+#endif
 
-   graph_data.push_back(currentLogData);
+#ifdef HAVE_X11
+   // Walks the window tree, too slow for the present thread
+   if (plan && !plan->started() &&
+       params.benchmark_trigger == BENCHMARK_TRIGGER_WINDOW &&
+       !params.benchmark_window.empty() && x11_window_exists(params.benchmark_window))
+      plan->start();
+#endif
 
    if (logger)
       logger->notify_data_valid();
@@ -241,17 +360,79 @@ void stop_hw_updater()
       hw_update_thread.reset();
 }
 
+static void set_fps_limit(uint32_t fps)
+{
+   using namespace std::chrono;
+   if (fps > 0)
+      fps_limit_stats.targetFrameTime = duration_cast<Clock::duration>(duration<double>(1) / fps);
+   else
+      fps_limit_stats.targetFrameTime = {};
+}
+
+// Switches what an A/B experiment varies, the rest stays as configured.
+// gl_vsync is left to the GLX swap hook, which has the drawable.
+static void apply_experiment_variant(const experiment_variant& variant)
+{
+   if (variant.fps_limit != experiment_variant::keep)
+      set_fps_limit(variant.fps_limit);
+   if (variant.fps_limit_method != experiment_variant::keep)
+      fps_limit_stats.method = static_cast<enum fps_limit_method>(variant.fps_limit_method);
+}
+
+// Takes the steps the benchmark plan asks for at this frame
+static void run_benchmark_plan(benchmark_plan* plan, const struct overlay_params& params, float frametime_ms)
+{
+   unsigned steps = plan->add(frametime_ms);
+   if (!steps || !logger)
+      return;
+
+   if (steps & benchmark_plan::stop_log)
+      logger->stop_logging();
+   if (steps & benchmark_plan::restore_limit)
+      set_fps_limit(params.fps_limit.empty() ? 0 : params.fps_limit[0]);
+   if (steps & benchmark_plan::apply_limit)
+      set_fps_limit(plan->fps_limit());
+   if (steps & benchmark_plan::start_log) {
+      SPDLOG_INFO("Benchmark run {}/{}", plan->run() + 1, plan->runs());
+      logger->start_logging();
+   }
+   if (steps & benchmark_plan::finished)
+      logger->write_benchmark_plan(plan->results());
+}
+
 void update_hud_info_with_frametime(struct swapchain_stats& sw_stats, const struct overlay_params& params, uint32_t vendorID, uint64_t frametime_ns){
-   uint32_t f_idx = sw_stats.n_frames % ARRAY_SIZE(sw_stats.frames_stats);
    uint64_t now = os_time_get_nano(); /* ns */
    auto elapsed = now - sw_stats.last_fps_update; /* ns */
    float frametime_ms = frametime_ns / 1000000.f;
 
    if (sw_stats.last_present_time) {
-        sw_stats.frames_stats[f_idx].stats[OVERLAY_PLOTS_frame_timing] =
-            frametime_ns;
-      frametime_data.push_back(frametime_ms);
-      frametime_data.erase(frametime_data.begin());
+      sw_stats.frametimes.push(frametime_ms);
+      // Kept in step with frametimes, the graph marks frames by index
+      bool compiles = params.enabled[OVERLAY_PARAM_ENABLED_pipeline_compiles];
+      sw_stats.compile_ms.push(compiles ? compile_stats.end_frame().ms : 0.f);
+
+      if (params.enabled[OVERLAY_PARAM_ENABLED_frame_pacing]) {
+         // The fps limit is the pace to keep, the refresh rate (or the limit
+         // without one) is what missed vblanks are counted in
+         float target_ms = std::chrono::duration<float, std::milli>(fps_limit_stats.targetFrameTime).count();
+         float vblank_ms = HUDElements.refresh > 0 ? 1000.f / HUDElements.refresh : target_ms;
+         pacing_stats.add(frametime_ms, target_ms, vblank_ms);
+      }
+
+      ab_experiment* exp = experiment.load(std::memory_order_acquire);
+      if (exp && exp->add(frametime_ms))
+         apply_experiment_variant(exp->current());
+
+      benchmark_plan* plan = bench_plan.load(std::memory_order_acquire);
+      if (plan)
+         run_benchmark_plan(plan, params, frametime_ms);
+
+      if (params.enabled[OVERLAY_PARAM_ENABLED_frametime_distribution]) {
+         uint32_t window_ms = params.frametime_distribution_window * 1000;
+         if (sw_stats.distribution.window_ms() != window_ms)
+            sw_stats.distribution.set_window(window_ms);
+         sw_stats.distribution.add(frametime_ms);
+      }
    }
 
 #ifdef HAVE_FEX
@@ -264,8 +445,38 @@ void update_hud_info_with_frametime(struct swapchain_stats& sw_stats, const stru
       FTrace::object->update();
    }
 #endif
+   if (recorder && params.enabled[OVERLAY_PARAM_ENABLED_flight_recorder] && sw_stats.last_present_time) {
+      flight_recorder::frame_record record {};
+      record.present_ns = metrics_clock_ns();
+      record.frametime = frametime_ms;
+      {
+         // The server's ring only goes back seconds, a dump needs the values
+         // from as far back as it reaches
+         auto hw = hw_snapshots.acquire();
+         const logData& d = hw->data;
+         record.hw = { float(d.cpu_load), float(d.cpu_power), float(d.cpu_temp), float(d.cpu_mhz),
+                       float(d.gpu_load), float(d.gpu_temp), float(d.gpu_core_clock),
+                       float(d.gpu_mem_clock), d.gpu_vram_used, float(d.gpu_power),
+                       d.ram_used, d.swap_used, d.process_rss };
+      }
+#ifdef HAVE_FEX
+      record.fex_sigbus = fex::sigbus_counts.Count();
+      record.fex_smc = fex::smc_counts.Count();
+      record.fex_softfloat = fex::softfloat_counts.Count();
+#endif
+#ifdef HAVE_FTRACE
+      if (FTrace::object) {
+         const auto& tracepoints = FTrace::object->tracepoints();
+         for (size_t i = 0; i < tracepoints.size() && i < flight_recorder::max_trace_values; i++)
+            record.trace[i] = tracepoints[i]->data.plot.values[tracepoints[i]->update_index];
+      }
+#endif
+      recorder->add(record);
+   }
    frametime = frametime_ms;
    fps = double(1000 / frametime_ms);
+   // Hardware samples are matched against the middle of the frame
+   frame_time_ns.store(metrics_clock_ns() - frametime_ns / 2, std::memory_order_relaxed);
    if (fpsmetrics) fpsmetrics->update(frametime_ms);
 
    if (elapsed >= params.fps_sampling_period) {
@@ -274,6 +485,14 @@ void update_hud_info_with_frametime(struct swapchain_stats& sw_stats, const stru
       hw_update_thread->update(&params, vendorID);
 
       if (fpsmetrics) fpsmetrics->update_thread();
+      if (params.enabled[OVERLAY_PARAM_ENABLED_frame_pacing])
+         pacing_stats.publish();
+      blocking_stats.publish();
+      latency_stats.publish();
+      overhead_stats.publish();
+      if (params.enabled[OVERLAY_PARAM_ENABLED_pipeline_compiles])
+         compile_stats.publish();
+      if (recorder) recorder->update_median();
 #ifdef __linux__
       if (HUDElements.net) HUDElements.net->update();
 #endif
@@ -288,27 +507,26 @@ void update_hud_info_with_frametime(struct swapchain_stats& sw_stats, const stru
       }
 
       if (params.autostart_log && logger && !logger->autostart_init) {
-         if ((std::chrono::steady_clock::now() - HUDElements.overlay_start) > std::chrono::seconds(params.autostart_log)){
+         bool steady = !params.enabled[OVERLAY_PARAM_ENABLED_autostart_log_steady] ||
+                       (fpsmetrics && fpsmetrics->segment() == run_segment::steady);
+         if (steady && (std::chrono::steady_clock::now() - HUDElements.overlay_start) > std::chrono::seconds(params.autostart_log)){
             logger->start_logging();
             logger->autostart_init = true;
          }
       }
 
+      // Triggers that start the plan by themselves do it once
+      benchmark_plan* plan = bench_plan.load(std::memory_order_acquire);
+      if (plan && !plan->started()) {
+         if (params.benchmark_trigger == BENCHMARK_TRIGGER_STEADY &&
+             fpsmetrics && fpsmetrics->segment() == run_segment::steady)
+            plan->start();
+      }
+
       sw_stats.n_frames_since_update = 0;
       sw_stats.last_fps_update = now;
 
    }
-   auto min = std::min_element(frametime_data.begin(), frametime_data.end());
-   auto max = std::max_element(frametime_data.begin(), frametime_data.end());
-   min_frametime = min[0];
-   max_frametime = max[0];
-   // double min_time = UINT64_MAX, max_time = 0;
-   // for (auto& stat : sw_stats.frames_stats ){
-   //    min_time = MIN2(stat.stats[0], min_time);
-   //    max_time = MAX2(stat.stats[0], min_time);
-   // }
-   // min_frametime = min_time / sw_stats.time_dividor;
-   // max_frametime = max_time / sw_stats.time_dividor;
    if (params.log_interval == 0){
       logger->try_log();
    }
@@ -328,15 +546,7 @@ void update_hud_info(struct swapchain_stats& sw_stats, const struct overlay_para
 float get_time_stat(void *_data, int _idx)
 {
    struct swapchain_stats *data = (struct swapchain_stats *) _data;
-   if ((ARRAY_SIZE(data->frames_stats) - _idx) > data->n_frames)
-      return 0.0f;
-   int idx = ARRAY_SIZE(data->frames_stats) +
-      data->n_frames < ARRAY_SIZE(data->frames_stats) ?
-      _idx - data->n_frames :
-      _idx + data->n_frames;
-   idx %= ARRAY_SIZE(data->frames_stats);
-   /* Time stats are in us. */
-   return data->frames_stats[idx].stats[data->stat_selector] / data->time_dividor;
+   return data->frametimes[_idx];
 }
 
 void overlay_new_frame(const struct overlay_params& params)
@@ -548,7 +758,7 @@ void render_mpris_metadata(const struct overlay_params& params, mutexed_metadata
 
 static void render_benchmark(swapchain_stats& data, const struct overlay_params& params, const ImVec2& window_size, unsigned height, Clock::time_point now){
    // TODO, FIX LOG_DURATION FOR BENCHMARK
-   int benchHeight = (2 + benchmark.percentile_data.size()) * real_font_size.x + 10.0f + 58;
+   int benchHeight = (2 + benchmark.percentile_data.size() + !benchmark.history.empty()) * real_font_size.x + 10.0f + 58;
    ImGui::SetNextWindowSize(ImVec2(window_size.x, benchHeight), ImGuiCond_Always);
    if (height - (window_size.y + data.main_window_pos.y + 5) < benchHeight)
       ImGui::SetNextWindowPos(ImVec2(data.main_window_pos.x, data.main_window_pos.y - benchHeight - 5), ImGuiCond_Always);
@@ -602,6 +812,12 @@ static void render_benchmark(swapchain_stats& data, const struct overlay_params&
       ImGui::SetCursorPosX((ImGui::GetWindowSize().x / 2 )- (ImGui::CalcTextSize(buffer).x / 2));
       ImGui::TextColored(ImVec4(1.0, 1.0, 1.0, alpha / params.background_alpha), "%s %.1f", data_.first.c_str(), data_.second);
    }
+   if (!benchmark.history.empty()){
+      ImVec4 color = benchmark.regression ? ImVec4(1.0, 0.3, 0.3, alpha / params.background_alpha)
+                                          : ImVec4(1.0, 1.0, 1.0, alpha / params.background_alpha);
+      ImGui::SetCursorPosX((ImGui::GetWindowSize().x / 2 )- (ImGui::CalcTextSize(benchmark.history.c_str()).x / 2));
+      ImGui::TextColored(color, "%s", benchmark.history.c_str());
+   }
 
    float max = benchmark.fps_data.empty() ? 0.0f : *max_element(benchmark.fps_data.begin(), benchmark.fps_data.end());
    ImVec4 plotColor = HUDElements.colors.frametime;
@@ -676,6 +892,8 @@ void render_imgui(swapchain_stats& data, struct overlay_params& params, ImVec2&
    // data.engine = EngineTypes::GAMESCOPE;
    HUDElements.sw_stats = &data; HUDElements.params = &params;
    HUDElements.is_vulkan = is_vulkan;
+   update_metrics_view(HUDElements.current_metrics);
+   HUDElements.hw = hw_snapshots.acquire();
    ImGui::GetIO().FontGlobalScale = params.font_scale;
    static float ralign_width = 0, old_scale = 0;
    auto io = ImGui::GetIO();
@@ -14,19 +14,22 @@
 
 #include "dbus_info.h"
 #include "logging.h"
-
-struct frame_stat {
-   uint64_t stats[OVERLAY_PLOTS_MAX];
-};
+#include "frametime_history.h"
+#include "frame_pacing.h"
+#include "gpu_timing.h"
+#include "present_blocking.h"
+#include "present_latency.h"
+#include "overlay_cost.h"
+#include "pipeline_compiles.h"
+#include "frametime_distribution.h"
 
 static const int kMaxGraphEntries = 50;
 
 struct swapchain_stats {
    uint64_t n_frames;
-   enum overlay_plots stat_selector;
-   double time_dividor;
-   struct frame_stat stats_min, stats_max;
-   struct frame_stat frames_stats[200];
+   frametime_history<200> frametimes; /* ms */
+   frametime_history<200> compile_ms; /* ms creating pipelines, per frame of frametimes */
+   frametime_distribution distribution;
 
    ImFont* font1 = nullptr;
    ImFont* font_text = nullptr;
@@ -69,6 +72,8 @@ struct benchmark_stats {
    float total;
    std::vector<float> fps_data;
    std::vector<std::pair<std::string, float>> percentile_data;
+   std::string history;  // against the earlier runs, with log_history
+   bool regression;
 };
 
 struct LOAD_DATA {
@@ -85,13 +90,10 @@ extern uint32_t deviceID;
 extern struct benchmark_stats benchmark;
 extern ImVec2 real_font_size;
 extern std::string wineVersion;
-extern std::deque<logData> graph_data;
 extern overlay_params *_params;
-extern double min_frametime, max_frametime;
 extern bool steam_focused;
 extern int fan_speed;
 extern int current_preset;
-extern std::vector<float> frametime_data;
 
 void init_spdlog();
 void overlay_new_frame(const struct overlay_params& params);
@@ -101,6 +103,10 @@ void render_imgui(swapchain_stats& data, struct overlay_params& params, ImVec2&
 void update_hud_info(struct swapchain_stats& sw_stats, const struct overlay_params& params, uint32_t vendorID);
 void update_hud_info_with_frametime(struct swapchain_stats& sw_stats, const struct overlay_params& params, uint32_t vendorID, uint64_t frametime_ns);
 void update_hw_info(const struct overlay_params& params, uint32_t vendorID);
+void metrics_to_log_data(const mangohud_message& msg, logData& out);
+// Fills the hardware fields of out with the server samples around time_ns
+// (metrics_clock_ns()) interpolated, leaves it alone if there are none
+bool log_data_at(uint64_t time_ns, logData& out);
 void init_cpu_stats(overlay_params& params);
 void check_keybinds(overlay_params& params);
 void init_system_info(void);
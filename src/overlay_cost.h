@@ -0,0 +1,152 @@
+#pragma once
+#ifndef MANGOHUD_OVERLAY_COST_H
+#define MANGOHUD_OVERLAY_COST_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+enum cost_phase {
+    COST_UPDATE,        // stats, keybinds and the control socket
+    COST_BUILD,         // the ImGui frame, all the HUD elements
+    COST_DRAW,          // recording, uploading and submitting the draw
+    COST_COUNT
+};
+
+struct overlay_cost {
+    float cpu_ms[COST_COUNT] = {};
+    float gpu_ms = 0;
+
+    float cpu_total_ms() const {
+        float total = 0;
+        for (size_t i = 0; i < COST_COUNT; i++)
+            total += cpu_ms[i];
+        return total;
+    }
+};
+
+/*
+ * What drawing the HUD costs the app per frame: CPU time in the present path
+ * spent on our own work, and GPU time of the overlay's draw.
+ *
+ * add() and gpu() are lock-free, several swapchains may present on their own
+ * threads. The GPU time comes back a frame or more late, from whichever draw
+ * finished last; a frame without one keeps the previous value. end_frame()
+ * and publish() run on the present thread, the averages cover the frames of
+ * one sampling period.
+ */
+class overlay_cost_stats {
+public:
+    void add(cost_phase phase, uint64_t ns) { cpu[phase].fetch_add(ns, std::memory_order_relaxed); }
+
+    // A draw of ours that finished on the GPU
+    void gpu(uint64_t ns) {
+        gpu_ns.fetch_add(ns, std::memory_order_relaxed);
+        gpu_draws.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // After the present
+    void end_frame() {
+        overlay_cost f;
+        for (size_t i = 0; i < COST_COUNT; i++)
+            f.cpu_ms[i] = cpu[i].exchange(0, std::memory_order_relaxed) / 1e6f;
+        uint64_t draws = gpu_draws.exchange(0, std::memory_order_relaxed);
+        uint64_t ns = gpu_ns.exchange(0, std::memory_order_relaxed);
+        if (draws) {
+            gpu_last_ms = ns / 1e6f / draws;
+            period.gpu_ms += ns / 1e6f;
+            period_draws += draws;
+        }
+        f.gpu_ms = gpu_last_ms;
+
+        for (size_t i = 0; i < COST_COUNT; i++)
+            period.cpu_ms[i] += f.cpu_ms[i];
+        period_frames++;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        last = f;
+    }
+
+    // Once per sampling period
+    void publish() {
+        overlay_cost avg;
+        if (period_frames) {
+            for (size_t i = 0; i < COST_COUNT; i++)
+                avg.cpu_ms[i] = period.cpu_ms[i] / period_frames;
+        }
+        if (period_draws)
+            avg.gpu_ms = period.gpu_ms / period_draws;
+        bool timed = period_draws > 0;
+        period = overlay_cost();
+        period_frames = 0;
+        period_draws = 0;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        average = avg;
+        gpu_timed = timed;
+    }
+
+    overlay_cost last_frame() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return last;
+    }
+
+    // Per frame over the last sampling period
+    overlay_cost last_period() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return average;
+    }
+
+    // False when no draw was timed on the GPU in the last period
+    bool gpu_available() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return gpu_timed;
+    }
+
+private:
+    std::atomic<uint64_t> cpu[COST_COUNT] {};
+    std::atomic<uint64_t> gpu_ns {0};
+    std::atomic<uint64_t> gpu_draws {0};
+
+    // Only touched by the present thread
+    float gpu_last_ms = 0;
+    overlay_cost period;
+    uint64_t period_frames = 0;
+    uint64_t period_draws = 0;
+
+    mutable std::mutex mtx;
+    overlay_cost last, average;
+    bool gpu_timed = false;
+};
+
+extern overlay_cost_stats overhead_stats;
+
+// Adds the time until it goes out of scope to a phase
+class overlay_cost_scope {
+public:
+    overlay_cost_scope(overlay_cost_stats& stats, cost_phase phase)
+        : stats(stats), phase(phase), start(std::chrono::steady_clock::now()) {}
+
+    ~overlay_cost_scope() { end(); }
+
+    // Stops early, for phases that don't end with a block
+    void end() {
+        if (done)
+            return;
+        done = true;
+        stats.add(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    overlay_cost_scope(const overlay_cost_scope&) = delete;
+    overlay_cost_scope& operator=(const overlay_cost_scope&) = delete;
+
+private:
+    overlay_cost_stats& stats;
+    cost_phase phase;
+    std::chrono::steady_clock::time_point start;
+    bool done = false;
+};
+
+#endif //MANGOHUD_OVERLAY_COST_H
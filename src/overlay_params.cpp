@@ -40,7 +40,13 @@
 
 #include "app/mangoapp.h"
 #include "fps_metrics.h"
+#include "flight_recorder.h"
+#include "experiment.h"
+#include "benchmark_plan.h"
 #include "version.h"
+#ifdef __linux__
+#include "server_connection.hpp"
+#endif
 
 std::unique_ptr<fpsMetrics> fpsmetrics;
 std::mutex config_mtx;
@@ -235,6 +241,48 @@ parse_fps_limit_method(const char *str)
    return FPS_LIMIT_METHOD_LATE;
 }
 
+static std::vector<enum fps_limit_method>
+parse_experiment_fps_limit_method(const char *str)
+{
+   std::vector<enum fps_limit_method> methods;
+   for (auto& value : str_tokenize(str)) {
+      trim(value);
+      methods.push_back(parse_fps_limit_method(value.c_str()));
+   }
+   return methods;
+}
+
+static std::vector<int>
+parse_experiment_gl_vsync(const char *str)
+{
+   std::vector<int> intervals;
+   for (auto& value : str_tokenize(str)) {
+      trim(value);
+      try {
+         intervals.push_back(std::stoi(value));
+      } catch (const std::exception&) {
+         SPDLOG_ERROR("invalid experiment_gl_vsync value: '{}'", value);
+      }
+   }
+   return intervals;
+}
+
+static enum benchmark_trigger
+parse_benchmark_trigger(const char *str)
+{
+   if (!strcmp(str, "control"))
+      return BENCHMARK_TRIGGER_CONTROL;
+   if (!strcmp(str, "steady"))
+      return BENCHMARK_TRIGGER_STEADY;
+   if (!strcmp(str, "process"))
+      return BENCHMARK_TRIGGER_PROCESS;
+   if (!strcmp(str, "window"))
+      return BENCHMARK_TRIGGER_WINDOW;
+   if (strcmp(str, "keybind"))
+      SPDLOG_ERROR("Unknown benchmark_trigger '{}', using keybind", str);
+   return BENCHMARK_TRIGGER_KEYBIND;
+}
+
 static bool
 parse_no_display(const char *str)
 {
@@ -536,6 +584,23 @@ parse_ftrace(const char *str) {
 #define parse_cpu_text(s) parse_str(s)
 #define parse_fps_text(s) parse_str(s)
 #define parse_log_interval(s) parse_unsigned(s)
+#define parse_log_sample_rate(s) parse_unsigned(s)
+#define parse_log_history_runs(s) parse_unsigned(s)
+#define parse_fps_metrics_window(s) parse_unsigned(s)
+#define parse_frame_pacing_threshold(s) parse_unsigned(s)
+#define parse_frametime_distribution_window(s) parse_unsigned(s)
+#define parse_flight_recorder_threshold(s) parse_float(s)
+#define parse_flight_recorder_multiple(s) parse_float(s)
+#define parse_flight_recorder_seconds(s) parse_unsigned(s)
+#define parse_experiment_fps_limit(s) parse_fps_limit(s)
+#define parse_experiment_interval(s) parse_unsigned(s)
+#define parse_benchmark_runs(s) parse_unsigned(s)
+#define parse_benchmark_warmup(s) parse_float(s)
+#define parse_benchmark_duration(s) parse_float(s)
+#define parse_benchmark_cooldown(s) parse_float(s)
+#define parse_benchmark_fps_limit(s) parse_fps_limit(s)
+#define parse_benchmark_process(s) parse_str(s)
+#define parse_benchmark_window(s) parse_str(s)
 #define parse_font_size(s) parse_float(s)
 #define parse_font_size_text(s) parse_float(s)
 #define parse_font_scale(s) parse_float(s)
@@ -849,6 +914,20 @@ static void set_param_defaults(struct overlay_params *params){
    params->cpu_load_color = { 0x39f900, 0xfdfd09, 0xb22222 };
    params->font_scale_media_player = 0.55f;
    params->log_interval = 0;
+   params->log_sample_rate = 0;
+   params->log_history_runs = 10;
+   params->fps_metrics_window = 0;
+   params->frame_pacing_threshold = 20;
+   params->frametime_distribution_window = 0;
+   params->flight_recorder_threshold = 0;
+   params->flight_recorder_multiple = 3;
+   params->flight_recorder_seconds = 5;
+   params->experiment_interval = 10;
+   params->benchmark_runs = 0;
+   params->benchmark_warmup = 0;
+   params->benchmark_duration = 60;
+   params->benchmark_cooldown = 0;
+   params->benchmark_trigger = BENCHMARK_TRIGGER_KEYBIND;
    params->media_player_format = { "{title}", "{artist}", "{album}" };
    params->permit_upload = 0;
    params->benchmark_percentiles = { "97", "AVG"};
@@ -891,6 +970,47 @@ static std::string verify_pci_dev(std::string pci_dev) {
    return ss.str();
 }
 
+// Every combination of the experiment_* lists, the first value of each
+// first. Settings without a list stay as configured.
+static std::vector<experiment_variant>
+experiment_variants(const struct overlay_params& params)
+{
+   std::vector<experiment_variant> variants(1);
+
+   auto vary = [&](size_t count, const std::function<void(experiment_variant&, size_t)>& set) {
+      if (!count)
+         return;
+      std::vector<experiment_variant> product;
+      for (auto& variant : variants) {
+         for (size_t i = 0; i < count; i++) {
+            product.push_back(variant);
+            set(product.back(), i);
+         }
+      }
+      variants.swap(product);
+   };
+
+   auto append_name = [](experiment_variant& v, const std::string& setting) {
+      v.name += (v.name.empty() ? "" : " ") + setting;
+   };
+
+   vary(params.experiment_fps_limit.size(), [&](experiment_variant& v, size_t i) {
+      v.fps_limit = params.experiment_fps_limit[i];
+      append_name(v, "fps_limit=" + std::to_string(v.fps_limit));
+   });
+   vary(params.experiment_fps_limit_method.size(), [&](experiment_variant& v, size_t i) {
+      v.fps_limit_method = params.experiment_fps_limit_method[i];
+      append_name(v, std::string("fps_limit_method=") +
+                  (v.fps_limit_method == FPS_LIMIT_METHOD_EARLY ? "early" : "late"));
+   });
+   vary(params.experiment_gl_vsync.size(), [&](experiment_variant& v, size_t i) {
+      v.gl_vsync = params.experiment_gl_vsync[i];
+      append_name(v, "gl_vsync=" + std::to_string(v.gl_vsync));
+   });
+
+   return variants;
+}
+
 void
 parse_overlay_config(struct overlay_params *params,
                   const char *env, bool use_existing_preset)
@@ -1069,6 +1189,75 @@ parse_overlay_config(struct overlay_params *params,
 
    fps_limit_stats.method = params->fps_limit_method;
 
+   if (fpsmetrics)
+      fpsmetrics->set_window(params->fps_metrics_window);
+
+   pacing_stats.set_threshold(params->frame_pacing_threshold);
+
+   // Segments are found on the fps metrics thread, start it even without
+   // any fps_metrics to show
+   bool detect_steady = params->enabled[OVERLAY_PARAM_ENABLED_steady_state] ||
+                        params->enabled[OVERLAY_PARAM_ENABLED_autostart_log_steady] ||
+                        (params->benchmark_runs && params->benchmark_trigger == BENCHMARK_TRIGGER_STEADY);
+   if (detect_steady && !fpsmetrics)
+      fpsmetrics = std::make_unique<fpsMetrics>(std::vector<std::string>{});
+   if (fpsmetrics)
+      fpsmetrics->set_steady_state(detect_steady);
+
+   if (params->enabled[OVERLAY_PARAM_ENABLED_flight_recorder]) {
+      if (!recorder)
+         recorder = std::make_unique<flight_recorder>();
+
+      flight_recorder::options opts {};
+      opts.threshold_ms = params->flight_recorder_threshold;
+      opts.median_multiple = params->flight_recorder_multiple;
+      opts.seconds = params->flight_recorder_seconds;
+      opts.output_folder = params->output_folder;
+      if (opts.output_folder.empty() && getenv("HOME"))
+         opts.output_folder = getenv("HOME");
+#ifdef HAVE_FTRACE
+      for (auto& tp : params->ftrace.tracepoints)
+         opts.trace_names.push_back(tp->name);
+#endif
+      recorder->configure(opts);
+   }
+
+   // Only a changed plan is replaced, and like the experiment below the
+   // old one is leaked rather than freed under its readers
+   benchmark_plan* old_plan = bench_plan.load(std::memory_order_acquire);
+   if (params->benchmark_runs) {
+      benchmark_plan::options opts;
+      opts.warmup_s = params->benchmark_warmup;
+      opts.duration_s = params->benchmark_duration;
+      opts.cooldown_s = params->benchmark_cooldown;
+      opts.runs = params->benchmark_runs;
+      opts.fps_limits = params->benchmark_fps_limit;
+      if (!old_plan || old_plan->settings() != opts)
+         bench_plan.store(new benchmark_plan(opts), std::memory_order_release);
+   } else if (old_plan) {
+      bench_plan.store(nullptr, std::memory_order_release);
+   }
+
+   // The present thread may be inside the old experiment, so it's only
+   // swapped out and never deleted, like fpsmetrics in parse_fps_metrics()
+   std::vector<experiment_variant> variants = experiment_variants(*params);
+   ab_experiment* old_experiment = experiment.load(std::memory_order_acquire);
+   if (variants.size() > 1) {
+      // Reloading the same experiment starts it over rather than leaking it
+      bool same = old_experiment && old_experiment->num_variants() == variants.size() &&
+                  old_experiment->interval() == params->experiment_interval * 1000;
+      for (size_t i = 0; same && i < variants.size(); i++)
+         same = old_experiment->variant(i).name == variants[i].name;
+
+      if (same)
+         old_experiment->restart();
+      else
+         experiment.store(new ab_experiment(variants, params->experiment_interval * 1000, 1000),
+                          std::memory_order_release);
+   } else if (old_experiment) {
+      experiment.store(nullptr, std::memory_order_release);
+   }
+
 #ifdef HAVE_DBUS
    if (params->enabled[OVERLAY_PARAM_ENABLED_media_player]) {
       if (dbusmgr::dbus_mgr.init(dbusmgr::SRV_MPRIS))
@@ -1134,6 +1323,11 @@ parse_overlay_config(struct overlay_params *params,
    if (HUDElements.net)
       HUDElements.net->should_reset = true;
 
+#ifdef __linux__
+   update_graph_fields();
+   refresh_server_subscription();
+#endif
+
    if (!params->gpu_list.empty() && !params->pci_dev.empty()) {
       SPDLOG_WARN(
          "You have specified both gpu_list and pci_dev, "
@@ -79,6 +79,15 @@ struct Tracepoint;
    OVERLAY_PARAM_BOOL(cpu_mhz)                       \
    OVERLAY_PARAM_BOOL(frametime)                     \
    OVERLAY_PARAM_BOOL(frame_count)                   \
+   OVERLAY_PARAM_BOOL(sample_age)                    \
+   OVERLAY_PARAM_BOOL(frame_pacing)                  \
+   OVERLAY_PARAM_BOOL(gpu_frametime)                 \
+   OVERLAY_PARAM_BOOL(present_blocking)              \
+   OVERLAY_PARAM_BOOL(present_latency)               \
+   OVERLAY_PARAM_BOOL(mangohud_overhead)             \
+   OVERLAY_PARAM_BOOL(pipeline_compiles)             \
+   OVERLAY_PARAM_BOOL(frametime_distribution)        \
+   OVERLAY_PARAM_BOOL(flight_recorder)               \
    OVERLAY_PARAM_BOOL(resolution)                    \
    OVERLAY_PARAM_BOOL(show_fps_limit)                \
    OVERLAY_PARAM_BOOL(fps_color_change)              \
@@ -100,6 +109,10 @@ struct Tracepoint;
    OVERLAY_PARAM_BOOL(throttling_status_graph)       \
    OVERLAY_PARAM_BOOL(fcat)                          \
    OVERLAY_PARAM_BOOL(log_versioning)                \
+   OVERLAY_PARAM_BOOL(log_json)                      \
+   OVERLAY_PARAM_BOOL(log_history)                   \
+   OVERLAY_PARAM_BOOL(steady_state)                  \
+   OVERLAY_PARAM_BOOL(autostart_log_steady)          \
    OVERLAY_PARAM_BOOL(horizontal)                    \
    OVERLAY_PARAM_BOOL(horizontal_stretch)            \
    OVERLAY_PARAM_BOOL(hud_no_margin)                 \
@@ -188,8 +201,18 @@ struct Tracepoint;
    OVERLAY_PARAM_CUSTOM(cpu_text)                    \
    OVERLAY_PARAM_CUSTOM(gpu_text)                    \
    OVERLAY_PARAM_CUSTOM(log_interval)                \
+   OVERLAY_PARAM_CUSTOM(log_sample_rate)             \
+   OVERLAY_PARAM_CUSTOM(log_history_runs)            \
    OVERLAY_PARAM_CUSTOM(permit_upload)               \
    OVERLAY_PARAM_CUSTOM(benchmark_percentiles)       \
+   OVERLAY_PARAM_CUSTOM(benchmark_runs)              \
+   OVERLAY_PARAM_CUSTOM(benchmark_warmup)            \
+   OVERLAY_PARAM_CUSTOM(benchmark_duration)          \
+   OVERLAY_PARAM_CUSTOM(benchmark_cooldown)          \
+   OVERLAY_PARAM_CUSTOM(benchmark_fps_limit)         \
+   OVERLAY_PARAM_CUSTOM(benchmark_trigger)           \
+   OVERLAY_PARAM_CUSTOM(benchmark_process)           \
+   OVERLAY_PARAM_CUSTOM(benchmark_window)            \
    OVERLAY_PARAM_CUSTOM(help)                        \
    OVERLAY_PARAM_CUSTOM(gpu_load_value)              \
    OVERLAY_PARAM_CUSTOM(cpu_load_value)              \
@@ -212,6 +235,16 @@ struct Tracepoint;
    OVERLAY_PARAM_CUSTOM(fps_text)                    \
    OVERLAY_PARAM_CUSTOM(device_battery)              \
    OVERLAY_PARAM_CUSTOM(fps_metrics)                 \
+   OVERLAY_PARAM_CUSTOM(fps_metrics_window)          \
+   OVERLAY_PARAM_CUSTOM(frame_pacing_threshold)      \
+   OVERLAY_PARAM_CUSTOM(frametime_distribution_window) \
+   OVERLAY_PARAM_CUSTOM(flight_recorder_threshold)   \
+   OVERLAY_PARAM_CUSTOM(flight_recorder_multiple)    \
+   OVERLAY_PARAM_CUSTOM(flight_recorder_seconds)     \
+   OVERLAY_PARAM_CUSTOM(experiment_fps_limit)        \
+   OVERLAY_PARAM_CUSTOM(experiment_fps_limit_method) \
+   OVERLAY_PARAM_CUSTOM(experiment_gl_vsync)         \
+   OVERLAY_PARAM_CUSTOM(experiment_interval)         \
    OVERLAY_PARAM_CUSTOM(network)                     \
    OVERLAY_PARAM_CUSTOM(gpu_list)                    \
    OVERLAY_PARAM_CUSTOM(fex_stats)                   \
@@ -258,6 +291,14 @@ enum fps_limit_method {
    FPS_LIMIT_METHOD_LATE
 };
 
+enum benchmark_trigger {
+   BENCHMARK_TRIGGER_KEYBIND,   // toggle_logging starts and aborts the plan
+   BENCHMARK_TRIGGER_CONTROL,   // the "benchmark" control socket command
+   BENCHMARK_TRIGGER_STEADY,    // the first steady state
+   BENCHMARK_TRIGGER_PROCESS,   // a process named benchmark_process running
+   BENCHMARK_TRIGGER_WINDOW,    // an X11 window titled with benchmark_window
+};
+
 enum overlay_param_enabled {
 #define OVERLAY_PARAM_BOOL(name) OVERLAY_PARAM_ENABLED_##name,
 #define OVERLAY_PARAM_CUSTOM(name)
@@ -298,6 +339,8 @@ struct overlay_params {
    enum gl_size_query gl_size_query {GL_SIZE_DRAWABLE};
    bool gl_dont_flip {false};
    int64_t log_duration, log_interval;
+   unsigned log_sample_rate; /* Hz, 0 keeps the normal rate */
+   unsigned log_history_runs;
    unsigned cpu_color, gpu_color, vram_color, ram_color,
             engine_color, io_color, frametime_color, background_color,
             text_color, wine_color, battery_color, network_color,
@@ -333,6 +376,12 @@ struct overlay_params {
    unsigned autostart_log;
    std::vector<std::string> media_player_format;
    std::vector<std::string> benchmark_percentiles;
+   unsigned benchmark_runs; /* 0 for no benchmark plan */
+   float benchmark_warmup, benchmark_duration, benchmark_cooldown; /* s */
+   std::vector<std::uint32_t> benchmark_fps_limit;
+   enum benchmark_trigger benchmark_trigger;
+   std::string benchmark_process;
+   std::string benchmark_window;
    std::vector<std::string> gpu_text;
    std::string font_file, font_file_text;
    uint32_t font_glyph_ranges;
@@ -352,6 +401,16 @@ struct overlay_params {
    float text_outline_thickness;
    std::vector<std::string> device_battery;
    std::vector<std::string> fps_metrics;
+   unsigned fps_metrics_window; /* s, 0 for the whole session */
+   unsigned frame_pacing_threshold; /* % off the target frametime */
+   unsigned frametime_distribution_window; /* s, 0 for the whole session */
+   float flight_recorder_threshold; /* ms, 0 to only use the median */
+   float flight_recorder_multiple; /* of the median frametime, 0 to only use the threshold */
+   unsigned flight_recorder_seconds; /* kept before and recorded after a spike */
+   std::vector<std::uint32_t> experiment_fps_limit;
+   std::vector<enum fps_limit_method> experiment_fps_limit_method;
+   std::vector<int> experiment_gl_vsync;
+   unsigned experiment_interval; /* s per variant */
    std::vector<std::string> network;
    std::vector<unsigned> gpu_list;
    int transfer_function;
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef MANGOHUD_PIPELINE_COMPILES_H
+#define MANGOHUD_PIPELINE_COMPILES_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+struct compile_frame {
+    float ms = 0;                   // creating pipelines and shader modules, summed over threads
+    uint32_t pipelines = 0;         // created
+    uint32_t shaders = 0;           // shader modules created
+    uint32_t cache_hits = 0;        // of the pipelines with creation feedback
+    uint32_t cache_misses = 0;
+};
+
+/*
+ * Pipeline and shader module creation in the app, the usual cause of
+ * hitches the first time something is drawn. The layer times the calls and,
+ * with VK_EXT_pipeline_creation_feedback, learns whether the pipeline cache
+ * had each pipeline.
+ *
+ * add_*() are lock-free, apps compile on many threads. end_frame() runs on
+ * the present thread with the frame's frametime, publish() once per sampling
+ * period. The period holds totals and not averages, compiles come in bursts.
+ */
+class pipeline_compile_stats {
+public:
+    void add_pipelines(uint64_t ns, uint32_t created, uint32_t hits, uint32_t misses) {
+        compile_ns.fetch_add(ns, std::memory_order_relaxed);
+        pipelines.fetch_add(created, std::memory_order_relaxed);
+        cache_hits.fetch_add(hits, std::memory_order_relaxed);
+        cache_misses.fetch_add(misses, std::memory_order_relaxed);
+        if (hits || misses)
+            with_feedback.store(true, std::memory_order_relaxed);
+    }
+
+    void add_shaders(uint64_t ns, uint32_t created) {
+        compile_ns.fetch_add(ns, std::memory_order_relaxed);
+        shaders.fetch_add(created, std::memory_order_relaxed);
+    }
+
+    compile_frame end_frame() {
+        compile_frame f;
+        f.ms = compile_ns.exchange(0, std::memory_order_relaxed) / 1e6f;
+        f.pipelines = pipelines.exchange(0, std::memory_order_relaxed);
+        f.shaders = shaders.exchange(0, std::memory_order_relaxed);
+        f.cache_hits = cache_hits.exchange(0, std::memory_order_relaxed);
+        f.cache_misses = cache_misses.exchange(0, std::memory_order_relaxed);
+
+        period.ms += f.ms;
+        period.pipelines += f.pipelines;
+        period.shaders += f.shaders;
+        period.cache_hits += f.cache_hits;
+        period.cache_misses += f.cache_misses;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        last = f;
+        return f;
+    }
+
+    // Once per sampling period
+    void publish() {
+        compile_frame totals = period;
+        period = compile_frame();
+
+        std::lock_guard<std::mutex> lock(mtx);
+        recent = totals;
+    }
+
+    compile_frame last_frame() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return last;
+    }
+
+    // Totals of the last sampling period
+    compile_frame last_period() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return recent;
+    }
+
+    // Cache hits and misses are only known with creation feedback
+    bool feedback() const { return with_feedback.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> compile_ns {0};
+    std::atomic<uint32_t> pipelines {0};
+    std::atomic<uint32_t> shaders {0};
+    std::atomic<uint32_t> cache_hits {0};
+    std::atomic<uint32_t> cache_misses {0};
+    std::atomic<bool> with_feedback {false};
+
+    // Only touched by the present thread
+    compile_frame period;
+
+    mutable std::mutex mtx;
+    compile_frame last, recent;
+};
+
+extern pipeline_compile_stats compile_stats;
+
+#endif //MANGOHUD_PIPELINE_COMPILES_H
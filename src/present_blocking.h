@@ -0,0 +1,109 @@
+#pragma once
+#ifndef MANGOHUD_PRESENT_BLOCKING_H
+#define MANGOHUD_PRESENT_BLOCKING_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+enum block_kind {
+    BLOCK_PRESENT,      // in vkQueuePresentKHR, with the layers below us
+    BLOCK_ACQUIRE,      // in vkAcquireNextImageKHR
+    BLOCK_FENCE,        // in vkWaitForFences
+    BLOCK_LIMITER,      // sleeping in the fps limiter
+    BLOCK_COUNT
+};
+
+struct frame_blocking {
+    float ms[BLOCK_COUNT] = {};
+    float frame_ms = 0;
+
+    // Share of the frame the app spent waiting on the driver, the limiter's
+    // sleep is its own choice
+    float blocked_percent() const {
+        float driver = ms[BLOCK_PRESENT] + ms[BLOCK_ACQUIRE] + ms[BLOCK_FENCE];
+        return frame_ms > 0 ? 100.f * driver / frame_ms : 0.f;
+    }
+};
+
+/*
+ * Where the CPU side of a frame waits: the layer times the calls that block
+ * and adds them to the frame being recorded, a frame ends after its present.
+ * Waiting long in present or acquire while the GPU isn't busy the whole
+ * frame means the swapchain's queue of images is full, more GPU wouldn't
+ * help.
+ *
+ * add() is lock-free and may come from any thread, fences are often waited
+ * on by other threads than the one presenting. end_frame() and publish() run
+ * on the present thread, the averages cover the frames of one sampling
+ * period.
+ */
+class present_blocking_stats {
+public:
+    void add(block_kind kind, uint64_t ns) { blocked[kind].fetch_add(ns, std::memory_order_relaxed); }
+
+    // After the present, now_ns on the same clock every frame
+    void end_frame(uint64_t now_ns) {
+        frame_blocking f;
+        for (size_t i = 0; i < BLOCK_COUNT; i++)
+            f.ms[i] = blocked[i].exchange(0, std::memory_order_relaxed) / 1e6f;
+        f.frame_ms = last_end_ns ? (now_ns - last_end_ns) / 1e6f : 0.f;
+        last_end_ns = now_ns;
+
+        if (f.frame_ms > 0) {
+            for (size_t i = 0; i < BLOCK_COUNT; i++)
+                period.ms[i] += f.ms[i];
+            period.frame_ms += f.frame_ms;
+            period_frames++;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        last = f;
+    }
+
+    // Once per sampling period
+    void publish() {
+        frame_blocking avg;
+        if (period_frames) {
+            for (size_t i = 0; i < BLOCK_COUNT; i++)
+                avg.ms[i] = period.ms[i] / period_frames;
+            avg.frame_ms = period.frame_ms / period_frames;
+        }
+        period = frame_blocking();
+        period_frames = 0;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        average = avg;
+    }
+
+    frame_blocking last_frame() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return last;
+    }
+
+    // Per frame over the last sampling period
+    frame_blocking last_period() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return average;
+    }
+
+    // The swapchain last created, 0 images before one was
+    void set_swapchain(uint32_t images) { swapchain_images.store(images, std::memory_order_relaxed); }
+    uint32_t images() const { return swapchain_images.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> blocked[BLOCK_COUNT] {};
+    std::atomic<uint32_t> swapchain_images {0};
+
+    // Only touched by the present thread
+    uint64_t last_end_ns = 0;
+    frame_blocking period;
+    uint64_t period_frames = 0;
+
+    mutable std::mutex mtx;
+    frame_blocking last, average;
+};
+
+extern present_blocking_stats blocking_stats;
+
+#endif //MANGOHUD_PRESENT_BLOCKING_H
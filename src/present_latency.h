@@ -0,0 +1,126 @@
+#pragma once
+#ifndef MANGOHUD_PRESENT_LATENCY_H
+#define MANGOHUD_PRESENT_LATENCY_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+
+struct display_timing {
+    float latency_ms = 0;       // from the present call to the image on screen
+    float interval_ms = 0;      // between images reaching the screen
+    uint64_t frames = 0;        // displayed, of the period for averages
+};
+
+/*
+ * When frames reach the display, from present ids waited on by the layer
+ * (VK_KHR_present_wait).
+ *
+ * The present thread tags presents with ids that only grow per swapchain,
+ * waiter threads report when an id was displayed. A wait on an id returns
+ * once it or a later one was shown, so presents that never made it to the
+ * screen (replaced in mailbox) are dropped with the first later one that did.
+ * Intervals are between displayed frames of the same swapchain.
+ *
+ * Everything locks, it's once per frame on a couple of threads.
+ */
+class present_latency_stats {
+public:
+    static constexpr size_t max_pending = 64;
+
+    void presented(uintptr_t swapchain, uint64_t id, uint64_t now_ns) {
+        std::lock_guard<std::mutex> lock(mtx);
+        waiting = true;
+        pending.push_back({ swapchain, id, now_ns });
+        // Waits that never come back, a lost surface
+        if (pending.size() > max_pending)
+            pending.pop_front();
+    }
+
+    void displayed(uintptr_t swapchain, uint64_t id, uint64_t now_ns) {
+        std::lock_guard<std::mutex> lock(mtx);
+        uint64_t present_ns = 0;
+        bool found = false;
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (it->swapchain == swapchain && it->id <= id) {
+                present_ns = it->present_ns;
+                found = true;
+                it = pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (!found)
+            return;
+
+        display_timing f;
+        f.latency_ms = (now_ns - present_ns) / 1e6f;
+        uint64_t& previous = last_display_ns[swapchain];
+        f.interval_ms = previous ? (now_ns - previous) / 1e6f : 0.f;
+        previous = now_ns;
+        f.frames = 1;
+
+        last = f;
+        period.latency_ms += f.latency_ms;
+        period.interval_ms += f.interval_ms;
+        period.frames++;
+        if (f.interval_ms > 0)
+            intervals++;
+    }
+
+    // Presents of swapchain that will never be waited on, it's gone
+    void forget(uintptr_t swapchain) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto it = pending.begin(); it != pending.end();)
+            it = it->swapchain == swapchain ? pending.erase(it) : it + 1;
+        last_display_ns.erase(swapchain);
+    }
+
+    // Once per sampling period
+    void publish() {
+        std::lock_guard<std::mutex> lock(mtx);
+        average = display_timing();
+        average.frames = period.frames;
+        if (period.frames)
+            average.latency_ms = period.latency_ms / period.frames;
+        if (intervals)
+            average.interval_ms = period.interval_ms / intervals;
+        period = display_timing();
+        intervals = 0;
+    }
+
+    display_timing last_frame() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return last;
+    }
+
+    display_timing last_period() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return average;
+    }
+
+    // False until a present was tagged, without present_wait it stays so
+    bool available() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return waiting;
+    }
+
+private:
+    struct tagged_present {
+        uintptr_t swapchain;
+        uint64_t id;
+        uint64_t present_ns;
+    };
+
+    mutable std::mutex mtx;
+    bool waiting = false;
+    std::deque<tagged_present> pending;     // oldest first
+    std::map<uintptr_t, uint64_t> last_display_ns;
+    display_timing last, period, average;
+    uint64_t intervals = 0;
+};
+
+extern present_latency_stats latency_stats;
+
+#endif //MANGOHUD_PRESENT_LATENCY_H
@@ -0,0 +1,186 @@
+#pragma once
+#ifndef MANGOHUD_RUN_HISTORY_H
+#define MANGOHUD_RUN_HISTORY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct run_record {
+    int64_t time;                // unix time the log ended
+    double duration_s;
+    uint64_t frames;
+    float avg_fps;
+    float low_1;                 // 1% and 0.1% min fps
+    float low_01;
+    std::string kernel;          // what may have changed between runs
+    std::string driver;
+    std::string mangohud;
+};
+
+struct run_comparison {
+    unsigned runs;               // earlier runs compared against, 0 if too few
+    double median_fps;
+    double change;               // % avg fps against their median
+    double median_low_1;
+    double low_1_change;         // % 1% min fps against their median
+    bool regression;             // avg or 1% min fps significantly lower
+};
+
+/*
+ * The runs of one program with one config on one GPU, one line each in a
+ * csv index, oldest first.
+ *
+ * A run is compared with the median of the last runs before it. Their
+ * spread is the median absolute deviation, scaled to a standard deviation,
+ * so one odd run doesn't hide a slowdown or make one up. A run is a
+ * regression when its average or 1% min fps is more than three of those
+ * below the median. The spread is taken as at least 1% of the median,
+ * runs identical to the frame would flag any change otherwise, and it
+ * takes min_runs earlier runs to say anything at all.
+ */
+class run_history {
+public:
+    static constexpr unsigned min_runs = 3;
+    static constexpr double z_limit = 3;
+
+    // Adds a line of the index, false if it isn't a run (the header)
+    bool add_line(const std::string& line) {
+        run_record r;
+        if (!parse(line, r))
+            return false;
+        records.push_back(r);
+        return true;
+    }
+
+    void add(const run_record& r) { records.push_back(r); }
+    const std::vector<run_record>& runs() const { return records; }
+
+    // run against the last_n runs recorded so far
+    run_comparison compare(const run_record& run, size_t last_n) const {
+        run_comparison c {};
+        size_t n = std::min(last_n, records.size());
+        if (n < min_runs)
+            return c;
+
+        std::vector<double> fps, low_1;
+        for (size_t i = records.size() - n; i < records.size(); i++) {
+            fps.push_back(records[i].avg_fps);
+            low_1.push_back(records[i].low_1);
+        }
+
+        c.runs = n;
+        double z_fps, z_low_1;
+        c.median_fps = median_z(fps, run.avg_fps, z_fps);
+        c.median_low_1 = median_z(low_1, run.low_1, z_low_1);
+        c.change = c.median_fps > 0 ? 100.0 * (run.avg_fps - c.median_fps) / c.median_fps : 0.0;
+        c.low_1_change = c.median_low_1 > 0 ? 100.0 * (run.low_1 - c.median_low_1) / c.median_low_1 : 0.0;
+        c.regression = z_fps < -z_limit || z_low_1 < -z_limit;
+        return c;
+    }
+
+    static std::string header() {
+        return "time,duration,frames,avg_fps,low_1,low_01,kernel,driver,mangohud";
+    }
+
+    static std::string line(const run_record& r) {
+        return std::to_string(r.time) + "," + fixed(r.duration_s) + "," + std::to_string(r.frames) + "," +
+               fixed(r.avg_fps) + "," + fixed(r.low_1) + "," + fixed(r.low_01) + "," +
+               field(r.kernel) + "," + field(r.driver) + "," + field(r.mangohud);
+    }
+
+private:
+    static bool parse(const std::string& line, run_record& r) {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        for (size_t comma; (comma = line.find(',', start)) != std::string::npos; start = comma + 1)
+            fields.push_back(line.substr(start, comma - start));
+        fields.push_back(line.substr(start));
+        if (fields.size() < 6)
+            return false;
+
+        double numbers[6];
+        for (size_t i = 0; i < 6; i++) {
+            if (!number(fields[i], numbers[i]))
+                return false;
+        }
+        r.time = numbers[0];
+        r.duration_s = numbers[1];
+        r.frames = numbers[2];
+        r.avg_fps = numbers[3];
+        r.low_1 = numbers[4];
+        r.low_01 = numbers[5];
+
+        r.kernel = fields.size() > 6 ? fields[6] : "";
+        r.driver = fields.size() > 7 ? fields[7] : "";
+        r.mangohud = fields.size() > 8 ? fields[8] : "";
+        return true;
+    }
+
+    // Two decimals with a point whatever the locale, the game may have set one
+    // with a decimal comma
+    static std::string fixed(double v) {
+        long long hundredths = std::llround(std::abs(v) * 100);
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%s%lld.%02lld", v < 0 ? "-" : "", hundredths / 100, hundredths % 100);
+        return buf;
+    }
+
+    static bool number(const std::string& s, double& v) {
+        size_t i = s.size() && s[0] == '-' ? 1 : 0;
+        bool negative = i == 1, digits = false;
+        double scale = 0;
+        v = 0;
+        for (; i < s.size(); i++) {
+            if (s[i] == '.' && scale == 0) {
+                scale = 1;
+            } else if (s[i] >= '0' && s[i] <= '9') {
+                digits = true;
+                if (scale > 0)
+                    v += (s[i] - '0') * (scale /= 10);
+                else
+                    v = v * 10 + (s[i] - '0');
+            } else {
+                return false;
+            }
+        }
+        if (negative)
+            v = -v;
+        return digits;
+    }
+
+    // Commas and line breaks would shift the columns
+    static std::string field(std::string s) {
+        std::replace(s.begin(), s.end(), ',', ' ');
+        std::replace(s.begin(), s.end(), '\n', ' ');
+        std::replace(s.begin(), s.end(), '\r', ' ');
+        return s;
+    }
+
+    static double median(std::vector<double> v) {
+        size_t mid = v.size() / 2;
+        std::nth_element(v.begin(), v.begin() + mid, v.end());
+        double m = v[mid];
+        if (v.size() % 2 == 0)
+            m = (m + *std::max_element(v.begin(), v.begin() + mid)) / 2;
+        return m;
+    }
+
+    // Median of the earlier values, and how many of their deviations value is off it
+    static double median_z(const std::vector<double>& earlier, double value, double& z) {
+        double m = median(earlier);
+        std::vector<double> deviations;
+        for (double v : earlier)
+            deviations.push_back(std::abs(v - m));
+        double sigma = std::max(1.4826 * median(deviations), 0.01 * m);
+        z = sigma > 0 ? (value - m) / sigma : 0.0;
+        return m;
+    }
+
+    std::vector<run_record> records;
+};
+
+#endif //MANGOHUD_RUN_HISTORY_H
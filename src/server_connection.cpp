@@ -1,22 +1,294 @@
+#include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <thread>
 #include <sstream>
 #include <cctype>
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <vector>
 #include <spdlog/spdlog.h>
 
 #include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/un.h>
-#include <poll.h>
 #include <unistd.h>
 
 #include "../../mangohud-server/common/socket.hpp"
 #include "server_connection.hpp"
+#include "server_protocol.hpp"
+#include "metrics_delta.h"
+#ifndef TEST_ONLY
 #include "hud_elements.h"
+#include "overlay.h"
+#else
+#include "../tests/server_connection_test.hpp"
+#endif
+
+// Ring the connection thread receives samples into when the server can't
+// share memory with us, laid out the same way as the shared one so readers
+// don't care where the data comes from. It also keeps the recent history
+// the logger interpolates in, about a third of a second at 100 Hz.
+static struct {
+    mangohud_shm_ring ring;
+    mangohud_shm_slot slots[32];
+} local_ring;
+
+static const mangohud_message empty_metrics = {};
+static std::atomic<const mangohud_shm_ring*> active_ring {nullptr};
+
+struct shm_mapping {
+    void* addr;
+    size_t size;
+    std::chrono::steady_clock::time_point retired;
+};
+
+// Readers may still hold views into a ring the server went away from, so
+// it is only unmapped once nobody can be in the middle of a frame with it.
+static shm_mapping current_mapping {};
+static std::vector<shm_mapping> retired_mappings;
+
+static const mangohud_shm_slot* slot_at(const mangohud_shm_ring* ring, uint64_t idx) {
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(ring) + ring->slots_offset;
+    return reinterpret_cast<const mangohud_shm_slot*>(base + (idx % ring->num_slots) * ring->slot_size);
+}
+
+metrics_view::metrics_view()
+    : msg(&empty_metrics), seq(nullptr), expected_seq(0), sample_time_ns(0) {}
+
+metrics_view::metrics_view(const mangohud_message* msg, const std::atomic<uint32_t>* seq, uint32_t expected_seq,
+                           uint64_t sample_time_ns)
+    : msg(msg), seq(seq), expected_seq(expected_seq), sample_time_ns(sample_time_ns) {}
+
+bool metrics_view::valid() const {
+    if (!seq)
+        return true;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return seq->load(std::memory_order_relaxed) == expected_seq;
+}
+
+// False if the server was writing the newest slot on every try
+static bool read_latest(metrics_view& out) {
+    const mangohud_shm_ring* ring = active_ring.load(std::memory_order_acquire);
+
+    if (!ring) {
+        out = metrics_view();
+        return true;
+    }
+
+    // The slot at head is only odd if the server lapped the ring between
+    // the two loads, just try again with the newer head
+    for (int tries = 0; tries < 8; tries++) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+
+        if (head == 0) {
+            out = metrics_view();
+            return true;
+        }
+
+        const mangohud_shm_slot* slot = slot_at(ring, head - 1);
+        uint32_t seq = slot->seq.load(std::memory_order_acquire);
+
+        if (!(seq & 1)) {
+            out = metrics_view(&slot->msg, &slot->seq, seq, slot->sample_time_ns);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+metrics_view latest_metrics() {
+    metrics_view view;
+    read_latest(view);
+    return view;
+}
+
+void update_metrics_view(metrics_view& view) {
+    metrics_view latest;
+    if (read_latest(latest))
+        view = latest;
+}
+
+bool metrics_around(uint64_t time_ns, metrics_view& before, metrics_view& after) {
+    const mangohud_shm_ring* ring = active_ring.load(std::memory_order_acquire);
+
+    if (!ring)
+        return false;
+
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+
+    // Leave out the oldest slot, it's the one the server writes next
+    uint64_t count = std::min<uint64_t>(head, ring->num_slots - 1);
+    bool found = false;
+
+    for (uint64_t i = 1; i <= count; i++) {
+        const mangohud_shm_slot* slot = slot_at(ring, head - i);
+        uint32_t seq = slot->seq.load(std::memory_order_acquire);
+
+        if (seq & 1)
+            continue;
 
-std::mutex g_metrics_lock;
-mangohud_message g_metrics = {};
+        metrics_view view(&slot->msg, &slot->seq, seq, slot->sample_time_ns);
+
+        // Walking from newest to oldest, the first one not after time_ns
+        // is the one before it and the one we saw last is the one after
+        if (view.sample_time_ns <= time_ns) {
+            before = view;
+            if (!found)
+                after = view;
+            return true;
+        }
+
+        before = after = view;
+        found = true;
+    }
+
+    return found;
+}
+
+// History waiting for the HUD to pick it up. The flag saves taking the lock
+// on every update when there's nothing to take, which is almost always.
+static std::mutex history_lock;
+static std::vector<metrics_sample> pending_history;
+static std::atomic<bool> history_pending {false};
+
+static void hand_off_history(std::vector<metrics_sample>& samples) {
+    if (samples.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(history_lock);
+    pending_history.swap(samples);
+    samples.clear();
+    history_pending.store(true, std::memory_order_release);
+}
+
+bool take_metrics_history(std::vector<metrics_sample>& out) {
+    if (!history_pending.load(std::memory_order_acquire))
+        return false;
+
+    std::lock_guard<std::mutex> lock(history_lock);
+    out.swap(pending_history);
+    pending_history.clear();
+    history_pending.store(false, std::memory_order_relaxed);
+    return !out.empty();
+}
+
+// Copies what a shared ring still holds, oldest first. Slots the server
+// rewrites while we copy them are left out.
+static void read_ring_history(const mangohud_shm_ring* ring, std::vector<metrics_sample>& out) {
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>(head, ring->num_slots - 1);
+
+    out.clear();
+    for (uint64_t i = count; i >= 1; i--) {
+        const mangohud_shm_slot* slot = slot_at(ring, head - i);
+        uint32_t seq = slot->seq.load(std::memory_order_acquire);
+
+        if (seq & 1)
+            continue;
+
+        metrics_sample sample;
+        memcpy(&sample.msg, &slot->msg, sizeof(sample.msg));
+        sample.sample_time_ns = slot->sample_time_ns;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->seq.load(std::memory_order_relaxed) != seq || !sample.sample_time_ns)
+            continue;
+
+        out.push_back(sample);
+    }
+}
+
+static void init_local_ring() {
+    local_ring.ring.magic = MANGOHUD_SHM_MAGIC;
+    local_ring.ring.version = MANGOHUD_SHM_VERSION;
+    local_ring.ring.num_slots = sizeof(local_ring.slots) / sizeof(local_ring.slots[0]);
+    local_ring.ring.slot_size = sizeof(mangohud_shm_slot);
+    local_ring.ring.slots_offset = offsetof(decltype(local_ring), slots);
+}
+
+// Start writing the next slot of the local ring, the caller fills in msg
+static mangohud_shm_slot& begin_local_write() {
+    uint64_t head = local_ring.ring.head.load(std::memory_order_relaxed);
+    mangohud_shm_slot& slot = local_ring.slots[head % local_ring.ring.num_slots];
+
+    slot.seq.store(slot.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return slot;
+}
+
+static void end_local_write(mangohud_shm_slot& slot) {
+    slot.seq.store(slot.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    local_ring.ring.head.fetch_add(1, std::memory_order_release);
+}
+
+static void unmap_retired() {
+    auto now = std::chrono::steady_clock::now();
+
+    retired_mappings.erase(std::remove_if(retired_mappings.begin(), retired_mappings.end(),
+        [&](const shm_mapping& m) {
+            using namespace std::chrono_literals;
+            if (now - m.retired < 1s)
+                return false;
+
+            munmap(m.addr, m.size);
+            return true;
+        }), retired_mappings.end());
+}
+
+static bool attach_shared_memory(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(mangohud_shm_ring)) {
+        SPDLOG_ERROR("Server sent an invalid shared memory fd.");
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        LOG_UNIX_ERRNO_ERROR("Failed to map shared memory.");
+        return false;
+    }
+
+    const mangohud_shm_ring* ring = static_cast<const mangohud_shm_ring*>(addr);
+
+    if (ring->magic != MANGOHUD_SHM_MAGIC || ring->version < MANGOHUD_SHM_VERSION ||
+        ring->num_slots == 0 || ring->slot_size < sizeof(mangohud_shm_slot) ||
+        ring->slots_offset < sizeof(mangohud_shm_ring) ||
+        ring->slots_offset + uint64_t(ring->num_slots) * ring->slot_size > size) {
+        SPDLOG_ERROR("Server's shared memory ring has an unexpected layout, not using it.");
+        munmap(addr, size);
+        return false;
+    }
+
+    current_mapping = { addr, size, {} };
+    active_ring.store(ring, std::memory_order_release);
+
+    SPDLOG_DEBUG("Reading metrics from shared memory ({} slots)", ring->num_slots);
+    return true;
+}
+
+static void detach_shared_memory() {
+    if (!current_mapping.addr)
+        return;
+
+    active_ring.store(&local_ring.ring, std::memory_order_release);
+
+    current_mapping.retired = std::chrono::steady_clock::now();
+    retired_mappings.push_back(current_mapping);
+    current_mapping = {};
+}
 
 static bool create_socket(int& sock) {
     sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0);
@@ -34,7 +306,11 @@ static bool connect_to_socket(const int sock, const sockaddr_un& addr) {
     int ret = connect(sock, reinterpret_cast<const sockaddr*>(&addr), sizeof(sockaddr_un));
 
     if (ret < 0) {
-        LOG_UNIX_ERRNO_ERROR("Failed to connect to server socket.");
+        // Expected until the server is up, no need to shout about it
+        if (errno == ENOENT || errno == ECONNREFUSED)
+            SPDLOG_DEBUG("Server isn't up yet.");
+        else
+            LOG_UNIX_ERRNO_ERROR("Failed to connect to server socket.");
         return false;
     }
 
@@ -42,52 +318,415 @@ static bool connect_to_socket(const int sock, const sockaddr_un& addr) {
     return true;
 }
 
-static void poll_server(pollfd& server_poll, bool& connected, int sock) {
-    mangohud_message msg = {};
-    send_message(server_poll.fd, msg);
+// What we ask the server for. Set from the config, read by the connection
+// thread which resubscribes when it changes.
+struct server_subscription {
+    uint32_t interval_ms = 500;
+    uint64_t fields = MANGOHUD_FIELD_ALL;
+    uint64_t gpus = ~0ull;
 
-    int ret = poll(&server_poll, 1, 1000);
+    // History asked for on connect, enough to fill the graphs. Changing it
+    // only matters for the next connection, so it doesn't count below.
+    uint32_t history_ms = 50 * 500;
+    uint32_t history_samples = 100;
 
-    if (ret < 0) {
-        LOG_UNIX_ERRNO_ERROR("poll() failed.");
-        return;
+    bool operator!=(const server_subscription& o) const {
+        return interval_ms != o.interval_ms || fields != o.fields || gpus != o.gpus;
+    }
+};
+
+static std::mutex subscription_lock;
+static server_subscription wanted_subscription;
+// Lets the config side interrupt the connection thread's poll()
+static std::atomic<int> wake_fd {-1};
+
+// Servers which don't know about subscriptions still answer every message
+// they get with a single mangohud_message, so we keep polling them.
+static bool server_is_legacy = false;
+
+static server_subscription get_wanted_subscription() {
+    std::lock_guard<std::mutex> lock(subscription_lock);
+    return wanted_subscription;
+}
+
+static uint32_t keepalive_ms(uint32_t interval_ms) {
+    return std::max<uint32_t>(interval_ms * 4, 1000);
+}
+
+static bool send_subscription(int sock, const server_subscription& sub) {
+    mangohud_subscribe_v1 req = {};
+    req.hdr.magic = MANGOHUD_REQUEST_MAGIC;
+    req.hdr.version = 1;
+    req.hdr.type = MANGOHUD_REQUEST_SUBSCRIBE;
+    req.interval_ms = sub.interval_ms;
+    req.keepalive_ms = keepalive_ms(sub.interval_ms);
+    req.wire_version = MANGOHUD_WIRE_DELTA;
+    req.fields = sub.fields;
+    req.gpus = sub.gpus;
+
+    if (send(sock, &req, sizeof(req), MSG_NOSIGNAL) != sizeof(req)) {
+        LOG_UNIX_ERRNO_ERROR("Failed to send subscription.");
+        return false;
+    }
+
+    SPDLOG_DEBUG("Subscribed to server metrics every {} ms, fields {:#x}, gpus {:#x}",
+                 sub.interval_ms, sub.fields, sub.gpus);
+    return true;
+}
+
+static bool request_shared_memory(int sock) {
+    mangohud_shared_memory_request_v1 req = {};
+    req.hdr.magic = MANGOHUD_REQUEST_MAGIC;
+    req.hdr.version = 1;
+    req.hdr.type = MANGOHUD_REQUEST_SHARED_MEMORY;
+    req.msg_size = sizeof(mangohud_message);
+
+    if (send(sock, &req, sizeof(req), MSG_NOSIGNAL) != sizeof(req)) {
+        LOG_UNIX_ERRNO_ERROR("Failed to request shared memory.");
+        return false;
+    }
+
+    return true;
+}
+
+static bool request_history(int sock, const server_subscription& sub) {
+    mangohud_history_request_v1 req = {};
+    req.hdr.magic = MANGOHUD_REQUEST_MAGIC;
+    req.hdr.version = 1;
+    req.hdr.type = MANGOHUD_REQUEST_HISTORY;
+    req.duration_ms = sub.history_ms;
+    req.max_samples = sub.history_samples;
+
+    if (send(sock, &req, sizeof(req), MSG_NOSIGNAL) != sizeof(req)) {
+        LOG_UNIX_ERRNO_ERROR("Failed to request history.");
+        return false;
+    }
+
+    return true;
+}
+
+// Receives one packet from the server, along with the fd of the shared
+// memory reply
+static ssize_t receive_packet(int sock, std::vector<uint8_t>& buf, int& fd) {
+    iovec iov = { buf.data(), buf.size() };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    msghdr hdr = {};
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+
+    fd = -1;
+    ssize_t len = recvmsg(sock, &hdr, MSG_CMSG_CLOEXEC);
+
+    if (len < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            LOG_UNIX_ERRNO_ERROR("Failed to receive message from server.");
+        return len;
+    }
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+    if (hdr.msg_flags & MSG_TRUNC) {
+        SPDLOG_DEBUG("Dropped oversized packet from server.");
+        if (fd >= 0)
+            close(fd);
+        return -1;
     }
 
-    // no new data
-    if (ret < 1)
+    return len;
+}
+
+static void publish_local(const void* msg, uint64_t sample_time_ns) {
+    mangohud_shm_slot& slot = begin_local_write();
+    memcpy(&slot.msg, msg, sizeof(slot.msg));
+    slot.sample_time_ns = sample_time_ns;
+    end_local_write(slot);
+}
+
+static void disconnect(int& sock, bool& connected) {
+    connected = false;
+
+    detach_shared_memory();
+
+    mangohud_message empty = {};
+    publish_local(&empty, metrics_clock_ns());
+
+    close(sock);
+    sock = -1;
+}
+
+// Waits for the server socket to show up. inotify on its directory wakes us
+// the moment the server creates it, the backoff covers what inotify can't
+// see, like the directory not existing yet.
+struct socket_watch {
+    std::string dir;
+    std::string name;
+    int fd = -1;
+    std::chrono::milliseconds backoff = min_backoff;
+    // A new socket means a new server, which may understand more than the last one
+    bool replaced = false;
+
+    static constexpr std::chrono::milliseconds min_backoff {50};
+    static constexpr std::chrono::milliseconds max_backoff {2000};
+};
+
+constexpr std::chrono::milliseconds socket_watch::min_backoff;
+constexpr std::chrono::milliseconds socket_watch::max_backoff;
+
+static void watch_socket_dir(socket_watch& watch) {
+    if (watch.fd >= 0)
         return;
 
-    // Check events
-    if (server_poll.revents == 0)
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        LOG_UNIX_ERRNO_ERROR("Couldn't create inotify instance, polling for the server socket.");
         return;
+    }
+
+    // Most likely the directory doesn't exist yet, we try again next time
+    if (inotify_add_watch(fd, watch.dir.c_str(), IN_CREATE | IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF) < 0) {
+        SPDLOG_DEBUG("Can't watch {} for the server socket yet.", watch.dir);
+        close(fd);
+        return;
+    }
 
-    SPDLOG_TRACE("fd {}: revents = {}", server_poll.fd, server_poll.revents);
+    watch.fd = fd;
+}
+
+// Reads what happened in the directory, true if it concerns the socket
+static bool read_watch_events(socket_watch& watch) {
+    alignas(inotify_event) char buf[4096];
+    bool socket_changed = false;
+    ssize_t len;
+
+    while (watch.fd >= 0 && (len = read(watch.fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t pos = 0; pos < len;) {
+            const inotify_event* ev = reinterpret_cast<const inotify_event*>(buf + pos);
+            pos += sizeof(inotify_event) + ev->len;
+
+            if (ev->mask & (IN_IGNORED | IN_DELETE_SELF)) {
+                // The directory went away, set the watch up again once it's back
+                close(watch.fd);
+                watch.fd = -1;
+                socket_changed = true;
+                break;
+            }
 
-    if (server_poll.revents & POLLHUP || server_poll.revents & POLLNVAL) {
-        connected = false;
-        
-        {
-            std::unique_lock<std::mutex> lock(g_metrics_lock);
-            g_metrics = {};
+            if (ev->len && watch.name == ev->name) {
+                socket_changed = true;
+                watch.replaced |= ev->mask & (IN_CREATE | IN_MOVED_TO);
+            }
         }
+    }
+
+    return socket_changed;
+}
+
+static void wait_for_socket(socket_watch& watch) {
+    pollfd pfd = { .fd = watch.fd, .events = POLLIN };
 
-        close(sock);
+    int ret = poll(&pfd, watch.fd < 0 ? 0 : 1, watch.backoff.count());
+
+    // The server may still be between bind() and listen(), look again soon
+    if (ret > 0 && read_watch_events(watch)) {
+        watch.backoff = socket_watch::min_backoff;
         return;
     }
 
-    if (!receive_message(server_poll.fd, msg)) {
-        SPDLOG_DEBUG("Failed to receive message from server.");
+    watch.backoff = std::min(watch.backoff * 2, socket_watch::max_backoff);
+}
+
+using conn_clock = std::chrono::steady_clock;
+
+struct connection {
+    int sock = -1;
+    bool connected = false;
+    bool got_reply = false;
+    server_subscription sub;
+
+    // In subscription mode: when we give up on the server.
+    // In legacy mode: when we have to poll it next.
+    // With shared memory: never, the socket only tells us when the server goes away.
+    conn_clock::time_point deadline;
+
+    // Last message assembled from delta samples
+    mangohud_message reference;
+    uint32_t next_sequence = 0;
+    // Set whenever we (re)subscribe, deltas are useless until the keyframe
+    bool awaiting_keyframe = true;
+
+    // History from before we connected. Read from the shared ring if it
+    // goes back far enough, otherwise assembled from the server's answer.
+    mangohud_message history_reference;
+    uint32_t history_sequence = 0;
+    std::vector<metrics_sample> history;
+    bool history_done = false;
+
+    std::vector<uint8_t> rx_buffer = std::vector<uint8_t>(2 * sizeof(mangohud_message) + 256);
+
+    // Since when the HUD has been without metrics, for measuring startup
+    // and reconnects
+    conn_clock::time_point waiting_since = conn_clock::now();
+    bool waiting_for_metrics = true;
+};
+
+static void got_metrics(connection& conn) {
+    if (!conn.waiting_for_metrics)
+        return;
+
+    conn.waiting_for_metrics = false;
+    SPDLOG_DEBUG("First metrics from server after {} ms",
+                 std::chrono::duration_cast<std::chrono::milliseconds>(conn_clock::now() - conn.waiting_since).count());
+}
+
+static void push_deadline(connection& conn) {
+    if (!server_is_legacy && !current_mapping.addr)
+        conn.deadline = conn_clock::now() + std::chrono::milliseconds(keepalive_ms(conn.sub.interval_ms));
+}
+
+static void finish_history(connection& conn) {
+    conn.history_done = true;
+    SPDLOG_DEBUG("Got {} samples of history", conn.history.size());
+    hand_off_history(conn.history);
+}
+
+static void handle_history(connection& conn, const mangohud_sample_v2& hdr, const uint8_t* data, size_t len) {
+    if (conn.history_done)
+        return;
+
+    if (hdr.flags & MANGOHUD_SAMPLE_HISTORY_END) {
+        finish_history(conn);
         return;
     }
 
-    {
-        std::unique_lock<std::mutex> lock(g_metrics_lock);
-        g_metrics = msg;
+    // Unlike the live samples there's no asking again, graphs just start
+    // out empty then
+    bool keyframe = hdr.flags & MANGOHUD_SAMPLE_KEYFRAME;
+    if (!keyframe && (conn.history.empty() || hdr.sequence != conn.history_sequence)) {
+        SPDLOG_DEBUG("Server history has gaps, not using it.");
+        conn.history.clear();
+        conn.history_done = true;
+        return;
     }
+
+    if (!apply_metrics_sample(conn.history_reference, data, len)) {
+        SPDLOG_ERROR("Malformed history sample from server.");
+        conn.history.clear();
+        conn.history_done = true;
+        return;
+    }
+
+    conn.history_sequence = hdr.sequence + 1;
+    if (hdr.sample_time_ns)
+        conn.history.push_back({ hdr.sample_time_ns, conn.history_reference });
+}
+
+// A freshly attached ring may already hold all the history we want
+static bool ring_covers_history(connection& conn) {
+    const mangohud_shm_ring* ring = active_ring.load(std::memory_order_relaxed);
+
+    read_ring_history(ring, conn.history);
+    if (conn.history.size() < 2 ||
+        conn.history.front().sample_time_ns + conn.sub.history_ms * 1000000ull > metrics_clock_ns()) {
+        conn.history.clear();
+        return false;
+    }
+
+    finish_history(conn);
+    return true;
+}
+
+static void handle_sample(connection& conn, const uint8_t* data, size_t len) {
+    mangohud_sample_v2 hdr = {};
+    memcpy(&hdr, data, std::min(len, sizeof(hdr)));
+
+    if (hdr.flags & MANGOHUD_SAMPLE_HISTORY) {
+        handle_history(conn, hdr, data, len);
+        return;
+    }
+
+    // Samples build on each other, after losing one only a keyframe helps
+    bool keyframe = hdr.flags & MANGOHUD_SAMPLE_KEYFRAME;
+    if (!keyframe && conn.awaiting_keyframe)
+        return;
+
+    if (!keyframe && hdr.sequence != conn.next_sequence) {
+        SPDLOG_DEBUG("Missed a server sample, resubscribing for a keyframe.");
+        conn.awaiting_keyframe = true;
+        send_subscription(conn.sock, conn.sub);
+        return;
+    }
+
+    if (!apply_metrics_sample(conn.reference, data, len)) {
+        SPDLOG_ERROR("Malformed sample from server, is it built with a different mangohud_message?");
+        return;
+    }
+
+    conn.awaiting_keyframe = false;
+    conn.next_sequence = hdr.sequence + 1;
+
+    // Servers that don't stamp their samples leave it zeroed, receiving it
+    // is the best guess we have then
+    publish_local(&conn.reference, hdr.sample_time_ns ? hdr.sample_time_ns : metrics_clock_ns());
+    got_metrics(conn);
+}
+
+static void handle_packet(connection& conn, const uint8_t* data, size_t len, int fd) {
+    mangohud_request_header hdr = {};
+    if (len >= sizeof(hdr))
+        memcpy(&hdr, data, sizeof(hdr));
+
+    // A framed packet can be as long as a bare message, only the magic
+    // tells them apart
+    if (hdr.magic != MANGOHUD_REQUEST_MAGIC) {
+        if (len == sizeof(mangohud_message)) {
+            // Servers without the framed protocol send bare messages
+            publish_local(data, metrics_clock_ns());
+            got_metrics(conn);
+            conn.got_reply = true;
+            push_deadline(conn);
+        } else {
+            SPDLOG_DEBUG("Unexpected packet from server.");
+        }
+    } else if (hdr.type == MANGOHUD_REQUEST_SAMPLE) {
+        handle_sample(conn, data, len);
+        conn.got_reply = true;
+        push_deadline(conn);
+    } else if (hdr.type == MANGOHUD_REQUEST_SHARED_MEMORY) {
+        // With shared memory this may be the only packet we ever get
+        conn.got_reply = true;
+
+        bool attached = false;
+        if (fd < 0)
+            SPDLOG_DEBUG("Server can't share memory, receiving metrics over the socket.");
+        else if (current_mapping.addr)
+            close(fd);
+        else if (attach_shared_memory(fd)) {
+            conn.deadline = conn_clock::time_point::max();
+            got_metrics(conn);
+            attached = true;
+        }
+
+        // Servers that answer this know about history too. Ask for it
+        // unless the ring already holds enough.
+        if (!conn.history_done && !(attached && ring_covers_history(conn)) && conn.sub.history_ms)
+            request_history(conn.sock, conn.sub);
+        return;
+    } else {
+        SPDLOG_DEBUG("Unexpected packet from server.");
+    }
+
+    if (fd >= 0)
+        close(fd);
 }
 
 static void client_thread () {
-    std::string socket_path = get_socket_path();
+    // Lets tests and benchmarks point us at a mock server
+    const char* socket_override = getenv("MANGOHUD_SERVER_SOCKET");
+    std::string socket_path = socket_override ? socket_override : get_socket_path();
 
     if (socket_path.empty())
         return; 
@@ -100,55 +739,324 @@ static void client_thread () {
 
     std::strncpy(const_cast<char*>(addr.sun_path), socket_path.c_str(), socket_path.size());
 
-    int sock = 0;
-    pollfd server_poll = { .fd = sock, .events = POLLIN };
+    connection conn;
 
-    std::chrono::time_point<std::chrono::steady_clock> previous_time;
-
-    bool connected = false;
-
-    using namespace std::chrono_literals;
+    socket_watch watch;
+    size_t slash = socket_path.rfind('/');
+    watch.dir = slash == std::string::npos ? "." : socket_path.substr(0, std::max<size_t>(slash, 1));
+    watch.name = socket_path.substr(slash + 1);
 
     while (true) {
-        if (!connected) {
-            SPDLOG_WARN("Lost connection to server. Retrying...");
+        if (!conn.connected) {
+            // Watch before trying, so a socket created right after a failed
+            // connect() still wakes us up
+            watch_socket_dir(watch);
+            read_watch_events(watch);
 
-            if (!create_socket(sock)) {
-                std::this_thread::sleep_for(1s);
+            if (!create_socket(conn.sock)) {
+                wait_for_socket(watch);
                 continue;
             }
 
-            if (!connect_to_socket(sock, addr)) {
-                close(sock);
-                std::this_thread::sleep_for(1s);
+            if (!connect_to_socket(conn.sock, addr)) {
+                close(conn.sock);
+                conn.sock = -1;
+                wait_for_socket(watch);
                 continue;
             }
 
-            server_poll.fd = sock;
-            connected = true;
+            watch.backoff = socket_watch::min_backoff;
+
+            // We may have been talking to the old one going down
+            if (watch.replaced) {
+                server_is_legacy = false;
+                watch.replaced = false;
+            }
+
+            // Everything below goes out right away, the server answers the
+            // subscription with a keyframe and legacy servers get polled on
+            // the first pass, so nobody waits a whole interval for metrics.
+            conn.connected = true;
+            conn.got_reply = false;
+            conn.awaiting_keyframe = true;
+            conn.history.clear();
+            conn.history_done = false;
+            conn.sub = get_wanted_subscription();
+            unmap_retired();
+
+            if (server_is_legacy || !send_subscription(conn.sock, conn.sub))
+                server_is_legacy = true;
+
+            if (!server_is_legacy)
+                request_shared_memory(conn.sock);
+
+            conn.deadline = conn_clock::now();
+            push_deadline(conn);
+        }
+
+        if (server_is_legacy && conn_clock::now() >= conn.deadline) {
+            mangohud_message msg = {};
+            send_message(conn.sock, msg);
+            conn.deadline = conn_clock::now() + std::chrono::milliseconds(conn.sub.interval_ms);
+        }
+
+        pollfd fds[2] = {
+            { .fd = conn.sock, .events = POLLIN },
+            { .fd = wake_fd.load(), .events = POLLIN },
+        };
+
+        int timeout_ms = -1;
+        if (conn.deadline != conn_clock::time_point::max()) {
+            // Round up, waking early would just spin until the deadline
+            auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+                conn.deadline - conn_clock::now() + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1));
+            timeout_ms = std::max<int64_t>(timeout.count(), 0);
+        }
+
+        int ret = poll(fds, fds[1].fd < 0 ? 1 : 2, timeout_ms);
+
+        if (ret < 0) {
+            if (errno != EINTR)
+                LOG_UNIX_ERRNO_ERROR("poll() failed.");
+            continue;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            if (read(fds[1].fd, &count, sizeof(count)) < 0)
+                LOG_UNIX_ERRNO_ERROR("Failed to read eventfd.");
+
+            server_subscription sub = get_wanted_subscription();
+            if (sub != conn.sub) {
+                conn.sub = sub;
+
+                // The server answers with a keyframe
+                if (!server_is_legacy) {
+                    conn.awaiting_keyframe = true;
+                    send_subscription(conn.sock, conn.sub);
+                    push_deadline(conn);
+                }
+            }
         }
 
-        poll_server(server_poll, connected, sock);
-        std::this_thread::sleep_for(1s);
+        SPDLOG_TRACE("fd {}: revents = {}", fds[0].fd, fds[0].revents);
+
+        if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+            // A server that drops us right after subscribing doesn't understand it
+            if (!server_is_legacy && !conn.got_reply) {
+                SPDLOG_DEBUG("Server closed connection after subscribing, falling back to polling.");
+                server_is_legacy = true;
+            }
+
+            SPDLOG_WARN("Lost connection to server, waiting for it to come back.");
+            disconnect(conn.sock, conn.connected);
+            conn.waiting_since = conn_clock::now();
+            conn.waiting_for_metrics = true;
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = -1;
+            ssize_t len = receive_packet(conn.sock, conn.rx_buffer, fd);
+
+            if (len >= 0)
+                handle_packet(conn, conn.rx_buffer.data(), len, fd);
+
+            continue;
+        }
+
+        // Nothing pushed within the keepalive period. Either the server only
+        // answered our subscription like a poll or it's stuck, polling works
+        // for both.
+        if (!server_is_legacy && !current_mapping.addr && conn_clock::now() >= conn.deadline) {
+            SPDLOG_DEBUG("Server doesn't push metrics, falling back to polling every {} ms.", conn.sub.interval_ms);
+            server_is_legacy = true;
+        }
     }
 
     return;
 }
 
+static void set_wanted_subscription(const server_subscription& sub) {
+    {
+        std::lock_guard<std::mutex> lock(subscription_lock);
+        if (!(sub != wanted_subscription))
+            return;
+
+        wanted_subscription = sub;
+    }
+
+    int fd = wake_fd;
+    if (fd >= 0) {
+        uint64_t one = 1;
+        if (write(fd, &one, sizeof(one)) < 0)
+            LOG_UNIX_ERRNO_ERROR("Failed to wake server connection thread.");
+    }
+}
+
+#ifndef TEST_ONLY
+// What the graphs of the current layout show, refresh_server_subscription()
+// runs on the logging threads too and can't walk the layout itself
+static std::atomic<uint64_t> graph_fields {0};
+
+void update_graph_fields() {
+    static const std::map<std::string, uint64_t> fields_of = {
+        { "cpu_load",       MANGOHUD_FIELD_CPU_LOAD },
+        { "gpu_load",       MANGOHUD_FIELD_GPU_LOAD },
+        { "cpu_temp",       MANGOHUD_FIELD_CPU_TEMP },
+        { "gpu_temp",       MANGOHUD_FIELD_GPU_TEMP },
+        { "gpu_core_clock", MANGOHUD_FIELD_GPU_CORE_CLOCK },
+        { "gpu_mem_clock",  MANGOHUD_FIELD_GPU_MEMORY_CLOCK },
+        { "vram",           MANGOHUD_FIELD_GPU_VRAM },
+        { "ram",            MANGOHUD_FIELD_MEMORY },
+    };
+
+    uint64_t fields = 0;
+    for (const auto& func : HUDElements.ordered_functions) {
+        auto it = fields_of.find(func.value);
+        if (func.name.rfind("graph: ", 0) == 0 && it != fields_of.end())
+            fields |= it->second;
+    }
+    graph_fields.store(fields, std::memory_order_relaxed);
+}
+
+// Only ask the server for what some HUD element or the log shows
+static uint64_t wanted_fields(const overlay_params& params, bool logging) {
+    struct field_user {
+        overlay_param_enabled param;
+        uint64_t fields;
+    };
+
+    static const field_user users[] = {
+        { OVERLAY_PARAM_ENABLED_cpu_stats,         MANGOHUD_FIELD_CPU_LOAD },
+        { OVERLAY_PARAM_ENABLED_core_load,         MANGOHUD_FIELD_CPU_CORES },
+        { OVERLAY_PARAM_ENABLED_core_bars,         MANGOHUD_FIELD_CPU_CORES },
+        { OVERLAY_PARAM_ENABLED_cpu_temp,          MANGOHUD_FIELD_CPU_TEMP },
+        { OVERLAY_PARAM_ENABLED_cpu_power,         MANGOHUD_FIELD_CPU_POWER },
+        { OVERLAY_PARAM_ENABLED_cpu_mhz,           MANGOHUD_FIELD_CPU_FREQUENCY },
+        { OVERLAY_PARAM_ENABLED_gpu_stats,         MANGOHUD_FIELD_GPU_LOAD },
+        { OVERLAY_PARAM_ENABLED_gpu_temp,          MANGOHUD_FIELD_GPU_TEMP },
+        { OVERLAY_PARAM_ENABLED_gpu_junction_temp, MANGOHUD_FIELD_GPU_JUNCTION_TEMP },
+        { OVERLAY_PARAM_ENABLED_gpu_mem_temp,      MANGOHUD_FIELD_GPU_MEMORY_TEMP },
+        { OVERLAY_PARAM_ENABLED_gpu_core_clock,    MANGOHUD_FIELD_GPU_CORE_CLOCK },
+        { OVERLAY_PARAM_ENABLED_gpu_mem_clock,     MANGOHUD_FIELD_GPU_MEMORY_CLOCK },
+        { OVERLAY_PARAM_ENABLED_gpu_power,         MANGOHUD_FIELD_GPU_POWER },
+        { OVERLAY_PARAM_ENABLED_gpu_power_limit,   MANGOHUD_FIELD_GPU_POWER },
+        { OVERLAY_PARAM_ENABLED_gpu_efficiency,    MANGOHUD_FIELD_GPU_POWER },
+        { OVERLAY_PARAM_ENABLED_flip_efficiency,   MANGOHUD_FIELD_GPU_POWER },
+        { OVERLAY_PARAM_ENABLED_vram,              MANGOHUD_FIELD_GPU_VRAM },
+        { OVERLAY_PARAM_ENABLED_proc_vram,         MANGOHUD_FIELD_GPU_VRAM },
+        { OVERLAY_PARAM_ENABLED_gpu_fan,           MANGOHUD_FIELD_GPU_FAN },
+        { OVERLAY_PARAM_ENABLED_gpu_voltage,       MANGOHUD_FIELD_GPU_VOLTAGE },
+        { OVERLAY_PARAM_ENABLED_throttling_status, MANGOHUD_FIELD_GPU_THROTTLING },
+        { OVERLAY_PARAM_ENABLED_throttling_status_graph, MANGOHUD_FIELD_GPU_THROTTLING },
+        { OVERLAY_PARAM_ENABLED_ram,               MANGOHUD_FIELD_MEMORY },
+        { OVERLAY_PARAM_ENABLED_swap,              MANGOHUD_FIELD_SWAP },
+        { OVERLAY_PARAM_ENABLED_procmem,           MANGOHUD_FIELD_PROCESS_MEMORY },
+        { OVERLAY_PARAM_ENABLED_procmem_shared,    MANGOHUD_FIELD_PROCESS_MEMORY },
+        { OVERLAY_PARAM_ENABLED_procmem_virt,      MANGOHUD_FIELD_PROCESS_MEMORY },
+    };
+
+    // Columns of the CSV log
+    const uint64_t logged_fields =
+        MANGOHUD_FIELD_CPU_LOAD | MANGOHUD_FIELD_CPU_TEMP | MANGOHUD_FIELD_CPU_POWER |
+        MANGOHUD_FIELD_CPU_FREQUENCY | MANGOHUD_FIELD_GPU_LOAD | MANGOHUD_FIELD_GPU_TEMP |
+        MANGOHUD_FIELD_GPU_CORE_CLOCK | MANGOHUD_FIELD_GPU_MEMORY_CLOCK | MANGOHUD_FIELD_GPU_POWER |
+        MANGOHUD_FIELD_GPU_VRAM | MANGOHUD_FIELD_MEMORY | MANGOHUD_FIELD_SWAP |
+        MANGOHUD_FIELD_PROCESS_MEMORY;
+
+    uint64_t fields = logging ? logged_fields : 0;
+
+    for (const field_user& user : users) {
+        if (params.enabled[user.param])
+            fields |= user.fields;
+    }
+
+    if (params.enabled[OVERLAY_PARAM_ENABLED_graphs])
+        fields |= graph_fields.load(std::memory_order_relaxed);
+
+    return fields;
+}
+
+void refresh_server_subscription() {
+    const overlay_params* params = HUDElements.params;
+    if (!params)
+        return;
+
+    bool logging = logger && logger->is_active();
+
+    server_subscription sub;
+
+    // Push at least as often as we sample or log
+    sub.interval_ms = std::max<uint32_t>(params->fps_sampling_period / 1000000, 1);
+    if (params->log_interval > 0)
+        sub.interval_ms = std::min<uint32_t>(sub.interval_ms, params->log_interval);
+    else if (logging)
+        // log_interval=0 logs every frame, so every sample the server can take
+        sub.interval_ms = 1;
+
+    // Finer samples to line up with every logged frame
+    if (logging && params->log_sample_rate > 0)
+        sub.interval_ms = std::min<uint32_t>(sub.interval_ms, std::max<uint32_t>(1000 / params->log_sample_rate, 1));
+
+    // Enough to fill the graphs, with some to spare for the gaps
+    sub.history_ms = kMaxGraphEntries * std::max<uint32_t>(params->fps_sampling_period / 1000000, 1);
+    sub.history_samples = kMaxGraphEntries * 2;
+
+    sub.fields = wanted_fields(*params, logging);
+
+    if (!params->gpu_list.empty()) {
+        sub.gpus = 0;
+        for (unsigned idx : params->gpu_list) {
+            if (idx < 64)
+                sub.gpus |= 1ull << idx;
+        }
+    }
+
+    set_wanted_subscription(sub);
+}
+#else
+void set_server_interval(uint32_t interval_ms) {
+    server_subscription sub = get_wanted_subscription();
+    sub.interval_ms = interval_ms;
+    set_wanted_subscription(sub);
+}
+#endif
+
 void setup_connection_to_server() {
     spdlog::set_level(spdlog::level::level_enum::debug);
 
     SPDLOG_DEBUG("setup_connection_to_server()");
 
-    std::thread t = std::thread(&client_thread);
-    pthread_setname_np(t.native_handle(), "mnghud-srv-conn");
-    t.detach();
+    // Every instance/context calls this, but the ring takes a single writer
+    static std::once_flag started;
+    std::call_once(started, [] {
+        init_local_ring();
+        active_ring = &local_ring.ring;
+
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd < 0)
+            LOG_UNIX_ERRNO_ERROR("Couldn't create eventfd, config changes apply on next message.");
+
+        std::thread t = std::thread(&client_thread);
+        pthread_setname_np(t.native_handle(), "mnghud-srv-conn");
+        t.detach();
+    });
 }
 
 bool get_active_gpu(const mangohud_message& msg, uint8_t& out_idx) {
     if (msg.num_of_gpus < 1)
         return false;
 
+#ifndef TEST_ONLY
+    // a single gpu picked by the user wins over what the server thinks
+    const overlay_params* params = HUDElements.params;
+    if (params && params->gpu_list.size() == 1 && params->gpu_list[0] < msg.num_of_gpus) {
+        out_idx = params->gpu_list[0];
+        return true;
+    }
+#endif
+
     for (uint8_t i = 0; i < msg.num_of_gpus; i++) {
         if (msg.gpus[i].is_active) {
             out_idx = i;
@@ -161,6 +1069,7 @@ bool get_active_gpu(const mangohud_message& msg, uint8_t& out_idx) {
     return true;
 }
 
+#ifndef TEST_ONLY
 std::set<uint8_t> selected_gpus(const mangohud_message& msg) {
     std::set<uint8_t> vec;
 
@@ -194,3 +1103,4 @@ std::string get_gpu_text(const mangohud_message& msg, uint8_t idx) {
 
     return "GPU" + std::to_string(idx);
 }
+#endif
@@ -1,13 +1,68 @@
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <set>
+#include <vector>
+#include <stdint.h>
+#include <time.h>
 #include "../../mangohud-server/common/gpu_metrics.hpp"
 
+// A sample read in place from the metrics ring, nothing is copied. It stays
+// readable until the next reconnect, valid() tells whether the server reused
+// the slot for a newer sample in the meantime.
+struct metrics_view {
+    const mangohud_message* msg;
+    const std::atomic<uint32_t>* seq;
+    uint32_t expected_seq;
+    uint64_t sample_time_ns;  // metrics_clock_ns() when msg was sampled, 0 if never
+
+    metrics_view();
+    metrics_view(const mangohud_message* msg, const std::atomic<uint32_t>* seq, uint32_t expected_seq,
+                 uint64_t sample_time_ns);
+
+    const mangohud_message& operator*() const { return *msg; }
+    const mangohud_message* operator->() const { return msg; }
+    bool valid() const;
+};
+
 bool get_active_gpu(const mangohud_message& msg, uint8_t& out_idx);
 std::set<uint8_t> selected_gpus(const mangohud_message& msg);
 std::string get_gpu_text(const mangohud_message& msg, uint8_t idx);
 void setup_connection_to_server();
+// Resend what we want from the server after the config or logging state changed
+void refresh_server_subscription();
+// Call on the thread that rebuilt the HUD layout, before refreshing the subscription
+void update_graph_fields();
+
+// Latest sample from the server, lock-free and safe to call from any thread
+metrics_view latest_metrics();
+// The two samples time_ns falls between, for interpolating. Both are the
+// nearest sample when time_ns is outside of what the ring still holds.
+// Returns false if there are no samples yet.
+bool metrics_around(uint64_t time_ns, metrics_view& before, metrics_view& after);
+
+// A sample the server took before we connected
+struct metrics_sample {
+    uint64_t sample_time_ns;
+    mangohud_message msg;
+};
+
+// Moves view on to the latest sample, for readers that hold on to one for a
+// whole frame. The server writes the oldest slot, so the newest one stays
+// put until it has lapped the ring. Keeps the sample view had if the server
+// was rewriting the newest slot the whole time.
+void update_metrics_view(metrics_view& view);
+
+// What the server remembered from before we (re)connected, oldest first,
+// handed out once per connection. Returns false if there's nothing new.
+bool take_metrics_history(std::vector<metrics_sample>& out);
 
-extern std::mutex g_metrics_lock;
-extern mangohud_message g_metrics;
+// The server stamps samples with CLOCK_MONOTONIC, not the CLOCK_MONOTONIC_RAW
+// of os_time_get_nano(), so anything compared with sample_time_ns has to
+// come from here.
+static inline uint64_t metrics_clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
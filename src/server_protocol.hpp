@@ -0,0 +1,175 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include "../../mangohud-server/common/gpu_metrics.hpp"
+
+// Packets the layer and mangohud-server exchange over the metrics socket,
+// besides the plain mangohud_message. They share the SOCK_SEQPACKET
+// connection with it, so every one starts with MANGOHUD_REQUEST_MAGIC which
+// tells them apart from the legacy empty-message poll.
+
+#define MANGOHUD_REQUEST_MAGIC 0x4d484344 // "MHCD"
+
+enum mangohud_request_type : uint16_t {
+    MANGOHUD_REQUEST_SUBSCRIBE = 1,
+    MANGOHUD_REQUEST_SHARED_MEMORY = 2,
+    MANGOHUD_REQUEST_SAMPLE = 3,  // server -> client, see mangohud_sample_v2
+    MANGOHUD_REQUEST_HISTORY = 4,
+};
+
+// Wire formats for pushed samples, the client asks for the newest it knows
+// and the server answers with the newest both sides know.
+enum mangohud_wire_version : uint16_t {
+    MANGOHUD_WIRE_FULL = 1,   // a whole mangohud_message per sample
+    MANGOHUD_WIRE_DELTA = 2,  // mangohud_sample_v2
+};
+
+// What the client wants sampled. The server leaves everything else zeroed
+// and doesn't spend time reading it. GPU names, ids and is_active are always
+// filled in.
+enum mangohud_field : uint64_t {
+    MANGOHUD_FIELD_CPU_LOAD         = 1ull << 0,
+    MANGOHUD_FIELD_CPU_CORES        = 1ull << 1,
+    MANGOHUD_FIELD_CPU_TEMP         = 1ull << 2,
+    MANGOHUD_FIELD_CPU_POWER        = 1ull << 3,
+    MANGOHUD_FIELD_CPU_FREQUENCY    = 1ull << 4,
+    MANGOHUD_FIELD_GPU_LOAD         = 1ull << 5,
+    MANGOHUD_FIELD_GPU_TEMP         = 1ull << 6,
+    MANGOHUD_FIELD_GPU_JUNCTION_TEMP = 1ull << 7,
+    MANGOHUD_FIELD_GPU_MEMORY_TEMP  = 1ull << 8,
+    MANGOHUD_FIELD_GPU_CORE_CLOCK   = 1ull << 9,
+    MANGOHUD_FIELD_GPU_MEMORY_CLOCK = 1ull << 10,
+    MANGOHUD_FIELD_GPU_POWER        = 1ull << 11,
+    MANGOHUD_FIELD_GPU_VRAM         = 1ull << 12,
+    MANGOHUD_FIELD_GPU_FAN          = 1ull << 13,
+    MANGOHUD_FIELD_GPU_VOLTAGE      = 1ull << 14,
+    MANGOHUD_FIELD_GPU_THROTTLING   = 1ull << 15,
+    MANGOHUD_FIELD_MEMORY           = 1ull << 16,
+    MANGOHUD_FIELD_SWAP             = 1ull << 17,
+    MANGOHUD_FIELD_PROCESS_MEMORY   = 1ull << 18,
+
+    MANGOHUD_FIELD_ALL              = ~0ull,
+};
+
+struct mangohud_request_header {
+    uint32_t magic;
+    uint16_t version;  /* version of the request type, for backwards incompatible changes */
+    uint16_t type;     /* mangohud_request_type */
+} __attribute__((packed));
+
+// Ask the server to push mangohud_message on its own instead of answering
+// polls. The server samples every interval_ms and pushes the message only if
+// it differs from the last one it sent, plus at least once per keepalive_ms
+// so the client can tell a quiet server from a dead one.
+// Sending a new subscription replaces the previous one.
+struct mangohud_subscribe_v1 {
+    struct mangohud_request_header hdr;
+
+    uint32_t interval_ms;
+    uint32_t keepalive_ms;
+
+    uint16_t wire_version;  // newest mangohud_wire_version the client understands
+    uint64_t fields;        // mangohud_field mask
+    uint64_t gpus;          // bit per GPU index the client shows
+
+    // WARNING: Always ADD fields, never remove or repurpose fields
+} __attribute__((packed));
+
+// Ask the server to share its samples through memory instead of the socket.
+// It answers with a mangohud_shared_memory_v1 carrying a memfd that holds a
+// mangohud_shm_ring as SCM_RIGHTS ancillary data, and from then on writes
+// every sample into that ring instead of sending it.
+struct mangohud_shared_memory_request_v1 {
+    struct mangohud_request_header hdr;
+
+    uint32_t msg_size;  // sizeof(mangohud_message) on the client, the server refuses on mismatch
+
+    // WARNING: Always ADD fields, never remove or repurpose fields
+} __attribute__((packed));
+
+struct mangohud_shared_memory_v1 {
+    struct mangohud_request_header hdr;  // type is MANGOHUD_REQUEST_SHARED_MEMORY
+
+    uint32_t size;  // of the memfd, 0 if the server refused and sent no fd
+
+    // WARNING: Always ADD fields, never remove or repurpose fields
+} __attribute__((packed));
+
+#define MANGOHUD_SHM_MAGIC 0x4d48534d // "MHSM"
+#define MANGOHUD_SHM_VERSION 1
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "shared memory ring needs address free atomics");
+
+// Seqlock ring in the shared memfd. Only the server writes it: to publish a
+// sample it takes slot head % num_slots, makes its seq odd, writes msg, makes
+// seq even again and then increments head. Readers use the slot at
+// (head - 1) % num_slots in place; if its seq changed by the time they are
+// done, the server lapped the whole ring in the meantime.
+// The older slots stay readable the same way, which makes the ring a short
+// history of samples ordered by sample_time_ns.
+struct mangohud_shm_slot {
+    std::atomic<uint32_t> seq;
+    uint32_t reserved;
+    mangohud_message msg;
+    uint64_t sample_time_ns;  // CLOCK_MONOTONIC when the server read msg
+
+    // WARNING: Always ADD fields, never remove or repurpose fields
+};
+
+struct mangohud_shm_ring {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_slots;
+    uint32_t slot_size;     // stride between slots, may grow when mangohud_shm_slot gets new fields
+    uint32_t slots_offset;  // from the start of the ring
+    std::atomic<uint64_t> head;  // number of samples published so far
+
+    // WARNING: Always ADD fields, never remove or repurpose fields
+};
+
+// A sample in the MANGOHUD_WIRE_DELTA format. The receiver keeps the last
+// mangohud_message it assembled and the sample lists the parts that changed
+// since, as runs of 32 bit words:
+//
+//   uint16_t word_offset;  // into mangohud_message, in words
+//   uint8_t  num_words;
+//   uint32_t words[num_words];
+//
+// The runs follow the header back to back, starting at header_size. A
+// keyframe applies to a zeroed message instead, the server sends one after
+// every (re)subscription, so static data only goes over the wire once.
+#define MANGOHUD_SAMPLE_KEYFRAME 0x1
+// Part of the answer to a mangohud_history_request_v1 rather than the live
+// stream. History samples build on each other the same way, starting with a
+// keyframe and with their own sequence.
+#define MANGOHUD_SAMPLE_HISTORY 0x2
+// Together with MANGOHUD_SAMPLE_HISTORY: no runs, the history is complete
+#define MANGOHUD_SAMPLE_HISTORY_END 0x4
+
+struct mangohud_sample_v2 {
+    struct mangohud_request_header hdr;  // type is MANGOHUD_REQUEST_SAMPLE
+
+    uint16_t header_size;  // runs start here, lets this header grow
+    uint8_t flags;
+    uint16_t num_runs;
+    uint32_t sequence;     // increments by one per sample, a gap means we have to resubscribe
+    uint32_t msg_size;     // sizeof(mangohud_message) on the server
+    uint64_t sample_time_ns;  // CLOCK_MONOTONIC when the server read the sample
+
+    // WARNING: Always ADD fields, never remove or repurpose fields
+} __attribute__((packed));
+
+// Ask for samples the server took before we connected, so graphs don't start
+// out empty. The server answers with up to max_samples MANGOHUD_SAMPLE_HISTORY
+// samples from the last duration_ms, oldest first and spread out evenly,
+// followed by a MANGOHUD_SAMPLE_HISTORY_END even if it has none.
+struct mangohud_history_request_v1 {
+    struct mangohud_request_header hdr;
+
+    uint32_t duration_ms;
+    uint32_t max_samples;
+
+    // WARNING: Always ADD fields, never remove or repurpose fields
+} __attribute__((packed));
@@ -1,4 +1,5 @@
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <functional>
@@ -62,3 +63,82 @@ Display* get_xdisplay()
 {
     return display.get();
 }
+
+// Windows of other clients go away while we walk them. Xlib's default
+// handler exits on the BadWindow that follows, so errors on the search
+// connection are dropped and everything else goes to the app's handler.
+static Display* search_dpy;
+static XErrorHandler app_error_handler;
+
+static int search_error_handler(Display* dpy, XErrorEvent* event)
+{
+    if (dpy == search_dpy)
+        return 0;
+    return app_error_handler ? app_error_handler(dpy, event) : 0;
+}
+
+static bool find_window(libx11_loader* libx11, Display* dpy, Window w, const std::string& title, int depth)
+{
+    char *name = nullptr;
+    if (libx11->XFetchName(dpy, w, &name) && name) {
+        bool found = strstr(name, title.c_str()) != nullptr;
+        libx11->XFree(name);
+        if (found)
+            return true;
+    }
+
+    // Titles sit on the top level windows or on the frame's child
+    if (depth >= 2)
+        return false;
+
+    Window root, parent, *children = nullptr;
+    unsigned nchildren = 0;
+    if (!libx11->XQueryTree(dpy, w, &root, &parent, &children, &nchildren))
+        return false;
+
+    bool found = false;
+    for (unsigned i = 0; i < nchildren && !found; i++)
+        found = find_window(libx11, dpy, children[i], title, depth + 1);
+    if (children)
+        libx11->XFree(children);
+    return found;
+}
+
+bool x11_window_exists(const std::string& title)
+{
+    // Xlib isn't thread-safe and the shared display belongs to the present thread
+    static std::unique_ptr<Display, std::function<void(Display*)>> search_display;
+    static bool failed = false;
+    if (failed)
+        return false;
+
+    auto libx11 = get_libx11();
+    if (!search_display) {
+        const char *displayid = getenv("DISPLAY");
+        if (!libx11->IsLoaded() || !displayid || !*displayid) {
+            failed = true;
+            return false;
+        }
+
+        search_display = { libx11->XOpenDisplay(displayid),
+            [libx11](Display* dpy) {
+                if (dpy)
+                    libx11->XCloseDisplay(dpy);
+            }
+        };
+        if (!search_display) {
+            SPDLOG_ERROR("XOpenDisplay failed to open display '{}'", displayid);
+            failed = true;
+            return false;
+        }
+    }
+
+    Display* dpy = search_display.get();
+    search_dpy = dpy;
+    app_error_handler = libx11->XSetErrorHandler(search_error_handler);
+    bool found = find_window(libx11.get(), dpy, DefaultRootWindow(dpy), title, 0);
+    // Errors of the walk arrive by here, before the app's handler is back
+    libx11->XSync(dpy, False);
+    libx11->XSetErrorHandler(app_error_handler);
+    return found;
+}
@@ -3,8 +3,12 @@
 #define MANGOHUD_SHARED_X11_H
 
 #include <X11/Xlib.h>
+#include <string>
 
 Display* get_xdisplay();
 bool init_x11();
+// Any window whose title contains `title`. Uses its own connection, for
+// callers off the present thread.
+bool x11_window_exists(const std::string& title);
 
 #endif //MANGOHUD_SHARED_X11_H
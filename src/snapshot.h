@@ -0,0 +1,110 @@
+#pragma once
+#ifndef MANGOHUD_SNAPSHOT_H
+#define MANGOHUD_SNAPSHOT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Hands immutable copies of T from one writer thread to any number of
+ * reader threads without locks, RCU style.
+ *
+ * The writer fills a slot nobody is reading and publishes it with a single
+ * atomic pointer store. Readers pin the current slot for as long as they
+ * hold a view, so everything they read through it comes from the same
+ * publish even if the writer moves on in the meantime. Neither side ever
+ * waits for the other; if all spare slots are pinned, publish() drops the
+ * update and the next one gets through.
+ *
+ * N has to be at least 2 + the number of views held at the same time.
+ */
+template <typename T, size_t N = 4>
+class snapshot_buffer {
+    static_assert(N >= 3, "need the current slot, one to write and one to read");
+
+    struct slot {
+        std::atomic<uint32_t> readers {0};
+        T value {};
+    };
+
+public:
+    class view {
+    public:
+        view() = default;
+        view(const view&) = delete;
+        view& operator=(const view&) = delete;
+
+        view(view&& other) noexcept : s(other.s) { other.s = nullptr; }
+        view& operator=(view&& other) noexcept {
+            if (this != &other) {
+                release();
+                s = other.s;
+                other.s = nullptr;
+            }
+            return *this;
+        }
+
+        ~view() { release(); }
+
+        const T& operator*() const { return s->value; }
+        const T* operator->() const { return &s->value; }
+
+    private:
+        friend class snapshot_buffer;
+        explicit view(slot* s) : s(s) {}
+
+        void release() {
+            if (s)
+                s->readers.fetch_sub(1, std::memory_order_release);
+            s = nullptr;
+        }
+
+        slot* s = nullptr;
+    };
+
+    snapshot_buffer() : current(&slots[0]) {}
+
+    snapshot_buffer(const snapshot_buffer&) = delete;
+    snapshot_buffer& operator=(const snapshot_buffer&) = delete;
+
+    // Pin the latest snapshot, safe from any thread
+    view acquire() {
+        while (true) {
+            slot* s = current.load();
+            s->readers.fetch_add(1);
+
+            // The writer may have picked this slot again between the two
+            // loads, only keep it if it is still the published one.
+            if (current.load() == s)
+                return view(s);
+
+            s->readers.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    // Writer thread only
+    bool publish(const T& value) {
+        slot* cur = current.load(std::memory_order_relaxed);
+
+        for (slot& s : slots) {
+            if (&s == cur || s.readers.load() != 0)
+                continue;
+
+            s.value = value;
+            current.store(&s);
+            return true;
+        }
+
+        return false;
+    }
+
+    // What was published last, writer thread only
+    const T& latest() const { return current.load(std::memory_order_relaxed)->value; }
+
+private:
+    slot slots[N];
+    std::atomic<slot*> current;
+};
+
+#endif //MANGOHUD_SNAPSHOT_H
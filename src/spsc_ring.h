@@ -0,0 +1,73 @@
+#pragma once
+#ifndef MANGOHUD_SPSC_RING_H
+#define MANGOHUD_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Fixed size queue from exactly one producer thread to exactly one consumer
+ * thread, without locks or allocation.
+ *
+ * Positions count every value ever pushed and only wrap into the buffer on
+ * access, so they double as a timeline: anyone can ask how many values were
+ * pushed so far and later tell which drained values came after that point.
+ * If the consumer falls N behind, push() drops the new value instead of
+ * waiting for it.
+ */
+template <typename T, size_t N>
+class spsc_ring {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N has to be a power of two");
+
+public:
+    spsc_ring() = default;
+    spsc_ring(const spsc_ring&) = delete;
+    spsc_ring& operator=(const spsc_ring&) = delete;
+
+    // Producer thread only
+    bool push(const T& value) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+
+        if (h - tail.load(std::memory_order_acquire) >= N) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        buf[h & (N - 1)] = value;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only. Calls f(position, value) for everything pushed
+    // since the last drain, oldest first, and returns how many that were.
+    template <typename F>
+    size_t drain(F&& f) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+
+        for (uint64_t pos = t; pos < h; pos++)
+            f(pos, buf[pos & (N - 1)]);
+
+        tail.store(h, std::memory_order_release);
+        return h - t;
+    }
+
+    // Position of the next value pushed, safe from any thread
+    uint64_t pushed() const { return head.load(std::memory_order_acquire); }
+
+    // Values push() had to drop, safe from any thread
+    uint64_t overflows() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    // Each side writes its own cache line. Padded rather than aligned, so
+    // it can live in heap allocated objects before C++17's aligned new.
+    std::atomic<uint64_t> head {0};
+    std::atomic<uint64_t> dropped {0};
+    char pad0[64 - 2 * sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> tail {0};
+    char pad1[64 - sizeof(std::atomic<uint64_t>)];
+    T buf[N];
+};
+
+#endif //MANGOHUD_SPSC_RING_H
@@ -0,0 +1,215 @@
+#pragma once
+#ifndef MANGOHUD_STEADY_STATE_H
+#define MANGOHUD_STEADY_STATE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "frametime_histogram.h"
+
+enum class run_segment {
+    warmup,  // settling after the start, a loading screen or a change of scene
+    steady,  // frametimes holding around one level
+    stall,   // loading screens and hitches, frames slower than stall_ms
+};
+
+inline const char* run_segment_name(run_segment s) {
+    switch (s) {
+        case run_segment::warmup: return "warmup";
+        case run_segment::steady: return "steady";
+        case run_segment::stall:  return "stall";
+    }
+    return "";
+}
+
+struct segment_stats {
+    run_segment type;
+    double start_ms;     // frametimes summed since the detector started
+    double duration_ms;
+    uint64_t frames;
+    float avg_fps;
+    float low_1;         // 1% and 0.1% min fps
+    float low_01;
+};
+
+/*
+ * Splits a run into warm-up, steady and stall segments as frames come in,
+ * so benchmark results can leave out shader compilation and loading.
+ *
+ * Frames are averaged over blocks of block_ms to even out the noise. A
+ * two-sided CUSUM compares each block with the mean and deviation of the
+ * blocks since the last change: a shift of the level beyond the slack
+ * piles up until it crosses the limit, and the run goes back to warm-up
+ * at the new level. After steady_ms without a change it is steady.
+ *
+ * Blocks spending most of their time in frames slower than stall_ms are a
+ * stall once two follow each other. A lone slow block, and the slowest frame
+ * of every other block, are left out of the level so a hitch doesn't end
+ * the steady state.
+ *
+ * Segments start and end on block boundaries. add() is O(1), amortised
+ * over the blocks. Every segment gets its fps stats when it ends; at most
+ * max_segments are kept.
+ */
+class steady_state_detector {
+public:
+    static constexpr size_t max_segments = 256;
+
+    struct options {
+        uint32_t block_ms = 250;
+        uint32_t steady_ms = 5000;
+        float stall_ms = 100;
+    };
+
+    steady_state_detector() : steady_state_detector(options()) {}
+
+    explicit steady_state_detector(const options& opts) : opts(opts) {
+        open_segment(run_segment::warmup);
+    }
+
+    void add(float frametime_ms) {
+        block.push_back(frametime_ms);
+        block_time += frametime_ms;
+        block_max = std::max(block_max, frametime_ms);
+        if (frametime_ms >= opts.stall_ms)
+            block_stalled += frametime_ms;
+
+        if (block_time < opts.block_ms)
+            return;
+
+        end_block();
+
+        // The block counts towards whatever segment it ended up in
+        for (float f : block)
+            hist.add(f);
+        total_ms += block_time;
+
+        block.clear();
+        block_time = 0;
+        block_max = 0;
+        block_stalled = 0;
+    }
+
+    run_segment state() const { return current.type; }
+
+    // Ends the current segment and forgets the earlier ones, keeping the
+    // state. Stats from here on start with the block being filled.
+    void restart_segments() {
+        closed.clear();
+        open_segment(current.type);
+    }
+
+    // The ended segments and the current one, oldest first
+    std::vector<segment_stats> segments() const {
+        std::vector<segment_stats> all = closed;
+        if (hist.count())
+            all.push_back(finish(current, hist));
+        return all;
+    }
+
+private:
+    void end_block() {
+        // One slow block is a hitch and doesn't count towards the level,
+        // two in a row are a stall
+        if (block_stalled * 2 > block_time) {
+            if (previous_slow) {
+                switch_to(run_segment::stall);
+                restart_level();
+            }
+            previous_slow = true;
+            return;
+        }
+        previous_slow = false;
+
+        // Leave the slowest frame out so a lone hitch doesn't move the level
+        double mean = block.size() > 1 ? (block_time - block_max) / (block.size() - 1) : block_time;
+
+        if (current.type == run_segment::stall) {
+            switch_to(run_segment::warmup);
+            restart_level();
+        }
+
+        if (level_blocks >= 4 && shifted(mean)) {
+            switch_to(run_segment::warmup);
+            restart_level();
+        }
+
+        // Welford, over the block means since the last change
+        level_blocks++;
+        double delta = mean - level_mean;
+        level_mean += delta / level_blocks;
+        level_m2 += delta * (mean - level_mean);
+        level_ms += block_time;
+
+        if (current.type == run_segment::warmup && level_ms >= opts.steady_ms)
+            switch_to(run_segment::steady);
+    }
+
+    bool shifted(double mean) {
+        double sigma = std::sqrt(level_m2 / (level_blocks - 1));
+        double slack = 0.5 * sigma + 0.01 * level_mean;
+        double limit = 5 * sigma + 0.05 * level_mean;
+
+        cusum_up = std::max(0.0, cusum_up + mean - level_mean - slack);
+        cusum_down = std::max(0.0, cusum_down + level_mean - mean - slack);
+        return cusum_up > limit || cusum_down > limit;
+    }
+
+    void restart_level() {
+        level_blocks = 0;
+        level_mean = 0;
+        level_m2 = 0;
+        level_ms = 0;
+        cusum_up = 0;
+        cusum_down = 0;
+    }
+
+    void switch_to(run_segment type) {
+        if (type == current.type)
+            return;
+
+        if (hist.count() && closed.size() < max_segments)
+            closed.push_back(finish(current, hist));
+        open_segment(type);
+    }
+
+    void open_segment(run_segment type) {
+        current = {};
+        current.type = type;
+        current.start_ms = total_ms;
+        hist.clear();
+    }
+
+    segment_stats finish(segment_stats s, const frametime_histogram& frames) const {
+        s.duration_ms = total_ms - s.start_ms;
+        s.frames = frames.count();
+        s.avg_fps = 1000.f / frames.average();
+        s.low_1 = 1000.f / frames.slowest(std::max(0.01 * s.frames - 1, 0.0));
+        s.low_01 = 1000.f / frames.slowest(std::max(0.001 * s.frames - 1, 0.0));
+        return s;
+    }
+
+    options opts;
+
+    segment_stats current {};
+    frametime_histogram hist;  // frames of the current segment
+    std::vector<segment_stats> closed;
+    double total_ms = 0;
+
+    // Frames of the block being filled, not in any segment yet
+    std::vector<float> block;
+    double block_time = 0;
+    float block_max = 0;
+    double block_stalled = 0;
+    bool previous_slow = false;
+
+    uint64_t level_blocks = 0;
+    double level_mean = 0;
+    double level_m2 = 0;
+    double level_ms = 0;
+    double cusum_up = 0;
+    double cusum_down = 0;
+};
+
+#endif //MANGOHUD_STEADY_STATE_H
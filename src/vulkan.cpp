@@ -30,6 +30,9 @@
 #include <chrono>
 #include <unordered_map>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
 #include <vector>
 #include <list>
 #include <array>
@@ -41,11 +44,42 @@
 
 #include "mesa/util/macros.h" // defines "restrict" for vk_util.h
 #include "mesa/util/os_socket.h"
+#include "mesa/util/os_time.h"
 #include <vulkan/vulkan.h>
 #include <vulkan/vk_layer.h>
 #include <vulkan/vk_util.h>
 #include "vk_enum_to_str.h"
 
+/* VK_KHR_present_id and VK_KHR_present_wait are newer than the Vulkan headers
+ * we build against */
+#ifndef VK_KHR_present_id
+#define VK_KHR_PRESENT_ID_EXTENSION_NAME "VK_KHR_present_id"
+#define VK_STRUCTURE_TYPE_PRESENT_ID_KHR ((VkStructureType)1000294000)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR ((VkStructureType)1000294001)
+typedef struct VkPresentIdKHR {
+   VkStructureType sType;
+   const void* pNext;
+   uint32_t swapchainCount;
+   const uint64_t* pPresentIds;
+} VkPresentIdKHR;
+typedef struct VkPhysicalDevicePresentIdFeaturesKHR {
+   VkStructureType sType;
+   void* pNext;
+   VkBool32 presentId;
+} VkPhysicalDevicePresentIdFeaturesKHR;
+#endif
+#ifndef VK_KHR_present_wait
+#define VK_KHR_PRESENT_WAIT_EXTENSION_NAME "VK_KHR_present_wait"
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR ((VkStructureType)1000248000)
+typedef struct VkPhysicalDevicePresentWaitFeaturesKHR {
+   VkStructureType sType;
+   void* pNext;
+   VkBool32 presentWait;
+} VkPhysicalDevicePresentWaitFeaturesKHR;
+typedef VkResult (VKAPI_PTR *PFN_vkWaitForPresentKHR)(VkDevice device, VkSwapchainKHR swapchain,
+                                                     uint64_t presentId, uint64_t timeout);
+#endif
+
 #include "overlay.h"
 #include "notify.h"
 #include "blacklist.h"
@@ -102,6 +136,12 @@ struct device_data {
    struct queue_data *graphic_queue;
 
    std::vector<struct queue_data *> queues;
+
+   /* Only when the layer enabled present_wait itself, for present_latency */
+   PFN_vkWaitForPresentKHR WaitForPresentKHR;
+
+   /* VK_EXT_pipeline_creation_feedback is enabled, for pipeline_compiles */
+   bool pipeline_feedback;
 };
 
 /* Mapped from VkCommandBuffer */
@@ -115,6 +155,24 @@ struct command_buffer_data {
    struct queue_data *queue_data;
 };
 
+/* Timestamp queries around the submissions of a queue, for gpu_frametime.
+ * Each slot is a pair of queries with pre-recorded command buffers that reset
+ * and write them, reused once its results were read.
+ */
+static const uint32_t timing_slots = 64;
+
+struct queue_timing {
+   VkCommandPool command_pool;
+   VkQueryPool query_pool;
+   VkCommandBuffer begin[timing_slots];
+   VkCommandBuffer end[timing_slots];
+   uint64_t valid_mask;
+
+   std::mutex mutex;
+   std::deque<std::pair<uint32_t, uint64_t>> in_flight; /* slot and frame, oldest first */
+   uint32_t next_slot;
+};
+
 /* Mapped from VkQueue */
 struct queue_data {
    struct device_data *device;
@@ -122,6 +180,16 @@ struct queue_data {
    VkQueue queue;
    VkQueueFlags flags;
    uint32_t family_index;
+   uint32_t timestamp_valid_bits;
+
+   /* Created on the first submit with gpu_frametime on, read by present */
+   std::atomic<struct queue_timing *> timing;
+   bool timing_tried;
+
+   /* The app's submissions with the timestamps added. Submits to a queue
+    * are externally synchronized, so these are reused without a lock. */
+   std::vector<VkSubmitInfo> submits;
+   std::vector<VkCommandBuffer> first_cmds, last_cmds;
 };
 
 struct overlay_draw {
@@ -139,9 +207,33 @@ struct overlay_draw {
    VkBuffer index_buffer;
    VkDeviceMemory index_buffer_mem;
    VkDeviceSize index_buffer_size;
+
+   /* Around the draw for mangohud_overhead, timed is set while the
+    * timestamps of a submission weren't read yet */
+   VkQueryPool query_pool;
+   bool timed;
 };
 
 /* Mapped from VkSwapchainKHR */
+/* Waits for the present ids of a swapchain on a thread of its own, for
+ * present_latency.
+ *
+ * Waits, presents and acquires all need the swapchain externally
+ * synchronized, so they take swapchain_mutex. A blocking wait would hold
+ * presents back for as long as the frame takes to show, so the waiter
+ * polls with a zero timeout instead and only ever holds the lock for the
+ * poll itself. Displayed times are late by up to one poll interval.
+ */
+struct present_waiter {
+   std::mutex swapchain_mutex;
+   std::mutex mutex;          /* guards ids */
+   std::condition_variable cv;
+   std::deque<uint64_t> ids;  /* presented and not waited on yet, oldest first */
+   std::atomic<bool> quit;
+   uint64_t next_id;          /* only touched by present */
+   std::thread thread;
+};
+
 struct swapchain_data {
    struct device_data *device;
 
@@ -181,6 +273,8 @@ struct swapchain_data {
    ImVec2 window_size;
 
    struct swapchain_stats sw_stats;
+
+   struct present_waiter *present_waiter;
 };
 
 // single global lock, for simplicity
@@ -312,6 +406,7 @@ static struct queue_data *new_queue_data(VkQueue queue,
    data->queue = queue;
    data->flags = family_props->queueFlags;
    data->family_index = family_index;
+   data->timestamp_valid_bits = family_props->timestampValidBits;
    map_object(HKEY(data->queue), data);
 
    if (data->flags & VK_QUEUE_GRAPHICS_BIT)
@@ -320,8 +415,125 @@ static struct queue_data *new_queue_data(VkQueue queue,
    return data;
 }
 
+static void destroy_queue_timing(struct device_data *device_data, struct queue_timing *timing)
+{
+   if (!timing)
+      return;
+
+   /* Destroying the pool frees the command buffers */
+   device_data->vtable.DestroyQueryPool(device_data->device, timing->query_pool, NULL);
+   device_data->vtable.DestroyCommandPool(device_data->device, timing->command_pool, NULL);
+   for (auto& submitted : timing->in_flight)
+      gpu_timing.lost(submitted.second);
+   delete timing;
+}
+
+static struct queue_timing *new_queue_timing(struct queue_data *data)
+{
+   struct device_data *device_data = data->device;
+   struct queue_timing *timing = new queue_timing();
+   timing->valid_mask = data->timestamp_valid_bits >= 64 ?
+      ~0ull : (1ull << data->timestamp_valid_bits) - 1;
+
+   VkCommandPoolCreateInfo pool_info = {};
+   pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+   pool_info.queueFamilyIndex = data->family_index;
+   VkResult result = device_data->vtable.CreateCommandPool(device_data->device, &pool_info,
+                                                           NULL, &timing->command_pool);
+
+   VkQueryPoolCreateInfo query_info = {};
+   query_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+   query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+   query_info.queryCount = 2 * timing_slots;
+   if (result == VK_SUCCESS)
+      result = device_data->vtable.CreateQueryPool(device_data->device, &query_info,
+                                                   NULL, &timing->query_pool);
+
+   VkCommandBufferAllocateInfo cmd_buffer_info = {};
+   cmd_buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+   cmd_buffer_info.commandPool = timing->command_pool;
+   cmd_buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+   cmd_buffer_info.commandBufferCount = timing_slots;
+   if (result == VK_SUCCESS)
+      result = device_data->vtable.AllocateCommandBuffers(device_data->device, &cmd_buffer_info,
+                                                          timing->begin);
+   if (result == VK_SUCCESS)
+      result = device_data->vtable.AllocateCommandBuffers(device_data->device, &cmd_buffer_info,
+                                                          timing->end);
+   if (result != VK_SUCCESS) {
+      SPDLOG_WARN("gpu_frametime: no timestamp queries on queue family {}: {}",
+                  data->family_index, vk_Result_to_str(result));
+      destroy_queue_timing(device_data, timing);
+      return nullptr;
+   }
+
+   /* Simultaneous use as the app's work in the same submission may still be
+    * running when the timestamps are read and the slot is reused */
+   VkCommandBufferBeginInfo begin_info = {};
+   begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+   begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+   for (uint32_t i = 0; i < timing_slots; i++) {
+      VK_CHECK(device_data->set_device_loader_data(device_data->device, timing->begin[i]));
+      VK_CHECK(device_data->set_device_loader_data(device_data->device, timing->end[i]));
+
+      VK_CHECK(device_data->vtable.BeginCommandBuffer(timing->begin[i], &begin_info));
+      device_data->vtable.CmdResetQueryPool(timing->begin[i], timing->query_pool, 2 * i, 2);
+      device_data->vtable.CmdWriteTimestamp(timing->begin[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                            timing->query_pool, 2 * i);
+      VK_CHECK(device_data->vtable.EndCommandBuffer(timing->begin[i]));
+
+      VK_CHECK(device_data->vtable.BeginCommandBuffer(timing->end[i], &begin_info));
+      device_data->vtable.CmdWriteTimestamp(timing->end[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                            timing->query_pool, 2 * i + 1);
+      VK_CHECK(device_data->vtable.EndCommandBuffer(timing->end[i]));
+   }
+
+   data->timing.store(timing, std::memory_order_release);
+   return timing;
+}
+
+/* Hands the timestamps that came back to gpu_timing, never waits */
+static void poll_queue_timing(struct queue_data *data)
+{
+   struct queue_timing *timing = data->timing.load(std::memory_order_acquire);
+   if (!timing)
+      return;
+
+   struct device_data *device_data = data->device;
+   double period = device_data->properties.limits.timestampPeriod;
+   std::lock_guard<std::mutex> lock(timing->mutex);
+   while (!timing->in_flight.empty()) {
+      uint32_t slot = timing->in_flight.front().first;
+      uint64_t frame = timing->in_flight.front().second;
+
+      /* begin, its availability, end, its availability */
+      uint64_t results[4] = {};
+      VkResult result =
+         device_data->vtable.GetQueryPoolResults(device_data->device, timing->query_pool,
+                                                 2 * slot, 2, sizeof(results), results,
+                                                 2 * sizeof(uint64_t),
+                                                 VK_QUERY_RESULT_64_BIT |
+                                                 VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+      if (result == VK_NOT_READY || (result == VK_SUCCESS && !(results[1] && results[3])))
+         break;
+
+      timing->in_flight.pop_front();
+      if (result != VK_SUCCESS) {
+         gpu_timing.lost(frame);
+         continue;
+      }
+
+      /* Past the valid bits the counter wraps */
+      uint64_t begin = results[0] & timing->valid_mask;
+      uint64_t ticks = (results[2] - results[0]) & timing->valid_mask;
+      gpu_timing.completed(frame, uintptr_t(data), uint64_t(begin * period),
+                           uint64_t(begin * period + ticks * period));
+   }
+}
+
 static void destroy_queue(struct queue_data *data)
 {
+   destroy_queue_timing(data->device, data->timing.load());
    unmap_object(HKEY(data->queue));
    delete data;
 }
@@ -406,12 +618,101 @@ static struct swapchain_data *new_swapchain_data(VkSwapchainKHR swapchain,
    return data;
 }
 
+static void present_waiter_thread(struct swapchain_data *data)
+{
+   struct device_data *device_data = data->device;
+   struct present_waiter *waiter = data->present_waiter;
+   const auto poll_interval = std::chrono::microseconds(250);
+
+   while (true) {
+      uint64_t id;
+      {
+         std::unique_lock<std::mutex> lock(waiter->mutex);
+         waiter->cv.wait(lock, [waiter] { return waiter->quit || !waiter->ids.empty(); });
+         if (waiter->quit)
+            return;
+         id = waiter->ids.front();
+      }
+
+      VkResult result;
+      while (true) {
+         {
+            std::lock_guard<std::mutex> lock(waiter->swapchain_mutex);
+            result = device_data->WaitForPresentKHR(device_data->device, data->swapchain, id, 0);
+         }
+         if (result != VK_TIMEOUT || waiter->quit)
+            break;
+         std::this_thread::sleep_for(poll_interval);
+      }
+      uint64_t now = os_time_get_nano();
+
+      if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+         latency_stats.displayed(uintptr_t(data->swapchain), id, now);
+         std::lock_guard<std::mutex> lock(waiter->mutex);
+         while (!waiter->ids.empty() && waiter->ids.front() <= id)
+            waiter->ids.pop_front();
+      } else if (result != VK_TIMEOUT) {
+         /* Out of date or lost, none of these will show */
+         latency_stats.forget(uintptr_t(data->swapchain));
+         std::lock_guard<std::mutex> lock(waiter->mutex);
+         waiter->ids.clear();
+      }
+   }
+}
+
+static void start_present_waiter(struct swapchain_data *data)
+{
+   data->present_waiter = new present_waiter();
+   data->present_waiter->thread = std::thread(present_waiter_thread, data);
+#ifdef __linux__
+   pthread_setname_np(data->present_waiter->thread.native_handle(), "mangohud-pwait");
+#endif
+}
+
+static void stop_present_waiter(struct swapchain_data *data)
+{
+   struct present_waiter *waiter = data->present_waiter;
+   if (!waiter)
+      return;
+
+   {
+      std::lock_guard<std::mutex> lock(waiter->mutex);
+      waiter->quit = true;
+   }
+   waiter->cv.notify_one();
+   waiter->thread.join();
+   latency_stats.forget(uintptr_t(data->swapchain));
+   delete waiter;
+   data->present_waiter = nullptr;
+}
+
 static void destroy_swapchain_data(struct swapchain_data *data)
 {
    unmap_object(HKEY(data->swapchain));
    delete data;
 }
 
+/* Hands the GPU time of a finished draw to overhead_stats */
+static void read_draw_timestamps(struct device_data *device_data, struct overlay_draw *draw)
+{
+   if (!draw->timed)
+      return;
+   draw->timed = false;
+
+   uint64_t results[2] = {};
+   VkResult result =
+      device_data->vtable.GetQueryPoolResults(device_data->device, draw->query_pool,
+                                              0, 2, sizeof(results), results,
+                                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+   if (result != VK_SUCCESS)
+      return;
+
+   uint32_t valid_bits = device_data->graphic_queue->timestamp_valid_bits;
+   uint64_t valid_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+   uint64_t ticks = (results[1] - results[0]) & valid_mask;
+   overhead_stats.gpu(uint64_t(ticks * double(device_data->properties.limits.timestampPeriod)));
+}
+
 static struct overlay_draw *get_overlay_draw(struct swapchain_data *data)
 {
    struct device_data *device_data = data->device;
@@ -424,6 +725,7 @@ static struct overlay_draw *get_overlay_draw(struct swapchain_data *data)
    if (draw && device_data->vtable.GetFenceStatus(device_data->device, draw->fence) == VK_SUCCESS) {
       VK_CHECK(device_data->vtable.ResetFences(device_data->device,
                                                1, &draw->fence));
+      read_draw_timestamps(device_data, draw);
       data->draws.pop_front();
       data->draws.push_back(draw);
       return draw;
@@ -825,6 +1127,26 @@ static struct overlay_draw *render_swapchain_display(struct swapchain_data *data
 
    device_data->vtable.BeginCommandBuffer(draw->command_buffer, &buffer_begin_info);
 
+   /* The submission waits on the app's semaphores at all stages, so the
+    * first timestamp isn't written before the overlay can start */
+   bool timed = device_data->instance->params.enabled[OVERLAY_PARAM_ENABLED_mangohud_overhead] &&
+                device_data->graphic_queue->timestamp_valid_bits;
+   if (timed && draw->query_pool == VK_NULL_HANDLE) {
+      VkQueryPoolCreateInfo query_info = {};
+      query_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+      query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+      query_info.queryCount = 2;
+      if (device_data->vtable.CreateQueryPool(device_data->device, &query_info,
+                                              NULL, &draw->query_pool) != VK_SUCCESS)
+         draw->query_pool = VK_NULL_HANDLE;
+   }
+   timed = timed && draw->query_pool != VK_NULL_HANDLE;
+   if (timed) {
+      device_data->vtable.CmdResetQueryPool(draw->command_buffer, draw->query_pool, 0, 2);
+      device_data->vtable.CmdWriteTimestamp(draw->command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                            draw->query_pool, 0);
+   }
+
    ensure_swapchain_fonts(data, draw->command_buffer);
 
    /* Bounce the image to display back to color attachment layout for
@@ -1009,6 +1331,11 @@ static struct overlay_draw *render_swapchain_display(struct swapchain_data *data
                                              1, &imb);   /* image memory barriers */
    }
 
+   if (timed)
+      device_data->vtable.CmdWriteTimestamp(draw->command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                            draw->query_pool, 1);
+   draw->timed = timed;
+
    device_data->vtable.EndCommandBuffer(draw->command_buffer);
 
    /* When presenting on a different queue than where we're drawing the
@@ -1401,6 +1728,8 @@ static void setup_swapchain_data(struct swapchain_data *data,
                                                       data->images.data()));
 
 
+   blocking_stats.set_swapchain(n_images);
+
    if (n_images != data->images.size()) {
       data->images.resize(n_images);
       data->image_views.resize(n_images);
@@ -1474,6 +1803,7 @@ static void shutdown_swapchain_data(struct swapchain_data *data)
       device_data->vtable.DestroyBuffer(device_data->device, draw->index_buffer, NULL);
       device_data->vtable.FreeMemory(device_data->device, draw->vertex_buffer_mem, NULL);
       device_data->vtable.FreeMemory(device_data->device, draw->index_buffer_mem, NULL);
+      device_data->vtable.DestroyQueryPool(device_data->device, draw->query_pool, NULL);
       delete draw;
    }
 
@@ -1509,10 +1839,17 @@ static struct overlay_draw *before_present(struct swapchain_data *swapchain_data
 {
    struct overlay_draw *draw = NULL;
 
-   snapshot_swapchain_frame(swapchain_data);
+   {
+      overlay_cost_scope scope(overhead_stats, COST_UPDATE);
+      snapshot_swapchain_frame(swapchain_data);
+   }
 
    if (swapchain_data->sw_stats.n_frames > 0) {
-      compute_swapchain_display(swapchain_data);
+      {
+         overlay_cost_scope scope(overhead_stats, COST_BUILD);
+         compute_swapchain_display(swapchain_data);
+      }
+      overlay_cost_scope scope(overhead_stats, COST_DRAW);
       draw = render_swapchain_display(swapchain_data, present_queue,
                                       wait_semaphores, n_wait_semaphores,
                                       imageIndex);
@@ -1575,6 +1912,8 @@ static VkResult overlay_CreateSwapchainKHR(
    if (result != VK_SUCCESS) return result;
    struct swapchain_data *swapchain_data = new_swapchain_data(*pSwapchain, device_data);
    setup_swapchain_data(swapchain_data, pCreateInfo);
+   if (device_data->WaitForPresentKHR)
+      start_present_waiter(swapchain_data);
 
    const VkPhysicalDeviceProperties& prop = device_data->properties;
    swapchain_data->sw_stats.version_vk.major = VK_VERSION_MAJOR(prop.apiVersion);
@@ -1630,6 +1969,7 @@ static void overlay_DestroySwapchainKHR(
    struct swapchain_data *swapchain_data =
       FIND(struct swapchain_data, swapchain);
 
+   stop_present_waiter(swapchain_data);
    shutdown_swapchain_data(swapchain_data);
    swapchain_data->device->vtable.DestroySwapchainKHR(device, swapchain, pAllocator);
    destroy_swapchain_data(swapchain_data);
@@ -1644,8 +1984,12 @@ static VkResult overlay_QueuePresentKHR(
       fps_limit_stats.frameStart = Clock::now();
       FpsLimiter(fps_limit_stats);
       fps_limit_stats.frameEnd = Clock::now();
+      blocking_stats.add(BLOCK_LIMITER, std::chrono::duration_cast<std::chrono::nanoseconds>(
+         fps_limit_stats.frameEnd - fps_limit_stats.frameStart).count());
    }
 
+   /* When the app presented, the overlay is drawn after */
+   uint64_t present_ns = os_time_get_nano();
    struct queue_data *queue_data = FIND(struct queue_data, queue);
 
    /* Otherwise we need to add our overlay drawing semaphore to the list of
@@ -1665,6 +2009,19 @@ static VkResult overlay_QueuePresentKHR(
       present_info.pSwapchains = &swapchain;
       present_info.pImageIndices = &image_index;
 
+      /* The app can't use present ids, only we enabled them */
+      struct present_waiter *waiter = swapchain_data->present_waiter;
+      VkPresentIdKHR present_id = {};
+      uint64_t id = 0;
+      if (waiter) {
+         id = ++waiter->next_id;
+         present_id.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+         present_id.pNext = present_info.pNext;
+         present_id.swapchainCount = 1;
+         present_id.pPresentIds = &id;
+         present_info.pNext = &present_id;
+      }
+
       struct overlay_draw *draw = before_present(swapchain_data,
                                                    queue_data,
                                                    pPresentInfo->pWaitSemaphores,
@@ -1681,19 +2038,92 @@ static VkResult overlay_QueuePresentKHR(
          present_info.waitSemaphoreCount = 1;
       }
 
-      VkResult chain_result = queue_data->device->vtable.QueuePresentKHR(queue, &present_info);
+      /* The wait for a free image shows here with FIFO, and so does the
+       * time spent in the layers below us */
+      uint64_t present_start = os_time_get_nano();
+      VkResult chain_result;
+      if (waiter) {
+         std::lock_guard<std::mutex> lock(waiter->swapchain_mutex);
+         chain_result = queue_data->device->vtable.QueuePresentKHR(queue, &present_info);
+      } else {
+         chain_result = queue_data->device->vtable.QueuePresentKHR(queue, &present_info);
+      }
+      blocking_stats.add(BLOCK_PRESENT, os_time_get_nano() - present_start);
+
+      if (waiter && (chain_result == VK_SUCCESS || chain_result == VK_SUBOPTIMAL_KHR)) {
+         latency_stats.presented(uintptr_t(swapchain), id, present_ns);
+         {
+            std::lock_guard<std::mutex> lock(waiter->mutex);
+            waiter->ids.push_back(id);
+            /* Not shown for long, minimized maybe */
+            if (waiter->ids.size() > present_latency_stats::max_pending)
+               waiter->ids.pop_front();
+         }
+         waiter->cv.notify_one();
+      }
       if (pPresentInfo->pResults)
          pPresentInfo->pResults[i] = chain_result;
       if (chain_result != VK_SUCCESS && result == VK_SUCCESS)
          result = chain_result;
    }
 
+   /* Submissions from here on are the next frame's */
+   gpu_timing.presented();
+   for (auto q : queue_data->device->queues)
+      poll_queue_timing(q);
+
    if (fps_limit_stats.targetFrameTime > 0s && fps_limit_stats.method == FPS_LIMIT_METHOD_LATE){
       fps_limit_stats.frameStart = Clock::now();
       FpsLimiter(fps_limit_stats);
       fps_limit_stats.frameEnd = Clock::now();
+      blocking_stats.add(BLOCK_LIMITER, std::chrono::duration_cast<std::chrono::nanoseconds>(
+         fps_limit_stats.frameEnd - fps_limit_stats.frameStart).count());
    }
 
+   blocking_stats.end_frame(os_time_get_nano());
+   overhead_stats.end_frame();
+
+   return result;
+}
+
+static VkResult overlay_AcquireNextImageKHR(
+    VkDevice                                    device,
+    VkSwapchainKHR                              swapchain,
+    uint64_t                                    timeout,
+    VkSemaphore                                 semaphore,
+    VkFence                                     fence,
+    uint32_t*                                   pImageIndex)
+{
+   struct device_data *device_data = FIND(struct device_data, device);
+   struct swapchain_data *swapchain_data = FIND(struct swapchain_data, swapchain);
+   struct present_waiter *waiter = swapchain_data->present_waiter;
+
+   uint64_t start = os_time_get_nano();
+   VkResult result;
+   if (waiter) {
+      std::lock_guard<std::mutex> lock(waiter->swapchain_mutex);
+      result = device_data->vtable.AcquireNextImageKHR(device, swapchain, timeout,
+                                                       semaphore, fence, pImageIndex);
+   } else {
+      result = device_data->vtable.AcquireNextImageKHR(device, swapchain, timeout,
+                                                       semaphore, fence, pImageIndex);
+   }
+   blocking_stats.add(BLOCK_ACQUIRE, os_time_get_nano() - start);
+   return result;
+}
+
+static VkResult overlay_WaitForFences(
+    VkDevice                                    device,
+    uint32_t                                    fenceCount,
+    const VkFence*                              pFences,
+    VkBool32                                    waitAll,
+    uint64_t                                    timeout)
+{
+   struct device_data *device_data = FIND(struct device_data, device);
+
+   uint64_t start = os_time_get_nano();
+   VkResult result = device_data->vtable.WaitForFences(device, fenceCount, pFences, waitAll, timeout);
+   blocking_stats.add(BLOCK_FENCE, os_time_get_nano() - start);
    return result;
 }
 
@@ -1785,6 +2215,36 @@ static void overlay_FreeCommandBuffers(
                                           commandBufferCount, pCommandBuffers);
 }
 
+/* Other structs in the chain may have arrays per command buffer that would
+ * need the timestamps too, or need protected command buffers */
+static bool can_time_submit(const VkSubmitInfo *submit)
+{
+   vk_foreach_struct_const(item, submit->pNext) {
+      if (item->sType != VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO &&
+          item->sType != VK_STRUCTURE_TYPE_PERFORMANCE_QUERY_SUBMIT_INFO_KHR)
+         return false;
+   }
+   return true;
+}
+
+/* Only graphics and compute queues with timestamps are timed, transfers
+ * alone don't make a frame GPU-bound */
+static struct queue_timing *get_queue_timing(struct queue_data *data)
+{
+   struct instance_data *instance_data = data->device->instance;
+   if (!instance_data->params.enabled[OVERLAY_PARAM_ENABLED_gpu_frametime])
+      return nullptr;
+
+   struct queue_timing *timing = data->timing.load(std::memory_order_acquire);
+   if (timing || data->timing_tried)
+      return timing;
+
+   data->timing_tried = true;
+   if (!(data->flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) || !data->timestamp_valid_bits)
+      return nullptr;
+   return new_queue_timing(data);
+}
+
 static VkResult overlay_QueueSubmit(
     VkQueue                                     queue,
     uint32_t                                    submitCount,
@@ -1794,7 +2254,63 @@ static VkResult overlay_QueueSubmit(
    struct queue_data *queue_data = FIND(struct queue_data, queue);
    struct device_data *device_data = queue_data->device;
 
-   return device_data->vtable.QueueSubmit(queue, submitCount, pSubmits, fence);
+   poll_queue_timing(queue_data);
+   struct queue_timing *timing = get_queue_timing(queue_data);
+
+   /* The timestamps go before the first and after the last command buffer of
+    * the submission, batches in between run in submission order anyway */
+   int first = -1, last = -1;
+   for (uint32_t i = 0; timing && i < submitCount; i++) {
+      if (!can_time_submit(&pSubmits[i]))
+         timing = nullptr;
+      else if (pSubmits[i].commandBufferCount) {
+         if (first < 0)
+            first = i;
+         last = i;
+      }
+   }
+
+   uint32_t slot = 0;
+   if (timing && first >= 0) {
+      std::lock_guard<std::mutex> lock(timing->mutex);
+      /* Out of slots until the oldest one is read */
+      if (!timing->in_flight.empty() && timing->in_flight.front().first == timing->next_slot)
+         timing = nullptr;
+      else
+         slot = timing->next_slot;
+   }
+   if (!timing || first < 0)
+      return device_data->vtable.QueueSubmit(queue, submitCount, pSubmits, fence);
+
+   std::vector<VkSubmitInfo>& submits = queue_data->submits;
+   std::vector<VkCommandBuffer>& first_cmds = queue_data->first_cmds;
+   std::vector<VkCommandBuffer>& last_cmds = queue_data->last_cmds;
+   submits.assign(pSubmits, pSubmits + submitCount);
+   first_cmds.assign(1, timing->begin[slot]);
+   first_cmds.insert(first_cmds.end(), pSubmits[first].pCommandBuffers,
+                     pSubmits[first].pCommandBuffers + pSubmits[first].commandBufferCount);
+   std::vector<VkCommandBuffer>& end_cmds = first == last ? first_cmds : last_cmds;
+   if (first != last)
+      last_cmds.assign(pSubmits[last].pCommandBuffers,
+                       pSubmits[last].pCommandBuffers + pSubmits[last].commandBufferCount);
+   end_cmds.push_back(timing->end[slot]);
+
+   submits[first].commandBufferCount = first_cmds.size();
+   submits[first].pCommandBuffers = first_cmds.data();
+   submits[last].commandBufferCount = end_cmds.size();
+   submits[last].pCommandBuffers = end_cmds.data();
+
+   uint64_t frame = gpu_timing.submitting();
+   VkResult result = device_data->vtable.QueueSubmit(queue, submitCount, submits.data(), fence);
+   if (result != VK_SUCCESS) {
+      gpu_timing.lost(frame);
+      return result;
+   }
+
+   std::lock_guard<std::mutex> lock(timing->mutex);
+   timing->in_flight.push_back({slot, frame});
+   timing->next_slot = (slot + 1) % timing_slots;
+   return result;
 }
 
 static VkResult overlay_CreateDevice(
@@ -1851,12 +2367,74 @@ static VkResult overlay_CreateDevice(
       FOUND:;
    }
 
-   VkResult result = fpCreateDevice(physicalDevice, pCreateInfo, pAllocator, pDevice);
+   std::vector<const char*> layer_extensions;
+
+   /* Present ids and waits tell when frames reach the screen. Apps that use
+    * them already are left alone, our ids and waits would mix with theirs. */
+   VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {};
+   present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+   VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {};
+   present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+   bool present_wait = instance_data->params.enabled[OVERLAY_PARAM_ENABLED_present_latency] &&
+                       instance_data->api_version >= VK_API_VERSION_1_1 && !is_blacklisted();
+   for (const char *ext : { VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME }) {
+      bool available = false;
+      for (auto& extension : available_extensions)
+         available |= extension.extensionName == std::string(ext);
+      for (auto& enabled : enabled_extensions)
+         available &= enabled != std::string(ext);
+      present_wait &= available;
+   }
+   if (present_wait) {
+      present_id_features.pNext = &present_wait_features;
+      VkPhysicalDeviceFeatures2 features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &present_id_features};
+      instance_data->vtable.GetPhysicalDeviceFeatures2(physicalDevice, &features);
+      present_wait = present_id_features.presentId && present_wait_features.presentWait;
+   }
+
+   /* Creation feedback tells pipeline cache hits from misses, chaining it
+    * is fine when the app enabled the extension too */
+   bool pipeline_feedback = instance_data->params.enabled[OVERLAY_PARAM_ENABLED_pipeline_compiles] &&
+                            !is_blacklisted();
+   if (pipeline_feedback) {
+      bool available = false, enabled = false;
+      for (auto& extension : available_extensions)
+         available |= extension.extensionName == std::string(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+      for (auto& ext : enabled_extensions)
+         enabled |= ext == std::string(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+      if (available && !enabled)
+         layer_extensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+      pipeline_feedback = available || enabled;
+   }
+
+   VkDeviceCreateInfo create_info = *pCreateInfo;
+   if (present_wait) {
+      layer_extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+      layer_extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+      present_wait_features.pNext = const_cast<void *>(create_info.pNext);
+      create_info.pNext = &present_id_features;
+   }
+
+   /* Only what the app asked for plus what the layer itself needs */
+   std::vector<const char*> create_extensions(pCreateInfo->ppEnabledExtensionNames,
+                                              pCreateInfo->ppEnabledExtensionNames +
+                                              pCreateInfo->enabledExtensionCount);
+   if (!layer_extensions.empty()) {
+      create_extensions.insert(create_extensions.end(), layer_extensions.begin(), layer_extensions.end());
+      create_info.enabledExtensionCount = create_extensions.size();
+      create_info.ppEnabledExtensionNames = create_extensions.data();
+   }
+
+   VkResult result = fpCreateDevice(physicalDevice, &create_info, pAllocator, pDevice);
    if (result != VK_SUCCESS) return result;
 
    struct device_data *device_data = new_device_data(*pDevice, instance_data);
    device_data->physical_device = physicalDevice;
+   device_data->pipeline_feedback = pipeline_feedback;
    vk_load_device_commands(*pDevice, fpGetDeviceProcAddr, &device_data->vtable);
+   if (present_wait)
+      device_data->WaitForPresentKHR =
+         (PFN_vkWaitForPresentKHR)fpGetDeviceProcAddr(*pDevice, "vkWaitForPresentKHR");
 
    instance_data->vtable.GetPhysicalDeviceProperties(device_data->physical_device,
                                                      &device_data->properties);
@@ -2032,6 +2610,155 @@ static VkResult overlay_CreateSampler(
 	return result;
 }
 
+/* Creation feedback of the pipelines of one vkCreate*Pipelines call, for
+ * pipeline_compiles. An app asking for feedback itself keeps its own, we
+ * read it after the call. */
+struct pipeline_creation_feedback {
+   std::vector<VkPipelineCreationFeedbackCreateInfoEXT> chained;
+   std::vector<VkPipelineCreationFeedbackEXT> pipelines;
+   std::vector<VkPipelineCreationFeedbackEXT> stages;
+   std::vector<const VkPipelineCreationFeedbackEXT *> results;
+};
+
+static uint32_t pipeline_stage_count(const VkGraphicsPipelineCreateInfo& info)
+{
+   return info.stageCount;
+}
+
+static uint32_t pipeline_stage_count(const VkComputePipelineCreateInfo&)
+{
+   return 1;
+}
+
+template <typename CreateInfo>
+static void chain_pipeline_feedback(std::vector<CreateInfo>& infos,
+                                    struct pipeline_creation_feedback& feedback)
+{
+   /* Sized up front, the chains point into them */
+   uint32_t n_stages = 0;
+   for (auto& info : infos)
+      n_stages += pipeline_stage_count(info);
+   feedback.chained.resize(infos.size());
+   feedback.pipelines.resize(infos.size());
+   feedback.stages.resize(n_stages);
+   feedback.results.resize(infos.size());
+
+   uint32_t stage = 0;
+   for (size_t i = 0; i < infos.size(); i++) {
+      auto app = (const VkPipelineCreationFeedbackCreateInfoEXT *)
+         vk_find_struct_const(infos[i].pNext, PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT);
+      if (app) {
+         feedback.results[i] = app->pPipelineCreationFeedback;
+         continue;
+      }
+
+      /* One per stage, drivers may not take fewer */
+      uint32_t n = pipeline_stage_count(infos[i]);
+      VkPipelineCreationFeedbackCreateInfoEXT& chained = feedback.chained[i];
+      chained.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+      chained.pNext = infos[i].pNext;
+      chained.pPipelineCreationFeedback = &feedback.pipelines[i];
+      chained.pipelineStageCreationFeedbackCount = n;
+      chained.pPipelineStageCreationFeedbacks = n ? &feedback.stages[stage] : nullptr;
+      stage += n;
+      infos[i].pNext = &chained;
+      feedback.results[i] = &feedback.pipelines[i];
+   }
+}
+
+static void add_pipeline_compiles(uint64_t ns, VkResult result, uint32_t count,
+                                  const VkPipeline *pipelines,
+                                  const struct pipeline_creation_feedback& feedback)
+{
+   uint32_t created = 0, hits = 0, misses = 0;
+   /* VK_PIPELINE_COMPILE_REQUIRED_EXT succeeds with some left out */
+   for (uint32_t i = 0; result >= VK_SUCCESS && i < count; i++) {
+      if (pipelines[i] == VK_NULL_HANDLE)
+         continue;
+      created++;
+
+      const VkPipelineCreationFeedbackEXT *pipeline =
+         i < feedback.results.size() ? feedback.results[i] : nullptr;
+      if (!pipeline || !(pipeline->flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT))
+         continue;
+      if (pipeline->flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT)
+         hits++;
+      else
+         misses++;
+   }
+   compile_stats.add_pipelines(ns, created, hits, misses);
+}
+
+static VkResult overlay_CreateGraphicsPipelines(
+    VkDevice                                    device,
+    VkPipelineCache                             pipelineCache,
+    uint32_t                                    createInfoCount,
+    const VkGraphicsPipelineCreateInfo*         pCreateInfos,
+    const VkAllocationCallbacks*                pAllocator,
+    VkPipeline*                                 pPipelines)
+{
+   struct device_data *device_data = FIND(struct device_data, device);
+
+   std::vector<VkGraphicsPipelineCreateInfo> infos;
+   struct pipeline_creation_feedback feedback;
+   if (device_data->pipeline_feedback &&
+       device_data->instance->params.enabled[OVERLAY_PARAM_ENABLED_pipeline_compiles]) {
+      infos.assign(pCreateInfos, pCreateInfos + createInfoCount);
+      chain_pipeline_feedback(infos, feedback);
+      pCreateInfos = infos.data();
+   }
+
+   uint64_t start = os_time_get_nano();
+   VkResult result = device_data->vtable.CreateGraphicsPipelines(device, pipelineCache,
+                                                                 createInfoCount, pCreateInfos,
+                                                                 pAllocator, pPipelines);
+   add_pipeline_compiles(os_time_get_nano() - start, result, createInfoCount, pPipelines, feedback);
+   return result;
+}
+
+static VkResult overlay_CreateComputePipelines(
+    VkDevice                                    device,
+    VkPipelineCache                             pipelineCache,
+    uint32_t                                    createInfoCount,
+    const VkComputePipelineCreateInfo*          pCreateInfos,
+    const VkAllocationCallbacks*                pAllocator,
+    VkPipeline*                                 pPipelines)
+{
+   struct device_data *device_data = FIND(struct device_data, device);
+
+   std::vector<VkComputePipelineCreateInfo> infos;
+   struct pipeline_creation_feedback feedback;
+   if (device_data->pipeline_feedback &&
+       device_data->instance->params.enabled[OVERLAY_PARAM_ENABLED_pipeline_compiles]) {
+      infos.assign(pCreateInfos, pCreateInfos + createInfoCount);
+      chain_pipeline_feedback(infos, feedback);
+      pCreateInfos = infos.data();
+   }
+
+   uint64_t start = os_time_get_nano();
+   VkResult result = device_data->vtable.CreateComputePipelines(device, pipelineCache,
+                                                                createInfoCount, pCreateInfos,
+                                                                pAllocator, pPipelines);
+   add_pipeline_compiles(os_time_get_nano() - start, result, createInfoCount, pPipelines, feedback);
+   return result;
+}
+
+/* Drivers mostly just keep the SPIR-V here, some translate it already */
+static VkResult overlay_CreateShaderModule(
+    VkDevice                                    device,
+    const VkShaderModuleCreateInfo*             pCreateInfo,
+    const VkAllocationCallbacks*                pAllocator,
+    VkShaderModule*                             pShaderModule)
+{
+   struct device_data *device_data = FIND(struct device_data, device);
+
+   uint64_t start = os_time_get_nano();
+   VkResult result = device_data->vtable.CreateShaderModule(device, pCreateInfo, pAllocator,
+                                                            pShaderModule);
+   compile_stats.add_shaders(os_time_get_nano() - start, result == VK_SUCCESS);
+   return result;
+}
+
 static void overlay_DestroyInstance(
     VkInstance                                  instance,
     const VkAllocationCallbacks*                pAllocator)
@@ -2089,10 +2816,15 @@ static const struct {
 #endif
    ADD_HOOK(CreateSwapchainKHR),
    ADD_HOOK(QueuePresentKHR),
+   ADD_HOOK(AcquireNextImageKHR),
    ADD_HOOK(DestroySwapchainKHR),
    ADD_HOOK(CreateSampler),
+   ADD_HOOK(CreateGraphicsPipelines),
+   ADD_HOOK(CreateComputePipelines),
+   ADD_HOOK(CreateShaderModule),
 
    ADD_HOOK(QueueSubmit),
+   ADD_HOOK(WaitForFences),
 
    ADD_HOOK(CreateDevice),
    ADD_HOOK(DestroyDevice),
@@ -0,0 +1,193 @@
+// Measures what fpsMetrics::update() costs the present thread per frame,
+// next to the mutex and vector it used before, while the metrics thread
+// recalculates every sampling period the way the HUD makes it.
+//
+// Frames are paced by spinning so the ratio of frames to recalculations
+// matches a game running at --fps, e.g.
+//
+//   bench_fps_metrics --fps=2000 --seconds=5
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+
+#include "../src/fps_metrics.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+// fpsMetrics before the SPSC ring: every frame takes the lock the metrics
+// thread holds while it copies and sorts, and erases from the front once
+// the window is full
+class locked_fps_window {
+public:
+    locked_fps_window() : thread(&locked_fps_window::run, this) {}
+
+    ~locked_fps_window() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            terminate = true;
+            pending = true;
+        }
+        cv.notify_one();
+        thread.join();
+    }
+
+    void update(float frametime) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (frametimes.size() >= max_size)
+            frametimes.erase(frametimes.begin());
+
+        frametimes.push_back(frametime);
+    }
+
+    void update_thread() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            pending = true;
+        }
+        cv.notify_one();
+    }
+
+private:
+    void run() {
+        while (true) {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this] { return pending; });
+
+            if (terminate)
+                break;
+
+            std::vector<float> sorted = frametimes;
+            std::sort(sorted.begin(), sorted.end(), std::greater<float>());
+            pending = false;
+        }
+    }
+
+    std::vector<float> frametimes;
+    const size_t max_size = 10000;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool pending = false;
+    bool terminate = false;
+    std::thread thread;
+};
+
+struct options {
+    unsigned fps = 2000;
+    unsigned seconds = 3;
+    unsigned sampling_period_ms = 500;
+};
+
+struct result {
+    uint64_t frames;
+    double mean_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+};
+
+static options opts;
+
+template <typename Window>
+static result run(Window& window) {
+    const auto frame_time = std::chrono::nanoseconds(1000000000ull / opts.fps);
+    const auto period = std::chrono::milliseconds(opts.sampling_period_ms);
+    const uint64_t frames = uint64_t(opts.fps) * opts.seconds;
+
+    std::vector<uint64_t> costs;
+    costs.reserve(frames);
+
+    auto next_frame = bench_clock::now();
+    auto next_period = next_frame + period;
+
+    for (uint64_t i = 0; i < frames; i++) {
+        while (bench_clock::now() < next_frame) {}
+        next_frame += frame_time;
+
+        // Something that looks like frametimes, with the odd stutter
+        float frametime = 1000.f / opts.fps * (i % 97 ? 1.f + (i % 7) / 10.f : 4.f);
+
+        auto start = bench_clock::now();
+        window.update(frametime);
+        costs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - start).count());
+
+        if (start >= next_period) {
+            window.update_thread();
+            next_period += period;
+        }
+    }
+
+    result r = {};
+    r.frames = costs.size();
+    for (uint64_t c : costs)
+        r.mean_ns += c;
+    r.mean_ns /= costs.size();
+
+    std::sort(costs.begin(), costs.end());
+    r.p50_ns = costs[costs.size() / 2];
+    r.p99_ns = costs[std::min<size_t>(costs.size() * 0.99, costs.size() - 1)];
+    r.p999_ns = costs[std::min<size_t>(costs.size() * 0.999, costs.size() - 1)];
+    r.max_ns = costs.back();
+    return r;
+}
+
+static void print(const char* name, const result& r) {
+    printf("%-10s  %8" PRIu64 "  %7.1f  %7" PRIu64 "  %7" PRIu64 "  %8" PRIu64 "  %8" PRIu64 "\n",
+           name, r.frames, r.mean_ns, r.p50_ns, r.p99_ns, r.p999_ns, r.max_ns);
+}
+
+static bool parse_options(int argc, char** argv) {
+    static const option long_opts[] = {
+        { "fps",             required_argument, nullptr, 'f' },
+        { "seconds",         required_argument, nullptr, 's' },
+        { "sampling-period", required_argument, nullptr, 'p' },
+        { nullptr, 0, nullptr, 0 },
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "", long_opts, nullptr)) != -1) {
+        switch (c) {
+        case 'f': opts.fps = std::max(1ul, strtoul(optarg, nullptr, 10)); break;
+        case 's': opts.seconds = std::max(1ul, strtoul(optarg, nullptr, 10)); break;
+        case 'p': opts.sampling_period_ms = std::max(1ul, strtoul(optarg, nullptr, 10)); break;
+        default:
+            fprintf(stderr, "Usage: %s [--fps=N] [--seconds=S] [--sampling-period=MS]\n", argv[0]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (!parse_options(argc, argv))
+        return 1;
+
+    printf("update() cost in ns at %u fps for %u s, recalculating every %u ms\n\n",
+           opts.fps, opts.seconds, opts.sampling_period_ms);
+    printf("window        frames     mean      p50      p99     p99.9       max\n");
+
+    {
+        locked_fps_window window;
+        print("locked", run(window));
+    }
+
+    {
+        fpsMetrics window({ "avg", "0.01", "0.001" });
+        print("spsc ring", run(window));
+    }
+
+    return 0;
+}
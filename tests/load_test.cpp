@@ -0,0 +1,314 @@
+// Runs N clients against mock_server and reports what the transport costs
+// them: CPU time of everything but the thread reading the metrics, latency
+// from the server stamping a sample to the client seeing it, how long
+// reconnects leave the HUD without metrics and how much history it got.
+//
+// Every client is its own process with the real server_connection.cpp,
+// built with TEST_ONLY so it doesn't need a HUD. Arguments after -- go to
+// the mock server, e.g.
+//
+//   load_test --server=./mock_server --clients=16 -- --no-shm --hup-every=2000
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/server_connection.hpp"
+#include "server_connection_test.hpp"
+
+struct options {
+    std::string server;
+    std::vector<std::string> server_args;
+    unsigned clients = 4;
+    unsigned duration_s = 5;
+    unsigned interval_ms = 10;
+    unsigned late_server_ms = 0;  // start the server after the clients
+    bool verbose = false;
+};
+
+struct client_report {
+    uint64_t samples;
+    uint64_t latency_p50_us;
+    uint64_t latency_p99_us;
+    uint64_t latency_max_us;
+    double cpu_ms;
+    uint64_t first_metrics_ms;
+    uint32_t reconnects;
+    uint64_t reconnect_avg_ms;
+    uint64_t reconnect_max_ms;
+    uint64_t history_samples;  // over all connections
+};
+
+static options opts;
+
+static double cpu_ms(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static uint64_t percentile(std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty())
+        return 0;
+
+    return sorted[std::min<size_t>(sorted.size() * p, sorted.size() - 1)];
+}
+
+// Child process: poll latest_metrics() the way the HUD would, only much
+// more often, so we notice new samples within ~100 us
+static client_report run_client(const std::string& socket_path) {
+    client_report report = {};
+    std::vector<uint64_t> latencies;
+    std::vector<uint64_t> reconnects;
+    std::vector<metrics_sample> history;
+
+    setenv("MANGOHUD_SERVER_SOCKET", socket_path.c_str(), 1);
+
+    uint64_t start = metrics_clock_ns();
+    uint64_t end = start + opts.duration_s * 1000000000ull;
+    uint64_t last_sample = 0, lost_at = 0;
+    bool seen_metrics = false;
+
+    setup_connection_to_server();
+    set_server_interval(opts.interval_ms);
+
+    double own_cpu_start = cpu_ms(CLOCK_THREAD_CPUTIME_ID);
+
+    for (uint64_t now = start; now < end; now = metrics_clock_ns()) {
+        if (take_metrics_history(history))
+            report.history_samples += history.size();
+
+        metrics_view metrics = latest_metrics();
+        uint64_t sample_time = metrics.sample_time_ns;
+        bool has_gpus = metrics->num_of_gpus > 0;
+
+        if (!metrics.valid() || sample_time == last_sample) {
+            usleep(100);
+            continue;
+        }
+
+        last_sample = sample_time;
+
+        // A disconnect publishes an empty message
+        if (!has_gpus) {
+            if (seen_metrics && !lost_at)
+                lost_at = now;
+            continue;
+        }
+
+        if (!seen_metrics) {
+            seen_metrics = true;
+            report.first_metrics_ms = (now - start) / 1000000;
+        }
+
+        if (lost_at) {
+            reconnects.push_back(now - lost_at);
+            lost_at = 0;
+        }
+
+        if (now >= sample_time)
+            latencies.push_back((now - sample_time) / 1000);
+    }
+
+    double own_cpu = cpu_ms(CLOCK_THREAD_CPUTIME_ID) - own_cpu_start;
+
+    std::sort(latencies.begin(), latencies.end());
+    report.samples = latencies.size();
+    report.latency_p50_us = percentile(latencies, 0.5);
+    report.latency_p99_us = percentile(latencies, 0.99);
+    report.latency_max_us = latencies.empty() ? 0 : latencies.back();
+    report.cpu_ms = cpu_ms(CLOCK_PROCESS_CPUTIME_ID) - own_cpu;
+
+    report.reconnects = reconnects.size();
+    for (uint64_t r : reconnects) {
+        report.reconnect_avg_ms += r / 1000000;
+        report.reconnect_max_ms = std::max<uint64_t>(report.reconnect_max_ms, r / 1000000);
+    }
+    if (!reconnects.empty())
+        report.reconnect_avg_ms /= reconnects.size();
+
+    return report;
+}
+
+static pid_t start_server(const std::string& socket_path) {
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    std::string socket_arg = "--socket=" + socket_path;
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(opts.server.c_str()));
+    argv.push_back(const_cast<char*>(socket_arg.c_str()));
+    if (opts.verbose)
+        argv.push_back(const_cast<char*>("--verbose"));
+    for (std::string& arg : opts.server_args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    execv(argv[0], argv.data());
+    perror("load_test: can't run mock server");
+    _exit(1);
+}
+
+static bool wait_for_path(const std::string& path, unsigned timeout_ms) {
+    struct stat st;
+    for (unsigned waited = 0; waited < timeout_ms; waited += 10) {
+        if (stat(path.c_str(), &st) == 0)
+            return true;
+        usleep(10000);
+    }
+    return false;
+}
+
+static bool parse_options(int argc, char** argv) {
+    static const option long_opts[] = {
+        { "server",      required_argument, nullptr, 's' },
+        { "clients",     required_argument, nullptr, 'c' },
+        { "duration",    required_argument, nullptr, 'd' },
+        { "interval",    required_argument, nullptr, 'i' },
+        { "late-server", required_argument, nullptr, 'l' },
+        { "verbose",     no_argument,       nullptr, 'v' },
+        { nullptr, 0, nullptr, 0 },
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "", long_opts, nullptr)) != -1) {
+        switch (c) {
+        case 's': opts.server = optarg; break;
+        case 'c': opts.clients = std::max(1ul, strtoul(optarg, nullptr, 10)); break;
+        case 'd': opts.duration_s = std::max(1ul, strtoul(optarg, nullptr, 10)); break;
+        case 'i': opts.interval_ms = std::max(1ul, strtoul(optarg, nullptr, 10)); break;
+        case 'l': opts.late_server_ms = strtoul(optarg, nullptr, 10); break;
+        case 'v': opts.verbose = true; break;
+        default:
+            fprintf(stderr,
+                "Usage: %s --server=PATH [--clients=N] [--duration=S] [--interval=MS]\n"
+                "       [--late-server=MS] [--verbose] [-- mock server options]\n", argv[0]);
+            return false;
+        }
+    }
+
+    for (int i = optind; i < argc; i++)
+        opts.server_args.push_back(argv[i]);
+
+    if (opts.server.empty()) {
+        fprintf(stderr, "load_test: --server is required\n");
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (!parse_options(argc, argv))
+        return 1;
+
+    char dir[] = "/tmp/mangohud-load-test-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("load_test: mkdtemp");
+        return 1;
+    }
+    std::string socket_path = std::string(dir) + "/mangohud-server.sock";
+
+    pid_t server = -1;
+    if (!opts.late_server_ms) {
+        server = start_server(socket_path);
+        if (!wait_for_path(socket_path, 5000)) {
+            fprintf(stderr, "load_test: mock server didn't come up\n");
+            kill(server, SIGTERM);
+            return 1;
+        }
+    }
+
+    struct child {
+        pid_t pid;
+        int fd;
+    };
+    std::vector<child> children;
+
+    for (unsigned i = 0; i < opts.clients; i++) {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            perror("load_test: pipe");
+            return 1;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+
+            // The connection thread logs to stdout, keep it out of the report
+            if (!opts.verbose) {
+                int null = open("/dev/null", O_WRONLY);
+                dup2(null, STDOUT_FILENO);
+                dup2(null, STDERR_FILENO);
+            }
+
+            client_report report = run_client(socket_path);
+            ssize_t ret = write(fds[1], &report, sizeof(report));
+            _exit(ret == sizeof(report) ? 0 : 1);
+        }
+
+        close(fds[1]);
+        children.push_back({ pid, fds[0] });
+    }
+
+    if (opts.late_server_ms) {
+        usleep(opts.late_server_ms * 1000);
+        server = start_server(socket_path);
+    }
+
+    printf("%u clients for %u s, sampling every %u ms\n\n", opts.clients, opts.duration_s, opts.interval_ms);
+    printf("client  samples  lat p50 us  lat p99 us  lat max us  cpu ms  first ms  reconnects  avg ms  max ms  history\n");
+
+    int failed = 0;
+    client_report total = {};
+
+    for (size_t i = 0; i < children.size(); i++) {
+        client_report r = {};
+        ssize_t len = read(children[i].fd, &r, sizeof(r));
+        close(children[i].fd);
+        waitpid(children[i].pid, nullptr, 0);
+
+        if (len != sizeof(r) || r.samples == 0) {
+            printf("%6zu  no metrics\n", i);
+            failed++;
+            continue;
+        }
+
+        printf("%6zu  %7" PRIu64 "  %10" PRIu64 "  %10" PRIu64 "  %10" PRIu64 "  %6.1f  %8" PRIu64 "  %10u  %6" PRIu64 "  %6" PRIu64 "  %7" PRIu64 "\n",
+               i, r.samples, r.latency_p50_us, r.latency_p99_us, r.latency_max_us, r.cpu_ms,
+               r.first_metrics_ms, r.reconnects, r.reconnect_avg_ms, r.reconnect_max_ms, r.history_samples);
+
+        total.samples += r.samples;
+        total.cpu_ms += r.cpu_ms;
+        total.latency_max_us = std::max(total.latency_max_us, r.latency_max_us);
+        total.reconnect_max_ms = std::max(total.reconnect_max_ms, r.reconnect_max_ms);
+    }
+
+    printf("\ntotal   %7" PRIu64 " samples, %.1f ms cpu, max latency %" PRIu64 " us, max reconnect %" PRIu64 " ms\n",
+           total.samples, total.cpu_ms, total.latency_max_us, total.reconnect_max_ms);
+
+    if (server > 0) {
+        kill(server, SIGTERM);
+        waitpid(server, nullptr, 0);
+    }
+    unlink(socket_path.c_str());
+    rmdir(dir);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,578 @@
+// Stand-in for mangohud-server, for exercising server_connection.cpp
+// without the real server or any GPU. It speaks the same socket protocol
+// (legacy polls, subscriptions with full or delta samples, shared memory,
+// history)
+// and either replays recorded messages or makes up synthetic ones.
+//
+// Recordings are plain back to back mangohud_message structs, as a legacy
+// server sends them, and are played in a loop.
+//
+// Every sample is stamped with CLOCK_MONOTONIC right before it goes out,
+// so clients on the same machine can tell how long it took to reach them.
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../src/server_protocol.hpp"
+#include "../src/metrics_delta.h"
+
+struct options {
+    std::string socket_path;
+    std::string replay;
+    unsigned gpus = 1;
+    unsigned interval_ms = 0;      // overrides what clients subscribe with
+    unsigned drop_percent = 0;     // samples skipped, clients see a sequence gap
+    unsigned hup_every_ms = 0;     // drop every client this often
+    unsigned restart_every_ms = 0; // remove the socket and come back this often
+    unsigned restart_delay_ms = 500;
+    unsigned slow_read_ms = 0;     // stall before reading each request
+    unsigned shm_slots = 32;
+    bool shm = true;
+    bool legacy = false;           // answer everything like a server without subscriptions
+    bool verbose = false;
+};
+
+struct client {
+    int sock = -1;
+    bool subscribed = false;
+    uint16_t wire_version = MANGOHUD_WIRE_FULL;
+    uint32_t interval_ms = 500;
+    uint32_t keepalive_ms = 2000;
+    uint64_t next_sample_ns = 0;
+    uint64_t last_sent_ns = 0;
+
+    // What the client has assembled so far, deltas are against this
+    mangohud_message reference = {};
+    uint32_t sequence = 0;
+    bool keyframe = true;
+
+    mangohud_shm_ring* ring = nullptr;
+    size_t ring_size = 0;
+};
+
+static volatile sig_atomic_t quit = 0;
+static options opts;
+static std::vector<mangohud_message> recording;
+static size_t replay_pos = 0;
+static std::mt19937 rng(1234);
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+static void debug(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+static void debug(const char* fmt, ...) {
+    if (!opts.verbose)
+        return;
+
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "mock_server: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+}
+
+// Smooth enough to look like a real machine, changing every sample. Only
+// depends on the time, so history comes out the same as the live samples.
+static void synthetic_message(uint64_t time_ns, mangohud_message& msg) {
+    double t = time_ns / 1e9;
+    size_t max_gpus = sizeof(msg.gpus) / sizeof(msg.gpus[0]);
+
+    msg = {};
+    msg.num_of_gpus = std::min<size_t>(opts.gpus, max_gpus);
+
+    for (uint8_t i = 0; i < msg.num_of_gpus; i++) {
+        gpu_metrics_system_t& system = msg.gpus[i].system_metrics;
+        double phase = t + i;
+
+        msg.gpus[i].is_active = i == 0;
+        system.load = 50 + 40 * sin(phase);
+        system.temperature = 60 + 15 * sin(phase / 7);
+        system.core_clock = 1800 + 300 * sin(phase / 3);
+        system.memory_clock = 1000;
+        system.vram_used = 4 + sin(phase / 11);
+        system.power_usage = 150 + 100 * sin(phase);
+    }
+
+    msg.cpu.load = 30 + 20 * sin(t * 1.3);
+    msg.cpu.temp = 55 + 10 * sin(t / 5);
+    msg.cpu.power = 40 + 20 * sin(t * 1.3);
+    msg.cpu.frequency = 4000 + 500 * sin(t / 2);
+    msg.memory.used = 8 + sin(t / 13);
+    msg.memory.swap_used = 0.5;
+}
+
+static void next_message(mangohud_message& msg) {
+    if (!recording.empty()) {
+        msg = recording[replay_pos++ % recording.size()];
+        return;
+    }
+
+    synthetic_message(now_ns(), msg);
+}
+
+static int listen_socket() {
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        perror("mock_server: socket");
+        return -1;
+    }
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, opts.socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    unlink(opts.socket_path.c_str());
+    if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(sock, 64) < 0) {
+        perror("mock_server: bind");
+        close(sock);
+        return -1;
+    }
+
+    debug("listening on %s", opts.socket_path.c_str());
+    return sock;
+}
+
+static void drop_client(client& c) {
+    if (c.ring)
+        munmap(c.ring, c.ring_size);
+
+    close(c.sock);
+    c = client();
+}
+
+static bool send_fd(int sock, const void* data, size_t size, int fd) {
+    iovec iov = { const_cast<void*>(data), size };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr hdr = {};
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+
+    if (fd >= 0) {
+        hdr.msg_control = control;
+        hdr.msg_controllen = sizeof(control);
+
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+
+    return sendmsg(sock, &hdr, MSG_NOSIGNAL) == ssize_t(size);
+}
+
+static void share_memory(client& c, const mangohud_shared_memory_request_v1& req) {
+    mangohud_shared_memory_v1 reply = {};
+    reply.hdr.magic = MANGOHUD_REQUEST_MAGIC;
+    reply.hdr.version = 1;
+    reply.hdr.type = MANGOHUD_REQUEST_SHARED_MEMORY;
+
+    if (!opts.shm || c.ring || req.msg_size != sizeof(mangohud_message)) {
+        send_fd(c.sock, &reply, sizeof(reply), -1);
+        return;
+    }
+
+    size_t slots_offset = (sizeof(mangohud_shm_ring) + 63) & ~size_t(63);
+    size_t slot_size = (sizeof(mangohud_shm_slot) + 63) & ~size_t(63);
+    size_t size = slots_offset + slot_size * opts.shm_slots;
+
+    int fd = memfd_create("mangohud-mock", MFD_CLOEXEC);
+    void* addr = MAP_FAILED;
+    if (fd >= 0 && ftruncate(fd, size) == 0)
+        addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (addr == MAP_FAILED) {
+        perror("mock_server: shared memory");
+        if (fd >= 0)
+            close(fd);
+        send_fd(c.sock, &reply, sizeof(reply), -1);
+        return;
+    }
+
+    // memfd pages start out zeroed, which is a valid state for the atomics
+    mangohud_shm_ring* ring = static_cast<mangohud_shm_ring*>(addr);
+    ring->magic = MANGOHUD_SHM_MAGIC;
+    ring->version = MANGOHUD_SHM_VERSION;
+    ring->num_slots = opts.shm_slots;
+    ring->slot_size = slot_size;
+    ring->slots_offset = slots_offset;
+
+    reply.size = size;
+    if (send_fd(c.sock, &reply, sizeof(reply), fd)) {
+        c.ring = ring;
+        c.ring_size = size;
+        debug("client %d reads from shared memory", c.sock);
+    } else {
+        munmap(addr, size);
+    }
+
+    close(fd);
+}
+
+static void write_ring(client& c, const mangohud_message& msg) {
+    mangohud_shm_ring* ring = c.ring;
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint8_t* base = reinterpret_cast<uint8_t*>(ring) + ring->slots_offset;
+    mangohud_shm_slot* slot = reinterpret_cast<mangohud_shm_slot*>(base + (head % ring->num_slots) * ring->slot_size);
+
+    slot->seq.store(slot->seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot->msg, &msg, sizeof(msg));
+    slot->sample_time_ns = now_ns();
+    slot->seq.store(slot->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+static bool send_sample(client& c, const mangohud_message& msg) {
+    uint64_t now = now_ns();
+
+    if (c.ring) {
+        write_ring(c, msg);
+        return true;
+    }
+
+    if (!c.keyframe && !memcmp(&msg, &c.reference, sizeof(msg)) &&
+        now - c.last_sent_ns < uint64_t(c.keepalive_ms) * 1000000)
+        return true;
+
+    c.last_sent_ns = now;
+
+    if (c.wire_version < MANGOHUD_WIRE_DELTA) {
+        c.reference = msg;
+        c.keyframe = false;
+        return send(c.sock, &msg, sizeof(msg), MSG_NOSIGNAL) == sizeof(msg);
+    }
+
+    uint32_t sequence = c.sequence++;
+    bool keyframe = c.keyframe;
+    std::vector<uint8_t> packet;
+    encode_metrics_sample(c.reference, msg, keyframe ? MANGOHUD_SAMPLE_KEYFRAME : 0, sequence, now, packet);
+
+    c.reference = msg;
+    c.keyframe = false;
+
+    // The sequence moved on regardless, so the client notices the gap
+    if (!keyframe && opts.drop_percent && rng() % 100 < opts.drop_percent)
+        return true;
+
+    return send(c.sock, packet.data(), packet.size(), MSG_NOSIGNAL) == ssize_t(packet.size());
+}
+
+// Answers with what we would have sampled over the last duration_ms, or
+// with the part of the recording played last
+static bool send_history(client& c, const mangohud_history_request_v1& req) {
+    uint64_t now = now_ns();
+    uint64_t duration = std::min<uint64_t>(req.duration_ms * 1000000ull, now);
+    uint32_t count = std::min<uint32_t>(req.max_samples, 1000);
+    mangohud_message prev = {}, msg = {};
+    std::vector<uint8_t> packet;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t t = now - duration + duration * i / count;
+
+        if (!recording.empty()) {
+            size_t back = (count - i) % recording.size();
+            msg = recording[(replay_pos + recording.size() - back) % recording.size()];
+        } else {
+            synthetic_message(t, msg);
+        }
+
+        uint8_t flags = MANGOHUD_SAMPLE_HISTORY | (i == 0 ? MANGOHUD_SAMPLE_KEYFRAME : 0);
+        packet.clear();
+        encode_metrics_sample(prev, msg, flags, i, t, packet);
+        if (send(c.sock, packet.data(), packet.size(), MSG_NOSIGNAL) != ssize_t(packet.size()))
+            return false;
+
+        prev = msg;
+    }
+
+    // Encoded against itself there are no runs left
+    packet.clear();
+    encode_metrics_sample(msg, msg, MANGOHUD_SAMPLE_HISTORY | MANGOHUD_SAMPLE_HISTORY_END, count, now, packet);
+    debug("sent client %d %u samples of history", c.sock, count);
+    return send(c.sock, packet.data(), packet.size(), MSG_NOSIGNAL) == ssize_t(packet.size());
+}
+
+static bool handle_request(client& c) {
+    if (opts.slow_read_ms)
+        usleep(opts.slow_read_ms * 1000);
+
+    std::vector<uint8_t> buf(sizeof(mangohud_message) + 256);
+    ssize_t len = recv(c.sock, buf.data(), buf.size(), 0);
+
+    if (len <= 0)
+        return len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+
+    mangohud_request_header hdr = {};
+    if (size_t(len) >= sizeof(hdr))
+        memcpy(&hdr, buf.data(), sizeof(hdr));
+
+    mangohud_message msg;
+
+    if (opts.legacy || hdr.magic != MANGOHUD_REQUEST_MAGIC) {
+        next_message(msg);
+        return send(c.sock, &msg, sizeof(msg), MSG_NOSIGNAL) == sizeof(msg);
+    }
+
+    if (hdr.type == MANGOHUD_REQUEST_SUBSCRIBE && size_t(len) >= sizeof(mangohud_subscribe_v1)) {
+        mangohud_subscribe_v1 req;
+        memcpy(&req, buf.data(), sizeof(req));
+
+        // Fields and GPU masks are accepted but everything gets sampled
+        c.subscribed = true;
+        c.interval_ms = opts.interval_ms ? opts.interval_ms : std::max<uint32_t>(req.interval_ms, 1);
+        c.keepalive_ms = req.keepalive_ms;
+        c.wire_version = std::min<uint16_t>(req.wire_version, MANGOHUD_WIRE_DELTA);
+        c.keyframe = true;
+        c.next_sample_ns = now_ns();
+        debug("client %d subscribed every %u ms, wire version %u", c.sock, c.interval_ms, c.wire_version);
+        return true;
+    }
+
+    if (hdr.type == MANGOHUD_REQUEST_SHARED_MEMORY && size_t(len) >= sizeof(mangohud_shared_memory_request_v1)) {
+        mangohud_shared_memory_request_v1 req;
+        memcpy(&req, buf.data(), sizeof(req));
+        share_memory(c, req);
+        return true;
+    }
+
+    if (hdr.type == MANGOHUD_REQUEST_HISTORY && size_t(len) >= sizeof(mangohud_history_request_v1)) {
+        mangohud_history_request_v1 req;
+        memcpy(&req, buf.data(), sizeof(req));
+        if (!send_history(c, req))
+            debug("failed to send history to client %d", c.sock);
+        return true;
+    }
+
+    debug("client %d sent unknown request type %u", c.sock, hdr.type);
+    return true;
+}
+
+static bool load_recording(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        perror("mock_server: replay file");
+        return false;
+    }
+
+    mangohud_message msg;
+    while (fread(&msg, sizeof(msg), 1, f) == 1)
+        recording.push_back(msg);
+
+    fclose(f);
+
+    if (recording.empty()) {
+        fprintf(stderr, "mock_server: %s holds no complete mangohud_message\n", path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --socket=PATH         socket to listen on, defaults to $MANGOHUD_SERVER_SOCKET\n"
+        "  --replay=FILE         play recorded mangohud_messages in a loop\n"
+        "  --gpus=N              synthetic GPUs, default 1\n"
+        "  --interval=MS         sample this often whatever clients ask for\n"
+        "  --drop=PERCENT        skip delta samples at random\n"
+        "  --hup-every=MS        disconnect every client this often\n"
+        "  --restart-every=MS    remove the socket and recreate it this often\n"
+        "  --restart-delay=MS    how long the socket stays gone, default 500\n"
+        "  --slow-read=MS        stall before reading every request\n"
+        "  --shm-slots=N         shared memory ring size, default 32\n"
+        "  --no-shm              refuse shared memory\n"
+        "  --legacy              behave like a server without subscriptions\n"
+        "  --verbose\n", argv0);
+}
+
+static bool parse_options(int argc, char** argv) {
+    static const option long_opts[] = {
+        { "socket",        required_argument, nullptr, 's' },
+        { "replay",        required_argument, nullptr, 'r' },
+        { "gpus",          required_argument, nullptr, 'g' },
+        { "interval",      required_argument, nullptr, 'i' },
+        { "drop",          required_argument, nullptr, 'd' },
+        { "hup-every",     required_argument, nullptr, 'H' },
+        { "restart-every", required_argument, nullptr, 'R' },
+        { "restart-delay", required_argument, nullptr, 'D' },
+        { "slow-read",     required_argument, nullptr, 'S' },
+        { "shm-slots",     required_argument, nullptr, 'n' },
+        { "no-shm",        no_argument,       nullptr, 'N' },
+        { "legacy",        no_argument,       nullptr, 'L' },
+        { "verbose",       no_argument,       nullptr, 'v' },
+        { "help",          no_argument,       nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 },
+    };
+
+    const char* env = getenv("MANGOHUD_SERVER_SOCKET");
+    if (env)
+        opts.socket_path = env;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "", long_opts, nullptr)) != -1) {
+        switch (c) {
+        case 's': opts.socket_path = optarg; break;
+        case 'r': opts.replay = optarg; break;
+        case 'g': opts.gpus = strtoul(optarg, nullptr, 10); break;
+        case 'i': opts.interval_ms = strtoul(optarg, nullptr, 10); break;
+        case 'd': opts.drop_percent = strtoul(optarg, nullptr, 10); break;
+        case 'H': opts.hup_every_ms = strtoul(optarg, nullptr, 10); break;
+        case 'R': opts.restart_every_ms = strtoul(optarg, nullptr, 10); break;
+        case 'D': opts.restart_delay_ms = strtoul(optarg, nullptr, 10); break;
+        case 'S': opts.slow_read_ms = strtoul(optarg, nullptr, 10); break;
+        case 'n': opts.shm_slots = std::max(2ul, strtoul(optarg, nullptr, 10)); break;
+        case 'N': opts.shm = false; break;
+        case 'L': opts.legacy = true; break;
+        case 'v': opts.verbose = true; break;
+        default:
+            usage(argv[0]);
+            return false;
+        }
+    }
+
+    if (opts.socket_path.empty()) {
+        usage(argv[0]);
+        return false;
+    }
+
+    return opts.replay.empty() || load_recording(opts.replay);
+}
+
+int main(int argc, char** argv) {
+    if (!parse_options(argc, argv))
+        return 1;
+
+    signal(SIGINT, [](int) { quit = 1; });
+    signal(SIGTERM, [](int) { quit = 1; });
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = listen_socket();
+    if (listener < 0)
+        return 1;
+
+    std::vector<client> clients;
+    uint64_t next_hup = opts.hup_every_ms ? now_ns() + opts.hup_every_ms * 1000000ull : UINT64_MAX;
+    uint64_t next_restart = opts.restart_every_ms ? now_ns() + opts.restart_every_ms * 1000000ull : UINT64_MAX;
+    uint64_t relisten_at = UINT64_MAX;
+
+    while (!quit) {
+        uint64_t now = now_ns();
+
+        if (now >= next_hup) {
+            debug("dropping %zu clients", clients.size());
+            for (client& c : clients)
+                drop_client(c);
+            clients.clear();
+            next_hup = now + opts.hup_every_ms * 1000000ull;
+        }
+
+        if (now >= next_restart) {
+            debug("going away for %u ms", opts.restart_delay_ms);
+            for (client& c : clients)
+                drop_client(c);
+            clients.clear();
+            close(listener);
+            listener = -1;
+            unlink(opts.socket_path.c_str());
+            relisten_at = now + opts.restart_delay_ms * 1000000ull;
+            next_restart = relisten_at + opts.restart_every_ms * 1000000ull;
+        }
+
+        if (listener < 0 && now >= relisten_at) {
+            listener = listen_socket();
+            relisten_at = UINT64_MAX;
+        }
+
+        // Sample for everyone who's due
+        uint64_t wake = std::min({ next_hup, next_restart, relisten_at });
+        for (client& c : clients) {
+            if (!c.subscribed)
+                continue;
+
+            if (now >= c.next_sample_ns) {
+                mangohud_message msg;
+                next_message(msg);
+                if (!send_sample(c, msg))
+                    debug("failed to send to client %d", c.sock);
+
+                // Don't try to catch up on missed intervals
+                c.next_sample_ns = std::max<uint64_t>(c.next_sample_ns + c.interval_ms * 1000000ull, now);
+            }
+
+            wake = std::min(wake, c.next_sample_ns);
+        }
+
+        std::vector<pollfd> fds;
+        fds.push_back({ listener, POLLIN, 0 });
+        for (client& c : clients)
+            fds.push_back({ c.sock, POLLIN, 0 });
+
+        int timeout = -1;
+        if (wake != UINT64_MAX) {
+            now = now_ns();
+            timeout = wake > now ? int((wake - now + 999999) / 1000000) : 0;
+        }
+
+        if (poll(fds.data(), fds.size(), timeout) < 0) {
+            if (errno != EINTR)
+                perror("mock_server: poll");
+            continue;
+        }
+
+        for (size_t i = 1; i < fds.size(); i++) {
+            client& c = clients[i - 1];
+
+            if (fds[i].revents & POLLIN) {
+                if (!handle_request(c))
+                    drop_client(c);
+            } else if (fds[i].revents & (POLLHUP | POLLERR)) {
+                drop_client(c);
+            }
+        }
+
+        clients.erase(std::remove_if(clients.begin(), clients.end(),
+            [](const client& c) { return c.sock < 0; }), clients.end());
+
+        if (listener >= 0 && (fds[0].revents & POLLIN)) {
+            int sock;
+            while ((sock = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                client c;
+                c.sock = sock;
+                clients.push_back(c);
+                debug("client %d connected", sock);
+            }
+        }
+    }
+
+    for (client& c : clients)
+        drop_client(c);
+
+    if (listener >= 0)
+        close(listener);
+    unlink(opts.socket_path.c_str());
+    return 0;
+}
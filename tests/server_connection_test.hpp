@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+// What src/server_connection.cpp offers when built with TEST_ONLY, in place
+// of what it reads from the HUD otherwise
+
+// Stands in for the config in tests, which have no HUD
+void set_server_interval(uint32_t interval_ms);
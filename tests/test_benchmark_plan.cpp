@@ -0,0 +1,144 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include <vector>
+#include "../src/benchmark_plan.h"
+
+#define UNUSED(x) (void)(x)
+
+struct step_at {
+    int frame;
+    unsigned steps;
+};
+
+// Feeds frames of frametime_ms and notes every frame that asked for steps
+static std::vector<step_at> run_frames(benchmark_plan& plan, int frames, float frametime_ms) {
+    std::vector<step_at> seen;
+    for (int i = 0; i < frames; i++) {
+        unsigned steps = plan.add(frametime_ms);
+        if (steps)
+            seen.push_back({ i, steps });
+    }
+    return seen;
+}
+
+static void test_plan_runs(void **state) {
+    UNUSED(state);
+    benchmark_plan::options opts;
+    opts.warmup_s = 1;
+    opts.duration_s = 2;
+    opts.cooldown_s = 1;
+    opts.runs = 2;
+    opts.fps_limits = { 60, 0 };
+    benchmark_plan plan(opts);
+
+    // Nothing happens until it's started
+    assert_int_equal(run_frames(plan, 100, 10.f).size(), 0);
+    plan.start();
+
+    std::vector<step_at> seen = run_frames(plan, 1000, 10.f);
+    assert_int_equal(seen.size(), 7);
+
+    // Run 1: 1 s warm-up, 2 s measured, 1 s cool-down, frame by frame
+    assert_int_equal(seen[0].frame, 0);
+    assert_int_equal(seen[0].steps, benchmark_plan::apply_limit);
+    assert_int_equal(seen[1].frame, 100);
+    assert_int_equal(seen[1].steps, benchmark_plan::start_log);
+    assert_int_equal(seen[2].frame, 300);
+    assert_int_equal(seen[2].steps, benchmark_plan::stop_log);
+
+    // Run 2
+    assert_int_equal(seen[3].frame, 400);
+    assert_int_equal(seen[3].steps, benchmark_plan::apply_limit);
+    assert_int_equal(seen[4].steps, benchmark_plan::start_log);
+    assert_int_equal(seen[5].steps, benchmark_plan::stop_log);
+    assert_int_equal(seen[6].frame, 800);
+    assert_int_equal(seen[6].steps, benchmark_plan::restore_limit | benchmark_plan::finished);
+    assert_false(plan.running());
+
+    const std::vector<benchmark_run_result>& results = plan.results();
+    assert_int_equal(results.size(), 2);
+    assert_int_equal(results[0].fps_limit, 60);
+    assert_int_equal(results[1].fps_limit, 0);
+    for (auto& r : results) {
+        assert_int_equal(r.frames, 200);
+        assert_float_equal(r.duration_s, 2.0, 1e-6);
+        assert_float_equal(r.avg_fps, 100.0, 1e-3);
+    }
+}
+
+static void test_plan_abort(void **state) {
+    UNUSED(state);
+    benchmark_plan::options opts;
+    opts.duration_s = 5;
+    benchmark_plan plan(opts);
+
+    // Without a warm-up the first frame starts the log
+    plan.start();
+    assert_int_equal(plan.add(10.f), benchmark_plan::start_log);
+    assert_true(plan.state() == benchmark_plan::phase::measure);
+    run_frames(plan, 100, 10.f);
+
+    // Aborting while measuring closes the log, and leaves no result
+    plan.abort();
+    assert_int_equal(plan.add(10.f), benchmark_plan::stop_log);
+    assert_false(plan.running());
+    assert_int_equal(plan.results().size(), 0);
+
+    // It can be started over
+    plan.start();
+    std::vector<step_at> seen = run_frames(plan, 600, 10.f);
+    assert_int_equal(seen.size(), 3);
+    assert_int_equal(seen[2].steps, benchmark_plan::finished);
+    assert_int_equal(plan.results().size(), 1);
+}
+
+static void test_plan_mean_sd(void **state) {
+    UNUSED(state);
+    std::vector<benchmark_run_result> results(3);
+    results[0].avg_fps = 100;
+    results[1].avg_fps = 110;
+    results[2].avg_fps = 120;
+
+    double mean, sd;
+    benchmark_plan::mean_sd(results, &benchmark_run_result::avg_fps, mean, sd);
+    assert_float_equal(mean, 110.0, 1e-9);
+    assert_float_equal(sd, 10.0, 1e-9);
+
+    results.resize(1);
+    benchmark_plan::mean_sd(results, &benchmark_run_result::avg_fps, mean, sd);
+    assert_float_equal(mean, 100.0, 1e-9);
+    assert_float_equal(sd, 0.0, 0.0);
+}
+
+// A config reload keeps the plan unless one of these changed
+static void test_plan_settings(void **state) {
+    UNUSED(state);
+    benchmark_plan::options opts;
+    opts.runs = 3;
+    opts.fps_limits = {60, 0};
+    benchmark_plan plan(opts);
+    assert_true(plan.settings() == opts);
+
+    benchmark_plan::options changed = opts;
+    changed.fps_limits = {60};
+    assert_true(plan.settings() != changed);
+    changed = opts;
+    changed.warmup_s = 5;
+    assert_true(plan.settings() != changed);
+}
+
+const struct CMUnitTest benchmark_plan_tests[] = {
+    cmocka_unit_test(test_plan_runs),
+    cmocka_unit_test(test_plan_abort),
+    cmocka_unit_test(test_plan_mean_sd),
+    cmocka_unit_test(test_plan_settings),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(benchmark_plan_tests, NULL, NULL);
+}
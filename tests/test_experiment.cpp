@@ -0,0 +1,114 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include <random>
+#include <vector>
+#include "../src/experiment.h"
+
+#define UNUSED(x) (void)(x)
+
+static std::vector<experiment_variant> two_limits() {
+    experiment_variant a, b;
+    a.name = "fps_limit=100";
+    a.fps_limit = 100;
+    b.name = "fps_limit=80";
+    b.fps_limit = 80;
+    return { a, b };
+}
+
+// Feeds frames paced by whichever variant is active, for seconds
+static void run_for(ab_experiment& e, double seconds, std::mt19937& rng, float sd) {
+    std::normal_distribution<float> noise(0.f, sd);
+    double ms = 0;
+    double since_switch = 0;
+    while (ms < seconds * 1000) {
+        float f = 1000.f / e.current().fps_limit + noise(rng);
+        // The limiter takes a moment to get to the new pace
+        if (since_switch < 100)
+            f *= 3;
+        ms += f;
+        since_switch += f;
+        if (e.add(f))
+            since_switch = 0;
+    }
+}
+
+static void test_experiment_cycle(void **state) {
+    UNUSED(state);
+    ab_experiment e(two_limits(), 1000, 200);
+
+    // The first frame only applies the first variant
+    assert_true(e.add(10.f));
+    assert_int_equal(e.current().fps_limit, 100);
+
+    int switches = 0;
+    for (int i = 0; i < 1000; i++) {
+        if (e.add(10.f)) {
+            switches++;
+            assert_int_equal(e.current().fps_limit, switches % 2 ? 80 : 100);
+        }
+    }
+    assert_int_equal(switches, 10);
+
+    // Only the settled 800 ms of each interval count
+    std::vector<experiment_result> results = e.results();
+    assert_int_equal(results.size(), 2);
+    assert_int_equal(results[0].intervals, 5);
+    assert_int_equal(results[0].frames, 5 * 80);
+    assert_float_equal(results[0].avg_fps, 100.0, 1e-6);
+    assert_float_equal(results[1].change, 0.0, 1e-6);
+    assert_float_equal(results[1].change_ci95, 0.0, 1e-6);
+
+    // Starting over goes back to the first variant and forgets the stats
+    e.restart();
+    assert_true(e.add(10.f));
+    assert_int_equal(e.current().fps_limit, 100);
+    assert_int_equal(e.results()[0].intervals, 0);
+}
+
+static void test_experiment_difference(void **state) {
+    UNUSED(state);
+    std::mt19937 rng(1);
+    ab_experiment e(two_limits(), 2000, 500);
+
+    run_for(e, 120, rng, 1.f);
+
+    std::vector<experiment_result> results = e.results();
+    assert_int_equal(results[0].intervals, 30);
+    assert_float_equal(results[0].avg_fps, 100.0, 1.0);
+    assert_float_equal(results[1].avg_fps, 80.0, 1.0);
+    assert_true(results[0].ci95 < 1.0);
+
+    // 20% slower, and sure of it
+    assert_float_equal(results[1].change, -20.0, 1.0);
+    assert_true(results[1].change_ci95 > 0);
+    assert_true(std::abs(results[1].change) > results[1].change_ci95);
+}
+
+static void test_experiment_same(void **state) {
+    UNUSED(state);
+    std::mt19937 rng(2);
+    std::vector<experiment_variant> variants = two_limits();
+    variants[1].fps_limit = 100;
+    ab_experiment e(variants, 2000, 500);
+
+    run_for(e, 120, rng, 3.f);
+
+    // No difference, the interval has to cover 0
+    std::vector<experiment_result> results = e.results();
+    assert_true(std::abs(results[1].change) < results[1].change_ci95);
+}
+
+const struct CMUnitTest experiment_tests[] = {
+    cmocka_unit_test(test_experiment_cycle),
+    cmocka_unit_test(test_experiment_difference),
+    cmocka_unit_test(test_experiment_same),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(experiment_tests, NULL, NULL);
+}
@@ -0,0 +1,111 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include "../src/frame_pacing.h"
+
+#define UNUSED(x) (void)(x)
+
+static const float refresh_60 = 1000.f / 60;
+
+static void test_pacing_steady(void **state) {
+    UNUSED(state);
+    frame_pacing_stats pacing;
+
+    for (int i = 0; i < 600; i++)
+        pacing.add(refresh_60, refresh_60, refresh_60);
+    pacing.publish();
+
+    frame_pacing_summary s = pacing.last_window();
+    assert_int_equal(s.frames, 600);
+    assert_true(s.jitter_p99 < 0.1f);
+    assert_float_equal(s.off_pace, 0.0, 0.0);
+    assert_true(s.vblanks_known);
+    assert_int_equal(s.missed_vblanks, 0);
+    assert_float_equal(s.stutter_index, 0.0, 0.0);
+}
+
+static void test_pacing_alternating(void **state) {
+    UNUSED(state);
+    frame_pacing_stats pacing;
+
+    // The same average fps as a steady 60, without a limit to pace against
+    for (int i = 0; i < 600; i++)
+        pacing.add(i % 2 ? 25.f : 8.f, 0, 0);
+    pacing.publish();
+
+    frame_pacing_summary s = pacing.last_window();
+    assert_float_equal(s.jitter_p50, 17.0, 17.0 * frametime_histogram::max_relative_error);
+    assert_float_equal(s.jitter_p99, 17.0, 17.0 * frametime_histogram::max_relative_error);
+    assert_true(s.off_pace > 99.f);
+    assert_false(s.vblanks_known);
+    // 25 ms frames are 8.5 ms over the 16.5 ms average, every 33 ms
+    assert_float_equal(s.stutter_index, 100.0 * 8.5 / 33, 0.5);
+}
+
+static void test_pacing_missed_vblanks(void **state) {
+    UNUSED(state);
+    frame_pacing_stats pacing;
+
+    // 60 fps limit on 60 Hz, every 10th frame takes two or three vblanks
+    for (int i = 0; i < 100; i++) {
+        float frametime = refresh_60;
+        if (i % 10 == 9)
+            frametime = i % 20 == 9 ? 2 * refresh_60 : 3 * refresh_60;
+        pacing.add(frametime, refresh_60, refresh_60);
+    }
+    pacing.publish();
+
+    frame_pacing_summary s = pacing.last_window();
+    assert_int_equal(s.missed_vblanks, 5 * 1 + 5 * 2);
+    assert_float_equal(s.off_pace, 10.0, 1e-4);
+
+    // 30 fps limit on 60 Hz, frames are meant to span two vblanks
+    frame_pacing_stats half_rate;
+    for (int i = 0; i < 100; i++)
+        half_rate.add(i == 50 ? 3 * refresh_60 : 2 * refresh_60, 2 * refresh_60, refresh_60);
+    half_rate.publish();
+    assert_int_equal(half_rate.last_window().missed_vblanks, 1);
+}
+
+static void test_pacing_window(void **state) {
+    UNUSED(state);
+    frame_pacing_stats pacing;
+
+    for (int i = 0; i < 100; i++)
+        pacing.add(i % 2 ? 25.f : 8.f, 0, 0);
+
+    // Long enough for the stutter to leave the window but not the session
+    for (int i = 0; i < 1000; i++)
+        pacing.add(16.f, 0, 0);
+    pacing.publish();
+
+    frame_pacing_summary window = pacing.last_window();
+    frame_pacing_summary session = pacing.last_session();
+    assert_true(window.frames <= frame_pacing_stats::window_ms / 16);
+    assert_float_equal(window.off_pace, 0.0, 0.0);
+    assert_float_equal(window.stutter_index, 0.0, 0.0);
+    assert_int_equal(session.frames, 1100);
+    assert_true(session.off_pace > 5.f);
+
+    // Applied with the next frame
+    pacing.reset_session();
+    pacing.add(16.f, 0, 0);
+    pacing.publish();
+    assert_int_equal(pacing.last_session().frames, 1);
+    assert_int_equal(pacing.last_window().frames, window.frames);
+}
+
+const struct CMUnitTest frame_pacing_tests[] = {
+    cmocka_unit_test(test_pacing_steady),
+    cmocka_unit_test(test_pacing_alternating),
+    cmocka_unit_test(test_pacing_missed_vblanks),
+    cmocka_unit_test(test_pacing_window),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(frame_pacing_tests, NULL, NULL);
+}
@@ -0,0 +1,97 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include "../src/frametime_distribution.h"
+
+#define UNUSED(x) (void)(x)
+
+static int fullest_bin(const frametime_distribution& d) {
+    int fullest = 0;
+    for (int i = 1; i < frametime_distribution::num_bins; i++)
+        if (d.bin_count(i) > d.bin_count(fullest))
+            fullest = i;
+    return fullest;
+}
+
+static void test_distribution_bins(void **state) {
+    UNUSED(state);
+    frametime_distribution d;
+
+    // Every frametime lands in the bin its edges cover
+    for (int i = 0; i < frametime_distribution::num_bins; i++) {
+        float lower = frametime_distribution::bin_lower_ms(i);
+        float upper = frametime_distribution::bin_lower_ms(i + 1);
+        d.clear();
+        d.add((lower + upper) / 2);
+        assert_int_equal(d.bin_count(i), 1);
+    }
+
+    // Out of range and garbage go to the ends
+    d.clear();
+    d.add(0.2f);
+    d.add(-1.f);
+    d.add(NAN);
+    d.add(5000.f);
+    assert_int_equal(d.bin_count(0), 3);
+    assert_int_equal(d.bin_count(frametime_distribution::num_bins - 1), 1);
+    assert_int_equal(d.count(), 4);
+}
+
+static void test_distribution_bimodal(void **state) {
+    UNUSED(state);
+    frametime_distribution d;
+
+    // 60 and 144 fps frames taking turns end up well apart
+    for (int i = 0; i < 1000; i++)
+        d.add(i % 2 ? 16.7f : 6.9f);
+
+    int fast = fullest_bin(d);
+    assert_int_equal(d.bin_count(fast), 500);
+    assert_true(frametime_distribution::bin_lower_ms(fast) <= 6.9f);
+    assert_true(frametime_distribution::bin_lower_ms(fast + 1) > 6.9f);
+
+    uint32_t slow = 0;
+    for (int i = fast + 4; i < frametime_distribution::num_bins; i++)
+        slow += d.bin_count(i);
+    assert_int_equal(slow, 500);
+
+    float shares = 0;
+    for (int i = 0; i < frametime_distribution::num_bins; i++)
+        shares += frametime_distribution::get(&d, i);
+    assert_float_equal(shares, 1.0, 1e-6);
+}
+
+static void test_distribution_window(void **state) {
+    UNUSED(state);
+    frametime_distribution d(1000);
+
+    for (int i = 0; i < 100; i++)
+        d.add(50.f);
+    // 200 frames of 5 ms are a full second, the slow ones are gone
+    for (int i = 0; i < 200; i++)
+        d.add(5.f);
+
+    assert_int_equal(d.count(), 200);
+    assert_int_equal(d.bin_count(fullest_bin(d)), 200);
+
+    // Switching to the session starts over
+    d.set_window(0);
+    assert_int_equal(d.count(), 0);
+    for (int i = 0; i < 300; i++)
+        d.add(5.f);
+    assert_int_equal(d.count(), 300);
+}
+
+const struct CMUnitTest frametime_distribution_tests[] = {
+    cmocka_unit_test(test_distribution_bins),
+    cmocka_unit_test(test_distribution_bimodal),
+    cmocka_unit_test(test_distribution_window),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(frametime_distribution_tests, NULL, NULL);
+}
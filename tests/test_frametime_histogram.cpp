@@ -0,0 +1,184 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <vector>
+#include "../src/frametime_histogram.h"
+
+#define UNUSED(x) (void)(x)
+
+static const double percentiles[] = { 0.001, 0.01, 0.05, 0.5, 0.97, 0.999 };
+
+// Compares every percentile the way fpsMetrics asks for them with the
+// frametime at the same index after sorting slowest first
+static void check_against_sort(const frametime_histogram& hist, std::vector<float> frametimes) {
+    std::sort(frametimes.begin(), frametimes.end(), std::greater<float>());
+
+    assert_int_equal(hist.count(), frametimes.size());
+
+    for (double p : percentiles) {
+        uint64_t idx = p * frametimes.size() - 1;
+        double exact = frametimes[idx];
+        double error = std::abs(hist.slowest(idx) - exact) / exact;
+
+        if (error > frametime_histogram::max_relative_error + 1e-6)
+            print_message("p %f: %f vs exact %f\n", p, hist.slowest(idx), exact);
+        assert_true(error <= frametime_histogram::max_relative_error + 1e-6);
+    }
+
+    double sum = 0;
+    for (float f : frametimes)
+        sum += f;
+    assert_float_equal(hist.average(), sum / frametimes.size(), 1e-6);
+}
+
+static void test_histogram_empty(void **state) {
+    UNUSED(state);
+    frametime_histogram hist;
+
+    assert_int_equal(hist.count(), 0);
+    assert_float_equal(hist.average(), 0.0, 0.0);
+    assert_float_equal(hist.slowest(0), 0.0, 0.0);
+}
+
+static void test_histogram_lognormal(void **state) {
+    UNUSED(state);
+    std::mt19937 rng(1);
+    // Around 144 fps with a long tail
+    std::lognormal_distribution<float> dist(std::log(6.9f), 0.25f);
+    frametime_histogram hist;
+    std::vector<float> frametimes;
+
+    for (int i = 0; i < 200000; i++) {
+        float f = dist(rng);
+        hist.add(f);
+        frametimes.push_back(f);
+    }
+
+    check_against_sort(hist, frametimes);
+}
+
+static void test_histogram_stutter(void **state) {
+    UNUSED(state);
+    std::mt19937 rng(2);
+    std::normal_distribution<float> smooth(4.2f, 0.3f);
+    std::uniform_real_distribution<float> stutter(30.f, 250.f);
+    frametime_histogram hist;
+    std::vector<float> frametimes;
+
+    // 240 fps with one hitch every few hundred frames
+    for (int i = 0; i < 50000; i++) {
+        float f = rng() % 300 ? std::max(0.5f, smooth(rng)) : stutter(rng);
+        hist.add(f);
+        frametimes.push_back(f);
+    }
+
+    check_against_sort(hist, frametimes);
+}
+
+static void test_histogram_range(void **state) {
+    UNUSED(state);
+    std::mt19937 rng(3);
+    // From 0.0625 ms up to the 100 s fpsMetrics still accepts
+    std::uniform_real_distribution<float> exponent(-4.f, 16.6f);
+    frametime_histogram hist;
+    std::vector<float> frametimes;
+
+    for (int i = 0; i < 100000; i++) {
+        float f = std::exp2(exponent(rng));
+        hist.add(f);
+        frametimes.push_back(f);
+    }
+
+    check_against_sort(hist, frametimes);
+}
+
+static void test_histogram_remove(void **state) {
+    UNUSED(state);
+    frametime_histogram hist;
+
+    hist.add(10.f);
+    hist.add(20.f);
+    hist.add(5.f);
+    hist.remove(20.f);
+
+    assert_int_equal(hist.count(), 2);
+    assert_float_equal(hist.average(), 7.5, 1e-9);
+    assert_float_equal(hist.slowest(0), 10.0, 10.0 * frametime_histogram::max_relative_error);
+    assert_float_equal(hist.slowest(1), 5.0, 5.0 * frametime_histogram::max_relative_error);
+}
+
+static void test_histogram_time_weighted(void **state) {
+    UNUSED(state);
+    frametime_histogram hist;
+
+    // 990 frames of 10 ms and 10 of 100 ms: 1% of the frames, but 9.2% of
+    // the 10.9 seconds
+    for (int i = 0; i < 1000; i++)
+        hist.add(i % 100 ? 10.f : 100.f);
+
+    const double tolerance = 100.0 * frametime_histogram::max_relative_error;
+    assert_float_equal(hist.slowest(9), 100.0, tolerance);
+    assert_float_equal(hist.slowest(10), 10.0, tolerance);
+    assert_float_equal(hist.slowest_for(0.01 * hist.sum()), 100.0, tolerance);
+    assert_float_equal(hist.slowest_for(0.09 * hist.sum()), 100.0, tolerance);
+    assert_float_equal(hist.slowest_for(0.1 * hist.sum()), 10.0, tolerance);
+
+    assert_int_equal(hist.at_least(50.f), 10);
+    assert_int_equal(hist.at_least(10.f), 1000);
+    assert_int_equal(hist.at_least(200.f), 0);
+}
+
+static void test_stats_windows(void **state) {
+    UNUSED(state);
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<float> dist(2.f, 40.f);
+    frametime_stats stats({ 1000, 10000 });
+    std::vector<float> frametimes;
+
+    for (int i = 0; i < 20000; i++) {
+        float f = dist(rng);
+        stats.add(f);
+        frametimes.push_back(f);
+    }
+
+    check_against_sort(stats.session(), frametimes);
+
+    // Each window is the newest frames adding up to no more than its duration
+    for (size_t w = 0; w < stats.num_windows(); w++) {
+        std::vector<float> tail;
+        double ms = 0;
+        for (size_t i = frametimes.size(); i-- > 0;) {
+            if (ms + frametimes[i] > stats.window_ms(w))
+                break;
+            ms += frametimes[i];
+            tail.push_back(frametimes[i]);
+        }
+
+        check_against_sort(stats.window(w), tail);
+    }
+
+    stats.clear();
+    assert_int_equal(stats.session().count(), 0);
+    assert_int_equal(stats.window(0).count(), 0);
+}
+
+const struct CMUnitTest frametime_histogram_tests[] = {
+    cmocka_unit_test(test_histogram_empty),
+    cmocka_unit_test(test_histogram_lognormal),
+    cmocka_unit_test(test_histogram_stutter),
+    cmocka_unit_test(test_histogram_range),
+    cmocka_unit_test(test_histogram_remove),
+    cmocka_unit_test(test_histogram_time_weighted),
+    cmocka_unit_test(test_stats_windows),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(frametime_histogram_tests, NULL, NULL);
+}
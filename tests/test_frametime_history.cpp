@@ -0,0 +1,89 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "../src/frametime_history.h"
+
+#define UNUSED(x) (void)(x)
+
+static void test_history_empty(void **state) {
+    UNUSED(state);
+    frametime_history<4> history;
+
+    assert_float_equal(history.min(), 0.0, 0.0);
+    assert_float_equal(history.max(), 0.0, 0.0);
+    assert_float_equal(history.latest(), 0.0, 0.0);
+    for (size_t i = 0; i < history.size(); i++)
+        assert_float_equal(history[i], 0.0, 0.0);
+}
+
+static void test_history_order(void **state) {
+    UNUSED(state);
+    frametime_history<4> history;
+
+    // Not full yet, the missing older frames read as 0
+    history.push(1.f);
+    history.push(2.f);
+    assert_float_equal(history[0], 0.0, 0.0);
+    assert_float_equal(history[1], 0.0, 0.0);
+    assert_float_equal(history[2], 1.0, 0.0);
+    assert_float_equal(history[3], 2.0, 0.0);
+    assert_float_equal(history.min(), 1.0, 0.0);
+
+    for (float f = 3.f; f <= 6.f; f++)
+        history.push(f);
+
+    for (size_t i = 0; i < history.size(); i++)
+        assert_float_equal(history[i], 3.0 + i, 0.0);
+    assert_float_equal(history.latest(), 6.0, 0.0);
+
+    // Starting at offset() the raw buffer is in the same order
+    for (size_t i = 0; i < history.size(); i++)
+        assert_float_equal(history.data()[(history.offset() + i) % history.size()], history[i], 0.0);
+}
+
+static void test_history_min_max(void **state) {
+    UNUSED(state);
+    const size_t window = 200;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> smooth(6.f, 8.f);
+    std::uniform_real_distribution<float> stutter(20.f, 100.f);
+
+    frametime_history<window> history;
+    std::vector<float> frametimes;
+
+    for (int i = 0; i < 5000; i++) {
+        // Runs of rising and falling frametimes are the worst case for
+        // the queues, mix them with noise and the odd stutter
+        float f;
+        if (i % 1000 < 300)
+            f = 5.f + (i % 1000) * 0.01f;
+        else if (i % 1000 < 600)
+            f = 15.f - (i % 1000) * 0.01f;
+        else
+            f = rng() % 50 ? smooth(rng) : stutter(rng);
+
+        history.push(f);
+        frametimes.push_back(f);
+
+        auto begin = frametimes.end() - std::min(frametimes.size(), window);
+        assert_float_equal(history.min(), *std::min_element(begin, frametimes.end()), 0.0);
+        assert_float_equal(history.max(), *std::max_element(begin, frametimes.end()), 0.0);
+    }
+}
+
+const struct CMUnitTest frametime_history_tests[] = {
+    cmocka_unit_test(test_history_empty),
+    cmocka_unit_test(test_history_order),
+    cmocka_unit_test(test_history_min_max),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(frametime_history_tests, NULL, NULL);
+}
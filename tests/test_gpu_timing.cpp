@@ -0,0 +1,106 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include "../src/gpu_timing.h"
+
+#define UNUSED(x) (void)(x)
+
+static const uint64_t ms = 1000000;
+
+static void test_gpu_frame(void **state) {
+    UNUSED(state);
+    gpu_frame_timing timing;
+
+    // Two submissions 1 ms apart on one queue, done after the present
+    uint64_t a = timing.submitting();
+    uint64_t b = timing.submitting();
+    assert_int_equal(a, 0);
+    assert_int_equal(b, 0);
+    timing.completed(a, 1, 10 * ms, 14 * ms);
+    timing.presented();
+    assert_float_equal(timing.last_ms(), 0.0, 0.0);
+    timing.completed(b, 1, 15 * ms, 17 * ms);
+    assert_float_equal(timing.last_ms(), 6.0, 1e-4);
+
+    // Not done until presented, even with everything back
+    uint64_t c = timing.submitting();
+    assert_int_equal(c, 1);
+    timing.completed(c, 1, 20 * ms, 23 * ms);
+    assert_float_equal(timing.last_ms(), 6.0, 1e-4);
+    timing.presented();
+    assert_float_equal(timing.last_ms(), 3.0, 1e-4);
+    assert_int_equal(timing.last_frames().size(), 200);
+    assert_float_equal(timing.last_frames()[199], 3.0, 1e-4);
+}
+
+static void test_gpu_queues(void **state) {
+    UNUSED(state);
+    gpu_frame_timing timing;
+
+    // Overlapping submissions on a queue count once, another queue with its
+    // own timebase counts on its own and the busiest one wins
+    uint64_t f = timing.submitting();
+    for (int i = 0; i < 3; i++)
+        timing.submitting();
+    timing.completed(f, 2, 1000 * ms, 1004 * ms);
+    timing.completed(f, 1, 10 * ms, 14 * ms);
+    timing.completed(f, 1, 12 * ms, 16 * ms);
+    timing.presented();
+    timing.completed(f, 2, 1003 * ms, 1008 * ms);
+    assert_float_equal(timing.last_ms(), 8.0, 1e-4);
+
+    // Results of frames done out of order wait for the older ones
+    uint64_t first = timing.submitting();
+    timing.presented();
+    uint64_t second = timing.submitting();
+    timing.presented();
+    timing.completed(second, 1, 0, 2 * ms);
+    assert_float_equal(timing.last_ms(), 8.0, 1e-4);
+    timing.completed(first, 1, 0, 1 * ms);
+    assert_float_equal(timing.last_ms(), 2.0, 1e-4);
+    assert_float_equal(timing.last_frames()[198], 1.0, 1e-4);
+}
+
+static void test_gpu_lost(void **state) {
+    UNUSED(state);
+    gpu_frame_timing timing;
+
+    // A frame missing a submission isn't reported but doesn't hold up the next
+    uint64_t f = timing.submitting();
+    timing.submitting();
+    timing.completed(f, 1, 0, 50 * ms);
+    timing.lost(f);
+    timing.presented();
+    assert_float_equal(timing.last_ms(), 0.0, 0.0);
+    f = timing.submitting();
+    timing.presented();
+    timing.completed(f, 1, 0, 5 * ms);
+    assert_float_equal(timing.last_ms(), 5.0, 1e-4);
+
+    // Results that never come are given up on after max_pending frames
+    f = timing.submitting();
+    timing.presented();
+    for (size_t i = 0; i < gpu_frame_timing::max_pending; i++) {
+        uint64_t next = timing.submitting();
+        timing.presented();
+        timing.completed(next, 1, 0, 7 * ms);
+    }
+    assert_float_equal(timing.last_ms(), 7.0, 1e-4);
+    // Too late now
+    timing.completed(f, 1, 0, 1 * ms);
+    assert_float_equal(timing.last_ms(), 7.0, 1e-4);
+}
+
+const struct CMUnitTest gpu_timing_tests[] = {
+    cmocka_unit_test(test_gpu_frame),
+    cmocka_unit_test(test_gpu_queues),
+    cmocka_unit_test(test_gpu_lost),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(gpu_timing_tests, NULL, NULL);
+}
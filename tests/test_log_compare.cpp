@@ -0,0 +1,202 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/log_compare.h"
+
+#define UNUSED(x) (void)(x)
+
+// Logs of seconds of frames around avg_ms, units of 10 s
+static std::vector<log_unit> make_logs(int logs, double seconds, float avg_ms, float sd, std::mt19937& rng) {
+    std::normal_distribution<float> noise(0.f, sd);
+    std::vector<log_unit> units;
+    for (int l = 0; l < logs; l++) {
+        log_unit_builder builder(l, 10000);
+        for (double ms = 0; ms < seconds * 1000;) {
+            float f = std::max(avg_ms + noise(rng), 1.f);
+            builder.add(f, -1);
+            ms += f;
+        }
+        std::vector<log_unit> u = builder.finish();
+        units.insert(units.end(), u.begin(), u.end());
+    }
+    return units;
+}
+
+static void test_parse_csv(void **state) {
+    UNUSED(state);
+    std::string log =
+        "v1\n"
+        "0.7.0\n"
+        "---------------------SYSTEM INFO---------------------\n"
+        "os,cpu,gpu,ram,kernel,driver,cpuscheduler\n"
+        "Arch,Ryzen,Radeon,32,6.1,,\n"
+        "--------------------FRAME METRICS--------------------\n"
+        "fps,frametime,cpu_load,segment,elapsed\r\n"
+        "100,10,50,steady,1000000\n"
+        "garbage\n"
+        "50,20.5,50,steady,21500000\n"
+        "1e+03,1.5e0,50,,2.3e7";
+
+    std::vector<std::pair<float, double>> rows;
+    // Without the trailing newline, like an mmap()ed file that was cut off
+    assert_true(parse_csv_log(log.data(), log.size(), [&](float f, double e) { rows.push_back({ f, e }); }));
+    assert_int_equal(rows.size(), 3);
+    assert_float_equal(rows[0].first, 10.0, 1e-6);
+    assert_float_equal(rows[0].second, 1.0, 1e-9);
+    assert_float_equal(rows[1].first, 20.5, 1e-6);
+    assert_float_equal(rows[1].second, 21.5, 1e-9);
+    assert_float_equal(rows[2].first, 1.5, 1e-6);
+    assert_float_equal(rows[2].second, 23.0, 1e-9);
+
+    // Logs from before the elapsed column
+    std::string old = "os,cpu\nArch,Ryzen\nfps,frametime,cpu_load\n100,10,50\n";
+    rows.clear();
+    assert_true(parse_csv_log(old.data(), old.size(), [&](float f, double e) { rows.push_back({ f, e }); }));
+    assert_int_equal(rows.size(), 1);
+    assert_float_equal(rows[0].second, -1.0, 0.0);
+
+    std::string other = "a,b\n1,2\n";
+    assert_false(parse_csv_log(other.data(), other.size(), [&](float, double) {}));
+}
+
+static void test_units(void **state) {
+    UNUSED(state);
+    // 26 s at 100 fps by the elapsed column: 10, 10 and a 6 s unit
+    log_unit_builder builder(3, 10000);
+    for (int i = 0; i < 2600; i++)
+        builder.add(i % 2 ? 5.f : 15.f, i * 10.0);
+    std::vector<log_unit> units = builder.finish();
+    assert_int_equal(units.size(), 3);
+    assert_int_equal(units[0].log, 3);
+    assert_int_equal(units[0].frames, 1000);
+    assert_int_equal(units[0].buckets.size(), 2);
+    assert_int_equal(units[2].frames, 600);
+
+    // A 4 s tail joins the unit before it
+    log_unit_builder short_tail(0, 10000);
+    for (int i = 0; i < 1400; i++)
+        short_tail.add(10.f, -1);
+    units = short_tail.finish();
+    assert_int_equal(units.size(), 1);
+    assert_int_equal(units[0].frames, 1400);
+    assert_float_equal(units[0].sum_ms, 14000.0, 1e-6);
+
+    // Joining neighbours never crosses into another log
+    std::mt19937 rng(1);
+    units = make_logs(3, 100, 10.f, 1.f, rng);
+    assert_int_equal(units.size(), 30);
+    coarsen_log_units(units, 10);
+    assert_int_equal(units.size(), 9);
+    coarsen_log_units(units, 1);
+    assert_int_equal(units.size(), 3);
+    uint64_t frames = 0;
+    for (auto& b : units[0].buckets)
+        frames += b.frames;
+    assert_int_equal(frames, units[0].frames);
+}
+
+static void test_metrics(void **state) {
+    UNUSED(state);
+    log_unit_builder builder(0, 10000);
+    // 990 frames of 10 ms and 10 hitches of 100 ms
+    for (int i = 0; i < 1000; i++)
+        builder.add(i % 100 ? 10.f : 100.f, -1);
+    log_metrics_accumulator acc;
+    for (auto& u : builder.finish())
+        acc.add(u);
+
+    log_metrics m = acc.metrics();
+    assert_float_equal(m[LOG_METRIC_AVG_FPS], 1000.0 * 1000 / 10900, 1e-6);
+    assert_float_equal(m[LOG_METRIC_LOW_1], 10.0, 0.1);
+    assert_float_equal(m[LOG_METRIC_P50_MS], 10.0, 0.05);
+    assert_float_equal(m[LOG_METRIC_P95_MS], 10.0, 0.05);
+}
+
+static void test_metrics_interpolated(void **state) {
+    UNUSED(state);
+    log_unit_builder builder(0, 100000);
+    // Spread evenly over 10 to 10.5 ms, a few buckets wide
+    for (int i = 0; i < 10000; i++)
+        builder.add(10.f + 0.5f * i / 10000, -1);
+    log_metrics_accumulator acc;
+    for (auto& u : builder.finish())
+        acc.add(u);
+
+    log_metrics m = acc.metrics();
+    assert_float_equal(m[LOG_METRIC_P50_MS], 10.25, 0.005);
+    assert_float_equal(m[LOG_METRIC_P95_MS], 10.475, 0.005);
+    assert_float_equal(m[LOG_METRIC_LOW_1], 1000.0 / 10.495, 0.05);
+}
+
+static void test_mann_whitney(void **state) {
+    UNUSED(state);
+    double superiority;
+
+    // Completely separated
+    std::vector<double> a = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    std::vector<double> b = { 11, 12, 13, 14, 15, 16, 17, 18, 19, 20 };
+    assert_true(mann_whitney(a, b, superiority) < 0.001);
+    assert_float_equal(superiority, 1.0, 1e-9);
+
+    // The same values, ties everywhere
+    assert_float_equal(mann_whitney(a, a, superiority), 1.0, 1e-9);
+    assert_float_equal(superiority, 0.5, 1e-9);
+}
+
+static void test_compare_difference(void **state) {
+    UNUSED(state);
+    std::mt19937 rng(2);
+    std::vector<log_unit> a = make_logs(4, 300, 10.f, 2.f, rng);
+    std::vector<log_unit> b = make_logs(4, 300, 10.5f, 2.f, rng);
+
+    log_comparison c = compare_log_units(a, b, 500, 4, 1);
+    assert_int_equal(c.units_a, 120);
+    const metric_comparison& fps = c.metrics[LOG_METRIC_AVG_FPS];
+    assert_float_equal(fps.change, -100.0 * 0.5 / 10.5, 0.3);
+    assert_true(fps.ci_low < fps.change && fps.change < fps.ci_high);
+    assert_true(fps.ci_high < 0);
+    assert_true(c.mann_whitney_p < 0.001);
+    assert_true(c.superiority < 0.1);
+
+    // Same seed, same intervals, whatever the number of workers
+    log_comparison one = compare_log_units(a, b, 500, 1, 1);
+    assert_float_equal(one.metrics[LOG_METRIC_AVG_FPS].ci_low, fps.ci_low, 0.0);
+    assert_float_equal(one.metrics[LOG_METRIC_AVG_FPS].ci_high, fps.ci_high, 0.0);
+}
+
+static void test_compare_same(void **state) {
+    UNUSED(state);
+    std::mt19937 rng(3);
+    std::vector<log_unit> a = make_logs(4, 300, 10.f, 2.f, rng);
+    std::vector<log_unit> b = make_logs(4, 300, 10.f, 2.f, rng);
+
+    log_comparison c = compare_log_units(a, b, 500, 2, 1);
+    for (size_t m = 0; m < LOG_METRIC_COUNT; m++) {
+        if (!(c.metrics[m].ci_low <= 0 && 0 <= c.metrics[m].ci_high))
+            print_message("%s: %f [%f, %f]\n", log_metric_name(m), c.metrics[m].change,
+                          c.metrics[m].ci_low, c.metrics[m].ci_high);
+        assert_true(c.metrics[m].ci_low <= 0 && 0 <= c.metrics[m].ci_high);
+    }
+    assert_true(c.mann_whitney_p > 0.05);
+}
+
+const struct CMUnitTest log_compare_tests[] = {
+    cmocka_unit_test(test_parse_csv),
+    cmocka_unit_test(test_units),
+    cmocka_unit_test(test_metrics),
+    cmocka_unit_test(test_metrics_interpolated),
+    cmocka_unit_test(test_mann_whitney),
+    cmocka_unit_test(test_compare_difference),
+    cmocka_unit_test(test_compare_same),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(log_compare_tests, NULL, NULL);
+}
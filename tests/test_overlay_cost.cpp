@@ -0,0 +1,90 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include <thread>
+#include "../src/overlay_cost.h"
+
+#define UNUSED(x) (void)(x)
+
+static const uint64_t ms = 1000000;
+
+static void test_cost_frames(void **state) {
+    UNUSED(state);
+    overlay_cost_stats stats;
+    assert_false(stats.gpu_available());
+
+    stats.add(COST_UPDATE, 1 * ms);
+    stats.add(COST_BUILD, 2 * ms);
+    stats.add(COST_DRAW, 1 * ms);
+    stats.end_frame();
+    overlay_cost f = stats.last_frame();
+    assert_float_equal(f.cpu_ms[COST_BUILD], 2.0, 1e-4);
+    assert_float_equal(f.cpu_total_ms(), 4.0, 1e-4);
+    assert_float_equal(f.gpu_ms, 0.0, 0.0);
+
+    // The first draw came back, the next frame has none and keeps it
+    stats.add(COST_BUILD, 4 * ms);
+    stats.gpu(ms / 2);
+    stats.end_frame();
+    assert_float_equal(stats.last_frame().gpu_ms, 0.5, 1e-4);
+    assert_float_equal(stats.last_frame().cpu_total_ms(), 4.0, 1e-4);
+    stats.end_frame();
+    assert_float_equal(stats.last_frame().gpu_ms, 0.5, 1e-4);
+    assert_float_equal(stats.last_frame().cpu_total_ms(), 0.0, 0.0);
+
+    // Two draws back in one frame
+    stats.gpu(1 * ms);
+    stats.gpu(2 * ms);
+    stats.end_frame();
+    assert_float_equal(stats.last_frame().gpu_ms, 1.5, 1e-4);
+
+    // CPU per frame, GPU per draw
+    stats.publish();
+    overlay_cost avg = stats.last_period();
+    assert_true(stats.gpu_available());
+    assert_float_equal(avg.cpu_ms[COST_BUILD], 1.5, 1e-4);
+    assert_float_equal(avg.cpu_total_ms(), 2.0, 1e-4);
+    assert_float_equal(avg.gpu_ms, 3.5 / 3, 1e-4);
+    stats.publish();
+    assert_false(stats.gpu_available());
+    assert_float_equal(stats.last_period().cpu_total_ms(), 0.0, 0.0);
+}
+
+static void test_cost_scope(void **state) {
+    UNUSED(state);
+    overlay_cost_stats stats;
+
+    std::thread presenters[2];
+    for (auto& t : presenters)
+        t = std::thread([&]() {
+            overlay_cost_scope scope(stats, COST_DRAW);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        });
+    for (auto& t : presenters)
+        t.join();
+
+    // Ended early, counted once
+    {
+        overlay_cost_scope scope(stats, COST_UPDATE);
+        scope.end();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    stats.end_frame();
+    assert_true(stats.last_frame().cpu_ms[COST_DRAW] >= 4.0);
+    assert_true(stats.last_frame().cpu_ms[COST_UPDATE] < 20.0);
+    assert_float_equal(stats.last_frame().cpu_ms[COST_BUILD], 0.0, 0.0);
+}
+
+const struct CMUnitTest overlay_cost_tests[] = {
+    cmocka_unit_test(test_cost_frames),
+    cmocka_unit_test(test_cost_scope),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(overlay_cost_tests, NULL, NULL);
+}
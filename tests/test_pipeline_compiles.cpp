@@ -0,0 +1,80 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include <thread>
+#include "../src/pipeline_compiles.h"
+
+#define UNUSED(x) (void)(x)
+
+static const uint64_t ms = 1000000;
+
+static void test_compile_frames(void **state) {
+    UNUSED(state);
+    pipeline_compile_stats stats;
+    assert_false(stats.feedback());
+
+    // Without creation feedback nothing is known about the cache
+    stats.add_shaders(1 * ms, 2);
+    stats.add_pipelines(10 * ms, 3, 0, 0);
+    compile_frame f = stats.end_frame();
+    assert_float_equal(f.ms, 11.0, 1e-4);
+    assert_int_equal(f.pipelines, 3);
+    assert_int_equal(f.shaders, 2);
+    assert_false(stats.feedback());
+
+    stats.add_pipelines(20 * ms, 4, 1, 3);
+    stats.end_frame();
+    f = stats.last_frame();
+    assert_true(stats.feedback());
+    assert_int_equal(f.cache_hits, 1);
+    assert_int_equal(f.cache_misses, 3);
+
+    // A frame without compiles, no marker
+    assert_float_equal(stats.end_frame().ms, 0.0, 0.0);
+
+    // Totals of the period, not averages
+    stats.publish();
+    compile_frame period = stats.last_period();
+    assert_float_equal(period.ms, 31.0, 1e-4);
+    assert_int_equal(period.pipelines, 7);
+    assert_int_equal(period.shaders, 2);
+    assert_int_equal(period.cache_misses, 3);
+
+    stats.add_pipelines(1 * ms, 1, 0, 1);
+    stats.end_frame();
+    stats.publish();
+    assert_int_equal(stats.last_period().pipelines, 1);
+    assert_int_equal(stats.last_period().cache_misses, 1);
+}
+
+static void test_compile_threads(void **state) {
+    UNUSED(state);
+    pipeline_compile_stats stats;
+
+    std::thread compilers[4];
+    for (auto& t : compilers)
+        t = std::thread([&]() {
+            for (int i = 0; i < 1000; i++)
+                stats.add_pipelines(1000, 1, 0, 1);
+        });
+    for (auto& t : compilers)
+        t.join();
+
+    compile_frame f = stats.end_frame();
+    assert_float_equal(f.ms, 4.0, 1e-4);
+    assert_int_equal(f.pipelines, 4000);
+    assert_int_equal(f.cache_misses, 4000);
+}
+
+const struct CMUnitTest pipeline_compiles_tests[] = {
+    cmocka_unit_test(test_compile_frames),
+    cmocka_unit_test(test_compile_threads),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(pipeline_compiles_tests, NULL, NULL);
+}
@@ -0,0 +1,79 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include <thread>
+#include "../src/present_blocking.h"
+
+#define UNUSED(x) (void)(x)
+
+static const uint64_t ms = 1000000;
+
+static void test_blocking_frames(void **state) {
+    UNUSED(state);
+    present_blocking_stats stats;
+
+    // The first present only starts the clock
+    stats.add(BLOCK_PRESENT, 3 * ms);
+    stats.end_frame(100 * ms);
+    assert_float_equal(stats.last_frame().ms[BLOCK_PRESENT], 3.0, 1e-4);
+    assert_float_equal(stats.last_frame().frame_ms, 0.0, 0.0);
+
+    // Waits go to the frame they happen in
+    stats.add(BLOCK_ACQUIRE, 2 * ms);
+    stats.add(BLOCK_FENCE, 1 * ms);
+    stats.add(BLOCK_PRESENT, 5 * ms);
+    stats.add(BLOCK_LIMITER, 4 * ms);
+    stats.end_frame(120 * ms);
+    frame_blocking f = stats.last_frame();
+    assert_float_equal(f.ms[BLOCK_ACQUIRE], 2.0, 1e-4);
+    assert_float_equal(f.ms[BLOCK_FENCE], 1.0, 1e-4);
+    assert_float_equal(f.ms[BLOCK_PRESENT], 5.0, 1e-4);
+    assert_float_equal(f.ms[BLOCK_LIMITER], 4.0, 1e-4);
+    assert_float_equal(f.frame_ms, 20.0, 1e-4);
+    // The limiter's sleep isn't the driver's doing
+    assert_float_equal(f.blocked_percent(), 40.0, 1e-3);
+
+    stats.end_frame(130 * ms);
+    assert_float_equal(stats.last_frame().ms[BLOCK_PRESENT], 0.0, 0.0);
+
+    // Averages over the frames since the last publish()
+    stats.publish();
+    frame_blocking avg = stats.last_period();
+    assert_float_equal(avg.ms[BLOCK_PRESENT], 2.5, 1e-4);
+    assert_float_equal(avg.frame_ms, 15.0, 1e-4);
+    stats.publish();
+    assert_float_equal(stats.last_period().frame_ms, 0.0, 0.0);
+}
+
+static void test_blocking_threads(void **state) {
+    UNUSED(state);
+    present_blocking_stats stats;
+    stats.end_frame(0);
+
+    std::thread waiters[4];
+    for (auto& t : waiters)
+        t = std::thread([&]() {
+            for (int i = 0; i < 1000; i++)
+                stats.add(BLOCK_FENCE, 1000);
+        });
+    for (auto& t : waiters)
+        t.join();
+
+    stats.end_frame(10 * ms);
+    assert_float_equal(stats.last_frame().ms[BLOCK_FENCE], 4.0, 1e-4);
+    stats.set_swapchain(3);
+    assert_int_equal(stats.images(), 3);
+}
+
+const struct CMUnitTest present_blocking_tests[] = {
+    cmocka_unit_test(test_blocking_frames),
+    cmocka_unit_test(test_blocking_threads),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(present_blocking_tests, NULL, NULL);
+}
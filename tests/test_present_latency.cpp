@@ -0,0 +1,77 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include "../src/present_latency.h"
+
+#define UNUSED(x) (void)(x)
+
+static const uint64_t ms = 1000000;
+
+static void test_latency_frames(void **state) {
+    UNUSED(state);
+    present_latency_stats stats;
+    assert_false(stats.available());
+
+    stats.presented(1, 1, 100 * ms);
+    stats.presented(1, 2, 110 * ms);
+    assert_true(stats.available());
+
+    stats.displayed(1, 1, 116 * ms);
+    assert_float_equal(stats.last_frame().latency_ms, 16.0, 1e-4);
+    assert_float_equal(stats.last_frame().interval_ms, 0.0, 0.0);
+
+    stats.displayed(1, 2, 132 * ms);
+    assert_float_equal(stats.last_frame().latency_ms, 22.0, 1e-4);
+    assert_float_equal(stats.last_frame().interval_ms, 16.0, 1e-4);
+
+    // Reported twice, or for a present that wasn't tagged
+    stats.displayed(1, 2, 140 * ms);
+    stats.displayed(1, 7, 140 * ms);
+    assert_float_equal(stats.last_frame().latency_ms, 22.0, 1e-4);
+
+    stats.publish();
+    display_timing avg = stats.last_period();
+    assert_int_equal(avg.frames, 2);
+    assert_float_equal(avg.latency_ms, 19.0, 1e-4);
+    assert_float_equal(avg.interval_ms, 16.0, 1e-4);
+    stats.publish();
+    assert_int_equal(stats.last_period().frames, 0);
+}
+
+static void test_latency_skipped(void **state) {
+    UNUSED(state);
+    present_latency_stats stats;
+
+    // Mailbox replaced 2 with 3 before it was shown, the wait on 2 returns
+    // with 3 on screen
+    stats.presented(1, 1, 0);
+    stats.presented(1, 2, 5 * ms);
+    stats.presented(1, 3, 10 * ms);
+    stats.displayed(1, 3, 20 * ms);
+    assert_float_equal(stats.last_frame().latency_ms, 10.0, 1e-4);
+    stats.displayed(1, 1, 30 * ms);
+    assert_float_equal(stats.last_frame().latency_ms, 10.0, 1e-4);
+
+    // Swapchains don't mix
+    stats.presented(1, 4, 100 * ms);
+    stats.presented(2, 1, 101 * ms);
+    stats.displayed(2, 1, 105 * ms);
+    assert_float_equal(stats.last_frame().latency_ms, 4.0, 1e-4);
+    assert_float_equal(stats.last_frame().interval_ms, 0.0, 0.0);
+    stats.forget(1);
+    stats.displayed(1, 4, 110 * ms);
+    assert_float_equal(stats.last_frame().latency_ms, 4.0, 1e-4);
+}
+
+const struct CMUnitTest present_latency_tests[] = {
+    cmocka_unit_test(test_latency_frames),
+    cmocka_unit_test(test_latency_skipped),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(present_latency_tests, NULL, NULL);
+}
@@ -0,0 +1,117 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include <string.h>
+#include "../src/run_history.h"
+
+#define UNUSED(x) (void)(x)
+
+static run_record make_run(float avg_fps, float low_1) {
+    run_record r {};
+    r.time = 1700000000;
+    r.duration_s = 60;
+    r.frames = uint64_t(avg_fps * 60);
+    r.avg_fps = avg_fps;
+    r.low_1 = low_1;
+    r.low_01 = low_1 * 0.8f;
+    r.kernel = "6.1.0";
+    r.driver = "Mesa 23.0.0";
+    r.mangohud = "v0.7.0";
+    return r;
+}
+
+static void test_history_csv(void **state) {
+    UNUSED(state);
+    run_record r = make_run(120.5f, 90.25f);
+    r.driver = "NVIDIA 535.1, beta";
+
+    run_history history;
+    assert_false(history.add_line(run_history::header()));
+    assert_true(history.add_line(run_history::line(r)));
+    assert_true(history.add_line(run_history::line(make_run(100, 80))));
+    assert_false(history.add_line("not,a,run"));
+    assert_false(history.add_line(""));
+    assert_false(history.add_line("1700000000,60.00,7200,120.50,90.25,not a number"));
+    assert_int_equal(history.runs().size(), 2);
+    const run_record& back = history.runs()[0];
+    assert_int_equal(back.time, r.time);
+    assert_int_equal(back.frames, r.frames);
+    assert_float_equal(back.avg_fps, 120.5, 1e-3);
+    assert_float_equal(back.low_1, 90.25, 1e-3);
+    assert_string_equal(back.kernel.c_str(), "6.1.0");
+    // The comma would have been a column of its own
+    assert_string_equal(back.driver.c_str(), "NVIDIA 535.1  beta");
+    assert_string_equal(back.mangohud.c_str(), "v0.7.0");
+}
+
+static void test_history_regression(void **state) {
+    UNUSED(state);
+    run_history history;
+
+    // Too few runs to compare with
+    history.add(make_run(100, 80));
+    history.add(make_run(102, 81));
+    assert_int_equal(history.compare(make_run(50, 40), 10).runs, 0);
+    assert_false(history.compare(make_run(50, 40), 10).regression);
+
+    history.add(make_run(98, 79));
+    history.add(make_run(101, 80));
+    history.add(make_run(99, 82));
+
+    // Within the noise of the earlier runs
+    run_comparison c = history.compare(make_run(99, 80), 10);
+    assert_int_equal(c.runs, 5);
+    assert_float_equal(c.median_fps, 100.0, 1e-6);
+    assert_float_equal(c.change, -1.0, 1e-6);
+    assert_false(c.regression);
+
+    // Clearly slower on average
+    c = history.compare(make_run(90, 80), 10);
+    assert_float_equal(c.change, -10.0, 1e-6);
+    assert_true(c.regression);
+
+    // Same average, worse 1% lows
+    c = history.compare(make_run(100, 60), 10);
+    assert_float_equal(c.low_1_change, -25.0, 1e-6);
+    assert_true(c.regression);
+
+    // Faster is never a regression
+    assert_false(history.compare(make_run(130, 100), 10).regression);
+}
+
+static void test_history_last_runs(void **state) {
+    UNUSED(state);
+    run_history history;
+
+    // Identical runs still leave room for 1% of noise
+    for (int i = 0; i < 5; i++)
+        history.add(make_run(100, 80));
+    assert_false(history.compare(make_run(98, 79), 10).regression);
+    assert_true(history.compare(make_run(96, 80), 10).regression);
+
+    // An odd run doesn't move the median
+    history.add(make_run(20, 10));
+    assert_float_equal(history.compare(make_run(100, 80), 10).median_fps, 100.0, 1e-6);
+
+    // Only the last runs count, after a driver update made everything faster
+    for (int i = 0; i < 5; i++)
+        history.add(make_run(150, 120));
+    run_comparison c = history.compare(make_run(100, 80), 5);
+    assert_int_equal(c.runs, 5);
+    assert_float_equal(c.median_fps, 150.0, 1e-6);
+    assert_true(c.regression);
+}
+
+const struct CMUnitTest run_history_tests[] = {
+    cmocka_unit_test(test_history_csv),
+    cmocka_unit_test(test_history_regression),
+    cmocka_unit_test(test_history_last_runs),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(run_history_tests, NULL, NULL);
+}
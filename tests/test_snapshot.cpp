@@ -0,0 +1,149 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "../src/snapshot.h"
+
+#define UNUSED(x) (void)(x)
+
+// Every field carries the same generation, so a torn read shows up as a
+// mismatch between them.
+struct sample {
+    uint64_t generation;
+    uint64_t payload[63];
+};
+
+static void test_snapshot_initial_value(void **state) {
+    UNUSED(state);
+    snapshot_buffer<sample> buf;
+
+    auto v = buf.acquire();
+    assert_int_equal(v->generation, 0);
+    assert_int_equal(v->payload[62], 0);
+}
+
+static void test_snapshot_publish_replaces(void **state) {
+    UNUSED(state);
+    snapshot_buffer<sample> buf;
+    sample s = {};
+
+    s.generation = 1;
+    assert_true(buf.publish(s));
+    assert_int_equal(buf.acquire()->generation, 1);
+
+    s.generation = 2;
+    assert_true(buf.publish(s));
+    assert_int_equal(buf.acquire()->generation, 2);
+    assert_int_equal(buf.latest().generation, 2);
+}
+
+static void test_snapshot_view_is_stable(void **state) {
+    UNUSED(state);
+    snapshot_buffer<sample, 3> buf;
+    sample s = {};
+
+    s.generation = 1;
+    buf.publish(s);
+    auto pinned = buf.acquire();
+
+    // With 3 slots and one pinned the writer can keep going in the other two
+    for (uint64_t i = 2; i < 10; i++) {
+        s.generation = i;
+        assert_true(buf.publish(s));
+    }
+
+    assert_int_equal(pinned->generation, 1);
+    assert_int_equal(buf.acquire()->generation, 9);
+}
+
+static void test_snapshot_all_slots_pinned(void **state) {
+    UNUSED(state);
+    snapshot_buffer<sample, 3> buf;
+    sample s = {};
+
+    auto a = buf.acquire();
+    s.generation = 1;
+    assert_true(buf.publish(s));
+    auto b = buf.acquire();
+    s.generation = 2;
+    assert_true(buf.publish(s));
+    auto c = buf.acquire();
+
+    // Nothing left to write to, the update is dropped
+    s.generation = 3;
+    assert_false(buf.publish(s));
+    assert_int_equal(buf.acquire()->generation, 2);
+
+    a = {};
+    assert_true(buf.publish(s));
+    assert_int_equal(buf.acquire()->generation, 3);
+}
+
+// Meant to be run under -Db_sanitize=thread, but also catches torn reads
+// and generations going backwards on its own.
+static void test_snapshot_concurrent_publish_read(void **state) {
+    UNUSED(state);
+    const uint64_t generations = 200000;
+    const int num_readers = 3;
+
+    snapshot_buffer<sample, num_readers + 2> buf;
+    std::atomic<bool> done {false};
+    std::atomic<uint64_t> torn {0}, backwards {0}, reads {0};
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < num_readers; r++) {
+        readers.emplace_back([&] {
+            uint64_t last = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                auto v = buf.acquire();
+                for (uint64_t p : v->payload) {
+                    if (p != v->generation)
+                        torn++;
+                }
+
+                if (v->generation < last)
+                    backwards++;
+
+                last = v->generation;
+                reads++;
+            }
+        });
+    }
+
+    std::thread writer([&] {
+        sample s = {};
+        for (uint64_t gen = 1; gen <= generations; gen++) {
+            s.generation = gen;
+            for (uint64_t& p : s.payload)
+                p = gen;
+            buf.publish(s);
+        }
+        done = true;
+    });
+
+    writer.join();
+    for (auto& t : readers)
+        t.join();
+
+    assert_int_equal(torn.load(), 0);
+    assert_int_equal(backwards.load(), 0);
+    assert_true(reads.load() > 0);
+}
+
+const struct CMUnitTest snapshot_tests[] = {
+    cmocka_unit_test(test_snapshot_initial_value),
+    cmocka_unit_test(test_snapshot_publish_replaces),
+    cmocka_unit_test(test_snapshot_view_is_stable),
+    cmocka_unit_test(test_snapshot_all_slots_pinned),
+    cmocka_unit_test(test_snapshot_concurrent_publish_read),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(snapshot_tests, NULL, NULL);
+}
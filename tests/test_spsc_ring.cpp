@@ -0,0 +1,118 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "../src/spsc_ring.h"
+
+#define UNUSED(x) (void)(x)
+
+static void test_spsc_ring_fifo(void **state) {
+    UNUSED(state);
+    spsc_ring<int, 8> ring;
+    std::vector<int> out;
+
+    for (int i = 0; i < 5; i++)
+        assert_true(ring.push(i));
+
+    assert_int_equal(ring.drain([&](uint64_t, int v) { out.push_back(v); }), 5);
+    assert_int_equal(out.size(), 5);
+    for (int i = 0; i < 5; i++)
+        assert_int_equal(out[i], i);
+
+    // Nothing new since the last drain
+    assert_int_equal(ring.drain([&](uint64_t, int) { fail(); }), 0);
+}
+
+static void test_spsc_ring_positions(void **state) {
+    UNUSED(state);
+    spsc_ring<int, 4> ring;
+    std::vector<uint64_t> positions;
+
+    // Wrap the buffer a few times, positions keep counting
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 3; i++)
+            ring.push(i);
+        ring.drain([&](uint64_t pos, int) { positions.push_back(pos); });
+    }
+
+    assert_int_equal(ring.pushed(), 9);
+    assert_int_equal(positions.size(), 9);
+    for (uint64_t i = 0; i < positions.size(); i++)
+        assert_int_equal(positions[i], i);
+}
+
+static void test_spsc_ring_full(void **state) {
+    UNUSED(state);
+    spsc_ring<int, 4> ring;
+    std::vector<int> out;
+
+    for (int i = 0; i < 4; i++)
+        assert_true(ring.push(i));
+
+    // The consumer is N behind, new values are dropped, old ones kept
+    assert_false(ring.push(4));
+    assert_false(ring.push(5));
+    assert_int_equal(ring.overflows(), 2);
+    assert_int_equal(ring.pushed(), 4);
+
+    ring.drain([&](uint64_t, int v) { out.push_back(v); });
+    assert_int_equal(out.size(), 4);
+    assert_int_equal(out[3], 3);
+
+    assert_true(ring.push(6));
+}
+
+// Meant to be run under -Db_sanitize=thread, but also catches lost,
+// repeated and reordered values on its own.
+static void test_spsc_ring_concurrent(void **state) {
+    UNUSED(state);
+    const uint64_t values = 1000000;
+
+    spsc_ring<uint64_t, 1024> ring;
+    std::atomic<bool> done {false};
+
+    std::thread producer([&] {
+        for (uint64_t v = 0; v < values;) {
+            if (ring.push(v))
+                v++;
+        }
+        done = true;
+    });
+
+    uint64_t next = 0, out_of_order = 0, wrong_pos = 0;
+    auto check = [&](uint64_t pos, uint64_t v) {
+        if (v != next)
+            out_of_order++;
+        // Every retried push gets the position of the one that failed
+        if (pos != v)
+            wrong_pos++;
+        next = v + 1;
+    };
+
+    while (!done.load())
+        ring.drain(check);
+    ring.drain(check);
+
+    producer.join();
+
+    assert_int_equal(next, values);
+    assert_int_equal(out_of_order, 0);
+    assert_int_equal(wrong_pos, 0);
+}
+
+const struct CMUnitTest spsc_ring_tests[] = {
+    cmocka_unit_test(test_spsc_ring_fifo),
+    cmocka_unit_test(test_spsc_ring_positions),
+    cmocka_unit_test(test_spsc_ring_full),
+    cmocka_unit_test(test_spsc_ring_concurrent),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(spsc_ring_tests, NULL, NULL);
+}
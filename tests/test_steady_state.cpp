@@ -0,0 +1,115 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+extern "C" {
+#include <cmocka.h>
+}
+#include <random>
+#include <vector>
+#include "../src/steady_state.h"
+
+#define UNUSED(x) (void)(x)
+
+// Feeds seconds worth of frames from gen
+template <typename Gen>
+static void run_for(steady_state_detector& detector, double seconds, Gen gen) {
+    double ms = 0;
+    while (ms < seconds * 1000) {
+        float f = gen();
+        detector.add(f);
+        ms += f;
+    }
+}
+
+static void test_steady_after_warmup(void **state) {
+    UNUSED(state);
+    std::mt19937 rng(1);
+    std::normal_distribution<float> smooth(16.6f, 0.4f);
+    std::uniform_real_distribution<float> compiling(10.f, 60.f);
+    steady_state_detector detector;
+
+    // Shader compilation, then a loading screen
+    run_for(detector, 3, [&] { return compiling(rng); });
+    assert_true(detector.state() == run_segment::warmup);
+    run_for(detector, 2, [] { return 500.f; });
+    assert_true(detector.state() == run_segment::stall);
+
+    // Not steady until it held for steady_ms
+    run_for(detector, 3, [&] { return smooth(rng); });
+    assert_true(detector.state() == run_segment::warmup);
+    run_for(detector, 30, [&] { return smooth(rng); });
+    assert_true(detector.state() == run_segment::steady);
+
+    std::vector<segment_stats> segments = detector.segments();
+    assert_int_equal(segments.size(), 4);
+    assert_true(segments[0].type == run_segment::warmup);
+    assert_true(segments[1].type == run_segment::stall);
+    assert_true(segments[2].type == run_segment::warmup);
+    assert_true(segments[3].type == run_segment::steady);
+
+    // The steady part only has the smooth frames in it
+    assert_float_equal(segments[3].avg_fps, 1000 / 16.6, 1.0);
+    assert_true(segments[3].low_01 > 1000 / 19.f);
+    assert_true(segments[3].duration_ms > 25000);
+
+    double ms = 0;
+    for (const segment_stats& s : segments) {
+        assert_float_equal(s.start_ms, ms, 1e-6);
+        ms += s.duration_ms;
+    }
+}
+
+static void test_hitch_keeps_steady(void **state) {
+    UNUSED(state);
+    std::mt19937 rng(2);
+    std::normal_distribution<float> smooth(6.9f, 0.3f);
+    steady_state_detector detector;
+
+    run_for(detector, 10, [&] { return smooth(rng); });
+    assert_true(detector.state() == run_segment::steady);
+
+    // A lone 150 ms hitch every couple of seconds is still the same level
+    int frame = 0;
+    run_for(detector, 20, [&] { return ++frame % 300 ? smooth(rng) : 150.f; });
+    assert_true(detector.state() == run_segment::steady);
+    assert_int_equal(detector.segments().size(), 2);
+}
+
+static void test_level_change(void **state) {
+    UNUSED(state);
+    std::mt19937 rng(3);
+    std::normal_distribution<float> heavy(16.6f, 0.5f);
+    std::normal_distribution<float> light(10.f, 0.3f);
+    steady_state_detector detector;
+
+    run_for(detector, 10, [&] { return heavy(rng); });
+    assert_true(detector.state() == run_segment::steady);
+
+    // A new scene running faster has to settle again
+    run_for(detector, 2, [&] { return light(rng); });
+    assert_true(detector.state() == run_segment::warmup);
+    run_for(detector, 10, [&] { return light(rng); });
+    assert_true(detector.state() == run_segment::steady);
+
+    std::vector<segment_stats> segments = detector.segments();
+    assert_int_equal(segments.size(), 4);
+    assert_float_equal(segments[3].avg_fps, 100.0, 2.0);
+
+    // Starting over keeps the state
+    detector.restart_segments();
+    run_for(detector, 1, [&] { return light(rng); });
+    segments = detector.segments();
+    assert_int_equal(segments.size(), 1);
+    assert_true(segments[0].type == run_segment::steady);
+}
+
+const struct CMUnitTest steady_state_tests[] = {
+    cmocka_unit_test(test_steady_after_warmup),
+    cmocka_unit_test(test_hitch_keeps_steady),
+    cmocka_unit_test(test_level_change),
+};
+
+int main(void) {
+    return cmocka_run_group_tests(steady_state_tests, NULL, NULL);
+}